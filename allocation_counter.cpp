@@ -0,0 +1,39 @@
+#include "allocation_counter.h"
+
+#ifdef MCTS_HEX_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local std::size_t thread_allocation_count = 0;
+
+void* allocate_and_count(std::size_t size) {
+  ++thread_allocation_count;
+  // malloc may return nullptr for a size of 0, which operator new must not
+  void* memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return allocate_and_count(size); }
+void* operator new[](std::size_t size) { return allocate_and_count(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+std::size_t get_thread_allocation_count() { return thread_allocation_count; }
+
+#else
+
+std::size_t get_thread_allocation_count() { return 0; }
+
+#endif  // MCTS_HEX_COUNT_ALLOCATIONS
@@ -0,0 +1,20 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+/**
+ * @brief Returns the number of heap allocations made so far by the calling
+ * thread through operator new.
+ *
+ * The count is only kept if the program is built with
+ * MCTS_HEX_COUNT_ALLOCATIONS defined, which replaces the global operator new
+ * and operator delete with counting versions. Otherwise, this function always
+ * returns 0. It is meant to verify that the hot paths of the search, such as
+ * the playouts, do not allocate.
+ *
+ * @return The number of allocations of the calling thread.
+ */
+std::size_t get_thread_allocation_count();
+
+#endif  // ALLOCATION_COUNTER_H
@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "cell_state.h"
+#include "mcts_agent.h"
+#include "xoshiro_generator.h"
+
+/**
+ * @brief The result of one benchmark, written as one JSON object or CSV row.
+ */
+struct Benchmark_result {
+  std::string name;
+  int board_size = 0;
+  unsigned int threads = 1;
+  // The number of times the measured operation ran
+  std::uint64_t iterations = 0;
+  double nanoseconds_per_iteration = 0.;
+  double items_per_second = 0.;
+  std::uint64_t bytes_per_node = 0;
+  std::uint64_t tree_nodes = 0;
+};
+
+/**
+ * @brief The options of a benchmark run, taken from the command line.
+ */
+struct Benchmark_options {
+  std::string format = "json";
+  std::vector<int> board_sizes = {5,  6,  7,  8,  9,  10, 11, 12,
+                                  13, 14, 15, 16, 17, 18, 19};
+  std::vector<unsigned int> thread_counts;
+  // The shortest time a micro benchmark runs its operation for
+  double min_time = 0.1;
+  // The time every search of the macro benchmarks runs for
+  double search_time = 0.25;
+};
+
+/**
+ * @brief Gives the benchmarks access to the internals of Mcts_agent, which is
+ * a friend of this struct.
+ */
+struct Mcts_agent_benchmark {
+  /**
+   * @brief Returns the number of nodes in the agent's tree.
+   */
+  static std::uint32_t get_tree_size(const Mcts_agent& agent) {
+    return agent.get_tree_node_count();
+  }
+
+  /**
+   * @brief Searches from a game state for a given time, like choose_move()
+   * does, and returns the number of iterations completed.
+   */
+  static int search(Mcts_agent& agent, const Board& board, Cell_state player,
+                    std::chrono::duration<double> search_time) {
+    agent.prepare_root(board, player);
+    std::atomic<int> mcts_iteration_counter(0);
+    agent.run_search(
+        board,
+        std::chrono::high_resolution_clock::now() +
+            std::chrono::duration_cast<
+                std::chrono::high_resolution_clock::duration>(search_time),
+        0, mcts_iteration_counter);
+    return mcts_iteration_counter;
+  }
+
+  /**
+   * @brief Holds what one playout needs, so that the benchmark can run
+   * playouts one after the other like a worker of the agent does.
+   */
+  struct Playout_runner {
+    Mcts_agent& agent;
+    Mcts_agent::Node node;
+    Mcts_agent::Playout_scratch scratch;
+    Xoshiro_generator generator;
+
+    Playout_runner(Mcts_agent& agent, const Board& board, Cell_state last_mover)
+        : agent(agent), scratch(board), generator(1) {
+      node.initialize(last_mover, std::make_pair(-1, -1));
+    }
+
+    Cell_state run_random_playout(const Board& board) {
+      return agent.simulate_random_playout<false>(node, board, scratch,
+                                                  generator);
+    }
+
+    Cell_state run_filled_playout(const Board& board) {
+      return agent.simulate_filled_playout<false>(node, board, scratch,
+                                                  generator);
+    }
+
+    Cell_state run_bridge_playout(const Board& board) {
+      return agent.simulate_bridge_playout<false>(node, board, scratch,
+                                                  generator);
+    }
+  };
+};
+
+namespace {
+
+// Keeps the results of the measured operations alive, so that the compiler
+// cannot remove them
+std::atomic<std::uint64_t> result_sink(0);
+
+/**
+ * @brief Runs an operation repeatedly, increasing the number of repetitions
+ * until they take at least the minimum time, like Google Benchmark does.
+ *
+ * @param min_time The minimum time in seconds.
+ * @param operation Called with the number of the repetition.
+ * @return A result holding the repetitions and the time per repetition.
+ */
+template <typename Operation>
+Benchmark_result measure(double min_time, Operation operation) {
+  std::uint64_t iterations = 1;
+  while (true) {
+    std::uint64_t checksum = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < iterations; ++i) {
+      checksum += operation(i);
+    }
+    std::chrono::duration<double> elapsed_time =
+        std::chrono::steady_clock::now() - start_time;
+    result_sink.fetch_add(checksum, std::memory_order_relaxed);
+    if (elapsed_time.count() >= min_time || iterations >= (1ull << 40)) {
+      Benchmark_result result;
+      result.iterations = iterations;
+      result.nanoseconds_per_iteration =
+          elapsed_time.count() * 1e9 / static_cast<double>(iterations);
+      result.items_per_second =
+          static_cast<double>(iterations) / elapsed_time.count();
+      return result;
+    }
+    // Aim for the minimum time, growing at most tenfold per round
+    double factor = elapsed_time.count() > 0.
+                        ? 1.4 * min_time / elapsed_time.count()
+                        : 10.;
+    iterations = static_cast<std::uint64_t>(
+        static_cast<double>(iterations) * std::min(std::max(factor, 2.), 10.));
+  }
+}
+
+/**
+ * @brief Creates random mid-game positions, in which half of the cells are
+ * taken alternately by both players with regular moves.
+ */
+std::vector<Board> create_mid_game_positions(int board_size,
+                                             std::size_t position_count) {
+  Xoshiro_generator generator(static_cast<std::uint64_t>(board_size));
+  std::vector<Board> positions;
+  std::vector<std::pair<int, int>> empty_cells;
+  for (std::size_t i = 0; i < position_count; ++i) {
+    Board board(board_size);
+    board.get_valid_moves(empty_cells);
+    generator.shuffle(empty_cells);
+    Cell_state player = Cell_state::Blue;
+    for (std::size_t move = 0; move < empty_cells.size() / 2; ++move) {
+      board.make_move(empty_cells[move].first, empty_cells[move].second,
+                      player);
+      player = get_opponent(player);
+    }
+    positions.push_back(board);
+  }
+  return positions;
+}
+
+/**
+ * @brief Creates random full boards, filled in bulk so that the winner is
+ * found by the flood fill.
+ */
+std::vector<Board> create_filled_positions(int board_size,
+                                           std::size_t position_count) {
+  Xoshiro_generator generator(static_cast<std::uint64_t>(board_size) + 1);
+  std::vector<Board> positions;
+  std::vector<std::pair<int, int>> empty_cells;
+  for (std::size_t i = 0; i < position_count; ++i) {
+    Board board(board_size);
+    board.get_valid_moves(empty_cells);
+    generator.shuffle(empty_cells);
+    board.fill_cells_alternately(empty_cells, Cell_state::Blue);
+    positions.push_back(board);
+  }
+  return positions;
+}
+
+void run_micro_benchmarks(int board_size, const Benchmark_options& options,
+                          std::vector<Benchmark_result>& results) {
+  const std::size_t position_count = 256;
+  const std::vector<Board> mid_game_positions =
+      create_mid_game_positions(board_size, position_count);
+  const std::vector<Board> filled_positions =
+      create_filled_positions(board_size, position_count);
+
+  Benchmark_result result =
+      measure(options.min_time, [&](std::uint64_t i) -> std::uint64_t {
+        return static_cast<std::uint64_t>(
+            mid_game_positions[i % position_count].check_winner());
+      });
+  result.name = "check_winner";
+  result.board_size = board_size;
+  results.push_back(result);
+
+  result = measure(options.min_time, [&](std::uint64_t i) -> std::uint64_t {
+    return static_cast<std::uint64_t>(
+        filled_positions[i % position_count].check_winner());
+  });
+  result.name = "check_winner_filled";
+  result.board_size = board_size;
+  results.push_back(result);
+
+  std::vector<std::pair<int, int>> valid_moves;
+  valid_moves.reserve(static_cast<std::size_t>(board_size * board_size));
+  result = measure(options.min_time, [&](std::uint64_t i) -> std::uint64_t {
+    mid_game_positions[i % position_count].get_valid_moves(valid_moves);
+    return valid_moves.size();
+  });
+  result.name = "get_valid_moves";
+  result.board_size = board_size;
+  results.push_back(result);
+
+  // Playouts from the empty board, with Red as the last mover so that Blue
+  // moves first
+  Mcts_agent agent(1.41, Search_limits(std::chrono::milliseconds(1)), false,
+                   false, Playout_mode::Move_by_move, 1);
+  const Board empty_board(board_size);
+  Mcts_agent_benchmark::Playout_runner runner(agent, empty_board,
+                                              Cell_state::Red);
+  result = measure(options.min_time, [&](std::uint64_t) -> std::uint64_t {
+    return static_cast<std::uint64_t>(runner.run_random_playout(empty_board));
+  });
+  result.name = "simulate_random_playout";
+  result.board_size = board_size;
+  results.push_back(result);
+
+  result = measure(options.min_time, [&](std::uint64_t) -> std::uint64_t {
+    return static_cast<std::uint64_t>(runner.run_filled_playout(empty_board));
+  });
+  result.name = "simulate_filled_playout";
+  result.board_size = board_size;
+  results.push_back(result);
+
+  result = measure(options.min_time, [&](std::uint64_t) -> std::uint64_t {
+    return static_cast<std::uint64_t>(runner.run_bridge_playout(empty_board));
+  });
+  result.name = "simulate_bridge_playout";
+  result.board_size = board_size;
+  results.push_back(result);
+}
+
+void run_macro_benchmarks(int board_size, const Benchmark_options& options,
+                          std::vector<Benchmark_result>& results) {
+  const Board empty_board(board_size);
+  for (unsigned int thread_count : options.thread_counts) {
+    Benchmark_result result;
+    for (Parallel_mode parallel_mode :
+         {Parallel_mode::Shared_tree, Parallel_mode::Root_trees}) {
+      // A single worker grows a single tree in either mode
+      if (thread_count == 1 && parallel_mode == Parallel_mode::Root_trees) {
+        continue;
+      }
+      Mcts_agent agent(1.41, Search_limits(std::chrono::milliseconds(1)),
+                       thread_count > 1, false, Playout_mode::Move_by_move, 1,
+                       0., nullptr, thread_count, parallel_mode);
+      auto start_time = std::chrono::steady_clock::now();
+      int iterations = Mcts_agent_benchmark::search(
+          agent, empty_board, Cell_state::Blue,
+          std::chrono::duration<double>(options.search_time));
+      std::chrono::duration<double> elapsed_time =
+          std::chrono::steady_clock::now() - start_time;
+
+      result = Benchmark_result();
+      result.name = parallel_mode == Parallel_mode::Shared_tree
+                        ? "choose_move"
+                        : "choose_move_root";
+      result.board_size = board_size;
+      result.threads = thread_count;
+      result.iterations = static_cast<std::uint64_t>(iterations);
+      if (iterations > 0) {
+        result.nanoseconds_per_iteration =
+            elapsed_time.count() * 1e9 / iterations;
+      }
+      result.items_per_second = iterations / elapsed_time.count();
+      result.bytes_per_node = Mcts_agent::get_bytes_per_node();
+      result.tree_nodes = Mcts_agent_benchmark::get_tree_size(agent);
+      results.push_back(result);
+    }
+
+    if (thread_count == 1) {
+      // The memory of the tree grown by the single-threaded search
+      Benchmark_result memory_result;
+      memory_result.name = "tree_memory";
+      memory_result.board_size = board_size;
+      memory_result.iterations = result.iterations;
+      memory_result.bytes_per_node = result.bytes_per_node;
+      memory_result.tree_nodes = result.tree_nodes;
+      results.push_back(memory_result);
+    }
+  }
+}
+
+void write_json(const std::vector<Benchmark_result>& results,
+                std::ostream& os) {
+  os << "{\n  \"context\": {\n"
+     << "    \"hardware_threads\": " << std::thread::hardware_concurrency()
+     << ",\n    \"time_unit\": \"ns\"\n  },\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Benchmark_result& result = results[i];
+    os << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name << "/"
+       << result.board_size << "/threads:" << result.threads
+       << "\", \"benchmark\": \"" << result.name
+       << "\", \"board_size\": " << result.board_size
+       << ", \"threads\": " << result.threads
+       << ", \"iterations\": " << result.iterations
+       << ", \"real_time\": " << result.nanoseconds_per_iteration
+       << ", \"items_per_second\": " << result.items_per_second
+       << ", \"bytes_per_node\": " << result.bytes_per_node
+       << ", \"tree_nodes\": " << result.tree_nodes << "}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+void write_csv(const std::vector<Benchmark_result>& results,
+               std::ostream& os) {
+  os << "benchmark,board_size,threads,iterations,real_time_ns,"
+        "items_per_second,bytes_per_node,tree_nodes\n";
+  for (const Benchmark_result& result : results) {
+    os << result.name << "," << result.board_size << "," << result.threads
+       << "," << result.iterations << "," << result.nanoseconds_per_iteration
+       << "," << result.items_per_second << "," << result.bytes_per_node
+       << "," << result.tree_nodes << "\n";
+  }
+}
+
+/**
+ * @brief Parses a comma-separated list of positive integers.
+ */
+template <typename T>
+std::vector<T> parse_list(const std::string& text) {
+  std::vector<T> values;
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    long value = std::stol(item);
+    if (value <= 0) {
+      throw std::invalid_argument("List values must be positive.");
+    }
+    values.push_back(static_cast<T>(value));
+  }
+  return values;
+}
+
+Benchmark_options parse_options(int argc, char* argv[]) {
+  Benchmark_options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    std::size_t separator = argument.find('=');
+    std::string key = argument.substr(0, separator);
+    std::string value =
+        separator == std::string::npos ? "" : argument.substr(separator + 1);
+    if (key == "--format" && (value == "json" || value == "csv")) {
+      options.format = value;
+    } else if (key == "--sizes") {
+      options.board_sizes = parse_list<int>(value);
+      for (int board_size : options.board_sizes) {
+        if (board_size < 2 || board_size > Board::max_board_size) {
+          throw std::invalid_argument("Board sizes must be from 2 to " +
+                                      std::to_string(Board::max_board_size) +
+                                      ".");
+        }
+      }
+    } else if (key == "--threads") {
+      options.thread_counts = parse_list<unsigned int>(value);
+    } else if (key == "--min_time") {
+      options.min_time = std::stod(value);
+    } else if (key == "--search_time") {
+      options.search_time = std::stod(value);
+    } else {
+      throw std::invalid_argument("Unknown option: " + argument);
+    }
+  }
+  if (options.thread_counts.empty()) {
+    // 1, 2 and 4 threads, and every hardware thread
+    options.thread_counts = {1, 2, 4};
+    unsigned int hardware_threads = std::thread::hardware_concurrency();
+    if (hardware_threads > 4) {
+      options.thread_counts.push_back(hardware_threads);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+/**
+ * @brief Runs the benchmarks and writes their results to the standard output
+ * as JSON or CSV.
+ *
+ * Options:
+ *   --format=json|csv    The output format, JSON by default.
+ *   --sizes=5,7,...      The board sizes, 5 to 19 by default.
+ *   --threads=1,2,...    The thread counts of the search benchmarks, 1, 2, 4
+ *                        and all hardware threads by default.
+ *   --min_time=SECONDS   The minimum time of every micro benchmark.
+ *   --search_time=SECONDS The time of every search benchmark.
+ */
+int main(int argc, char* argv[]) {
+  Benchmark_options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what()
+              << "\nUsage: MCTS-Hex-benchmark [--format=json|csv] "
+                 "[--sizes=5,7,...] [--threads=1,2,...] [--min_time=SECONDS] "
+                 "[--search_time=SECONDS]\n";
+    return 1;
+  }
+  std::vector<Benchmark_result> results;
+  for (int board_size : options.board_sizes) {
+    std::cerr << "Benchmarking board size " << board_size << "...\n";
+    run_micro_benchmarks(board_size, options, results);
+    run_macro_benchmarks(board_size, options, results);
+  }
+  if (options.format == "csv") {
+    write_csv(results, std::cout);
+  } else {
+    write_json(results, std::cout);
+  }
+  return 0;
+}
@@ -3,18 +3,173 @@
 #include <algorithm>
 #include <cctype>
 #include <iostream>
+#include <numeric>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "iterator"
 
-Board::Board(int size)
-    : board_size(size),
-      board(size, std::vector<Cell_state>(size, Cell_state::Empty)) {
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BOARD_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOARD_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+constexpr int Board::max_board_size;
+constexpr int Board::bitboard_rows;
+constexpr int Board::max_cells;
+
+namespace {
+
+/**
+ * @brief Returns the index of the lowest set bit of a non-zero mask.
+ */
+inline int lowest_set_bit(std::uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * @brief Returns the number of set bits of a mask.
+ */
+inline int count_set_bits(std::uint32_t mask) {
+#if defined(_MSC_VER)
+  return static_cast<int>(__popcnt(mask));
+#else
+  return __builtin_popcount(mask);
+#endif
+}
+
+/**
+ * @brief Performs one step of the bitboard flood fill in place.
+ *
+ * Every reached cell spreads to its six hex neighbours: (x-1, y) and
+ * (x-1, y+1) in the row above, (x, y-1) and (x, y+1) in its own row, and
+ * (x+1, y-1) and (x+1, y) in the row below. The result is masked with the
+ * player's stones. Rows that were already updated in this step are read by the
+ * following rows, which only speeds up the fill since it is monotone.
+ *
+ * @param reached The reached cells, indexed like the board's bitboards.
+ * @param stones The player's stones.
+ * @param board_size The size of the board.
+ * @return True if any new cell was reached.
+ */
+inline bool grow_reached_cells(std::uint32_t* reached,
+                               const std::uint32_t* stones, int board_size) {
+#if defined(BOARD_USE_AVX2)
+  __m256i changed = _mm256_setzero_si256();
+  for (int row = 1; row <= board_size; row += 8) {
+    __m256i above =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reached + row - 1));
+    __m256i current =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reached + row));
+    __m256i below =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reached + row + 1));
+    __m256i own =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stones + row));
+    __m256i grown = _mm256_or_si256(current, _mm256_slli_epi32(current, 1));
+    grown = _mm256_or_si256(grown, _mm256_srli_epi32(current, 1));
+    grown = _mm256_or_si256(grown, above);
+    grown = _mm256_or_si256(grown, _mm256_srli_epi32(above, 1));
+    grown = _mm256_or_si256(grown, below);
+    grown = _mm256_or_si256(grown, _mm256_slli_epi32(below, 1));
+    grown = _mm256_and_si256(grown, own);
+    changed = _mm256_or_si256(changed, _mm256_xor_si256(grown, current));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(reached + row), grown);
+  }
+  return !_mm256_testz_si256(changed, changed);
+#elif defined(BOARD_USE_SSE2)
+  __m128i changed = _mm_setzero_si128();
+  for (int row = 1; row <= board_size; row += 4) {
+    __m128i above =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(reached + row - 1));
+    __m128i current =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(reached + row));
+    __m128i below =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(reached + row + 1));
+    __m128i own = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stones + row));
+    __m128i grown = _mm_or_si128(current, _mm_slli_epi32(current, 1));
+    grown = _mm_or_si128(grown, _mm_srli_epi32(current, 1));
+    grown = _mm_or_si128(grown, above);
+    grown = _mm_or_si128(grown, _mm_srli_epi32(above, 1));
+    grown = _mm_or_si128(grown, below);
+    grown = _mm_or_si128(grown, _mm_slli_epi32(below, 1));
+    grown = _mm_and_si128(grown, own);
+    changed = _mm_or_si128(changed, _mm_xor_si128(grown, current));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(reached + row), grown);
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi32(changed, _mm_setzero_si128())) !=
+         0xFFFF;
+#else
+  std::uint32_t changed = 0;
+  for (int row = 1; row <= board_size; ++row) {
+    std::uint32_t current = reached[row];
+    std::uint32_t grown = current | (current << 1) | (current >> 1) |
+                          reached[row - 1] | (reached[row - 1] >> 1) |
+                          reached[row + 1] | (reached[row + 1] << 1);
+    grown &= stones[row];
+    changed |= grown ^ current;
+    reached[row] = grown;
+  }
+  return changed != 0;
+#endif
+}
+
+/**
+ * @brief The keys of the Zobrist hash, one per cell of the largest board and
+ * colour, at index x * max_board_size + y. They are drawn from SplitMix64 with
+ * a fixed seed at compile time.
+ */
+struct Zobrist_keys {
+  std::uint64_t blue[Hex_adjacency::max_cells];
+  std::uint64_t red[Hex_adjacency::max_cells];
+
+  constexpr Zobrist_keys() : blue(), red() {
+    std::uint64_t seed = 0x2545f4914f6cdd1d;
+    for (int i = 0; i < 2 * Hex_adjacency::max_cells; ++i) {
+      seed += 0x9e3779b97f4a7c15;
+      std::uint64_t mixed = seed;
+      mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9;
+      mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111eb;
+      mixed ^= mixed >> 31;
+      if (i < Hex_adjacency::max_cells) {
+        blue[i] = mixed;
+      } else {
+        red[i - Hex_adjacency::max_cells] = mixed;
+      }
+    }
+  }
+};
+
+constexpr Zobrist_keys zobrist_keys;
+
+}  // namespace
+
+Board::Board(int size) : board_size(size), blue_stones(), red_stones() {
   if (size < 2) {
     throw std::invalid_argument("Board size cannot be less than 2.");
   }
+  if (size > max_board_size) {
+    throw std::invalid_argument("Board size cannot be greater than " +
+                                std::to_string(max_board_size) + ".");
+  }
+  adjacency = &Hex_adjacency::for_board_size(size);
+  // Every cell and virtual edge node starts out as a singleton set.
+  std::iota(set_parent.begin(), set_parent.end(), 0);
+  set_size.fill(1);
 }
 
 int Board::get_board_size() const { return board_size; }
@@ -26,19 +181,44 @@ bool Board::is_within_bounds(int move_x, int move_y) const {
 
 bool Board::is_valid_move(int move_x, int move_y) const {
   return is_within_bounds(move_x, move_y) &&
-         (board[move_x][move_y] == Cell_state::Empty);
+         get_cell_state(move_x, move_y) == Cell_state::Empty;
+}
+
+Cell_state Board::get_cell_state(int move_x, int move_y) const {
+  std::uint32_t column_bit = 1u << move_y;
+  if (blue_stones[move_x + 1] & column_bit) return Cell_state::Blue;
+  if (red_stones[move_x + 1] & column_bit) return Cell_state::Red;
+  return Cell_state::Empty;
 }
 
 std::vector<std::pair<int, int>> Board::get_valid_moves() const {
   std::vector<std::pair<int, int>> valid_moves;
+  valid_moves.reserve(static_cast<std::size_t>(board_size * board_size));
+  get_valid_moves(valid_moves);
+  return valid_moves;
+}
+
+void Board::get_valid_moves(
+    std::vector<std::pair<int, int>>& valid_moves) const {
+  valid_moves.clear();
+  std::uint32_t row_mask = (1u << board_size) - 1;
   for (int row = 0; row < board_size; ++row) {
-    for (int col = 0; col < board_size; ++col) {
-      if (is_valid_move(row, col)) {
-        valid_moves.emplace_back(row, col);
-      }
+    // Walk the set bits of the row's empty cells from the lowest column up.
+    std::uint32_t empty_cells =
+        ~(blue_stones[row + 1] | red_stones[row + 1]) & row_mask;
+    while (empty_cells) {
+      valid_moves.emplace_back(row, lowest_set_bit(empty_cells));
+      empty_cells &= empty_cells - 1;
     }
   }
-  return valid_moves;
+}
+
+int Board::get_empty_cell_count() const {
+  int stone_count = 0;
+  for (int row = 0; row < board_size; ++row) {
+    stone_count += count_set_bits(blue_stones[row + 1] | red_stones[row + 1]);
+  }
+  return board_size * board_size - stone_count;
 }
 
 void Board::make_move(int move_x, int move_y, Cell_state player) {
@@ -48,25 +228,132 @@ void Board::make_move(int move_x, int move_y, Cell_state player) {
                                 std::to_string(move_x) + ", " +
                                 std::to_string(move_y) + ")!");
   }
-  // If the move is valid, place the player's Cell_state on the board at the
-  // specified coordinates.
-  board[move_x][move_y] = player;
+  if (player == Cell_state::Empty) return;
+  // If the move is valid, set the cell's bit in the player's bitboard.
+  Bitboard& stones = (player == Cell_state::Blue) ? blue_stones : red_stones;
+  stones[move_x + 1] |= 1u << move_y;
+  hash ^= get_zobrist_key(move_x, move_y, player);
+  // Merge the new stone with its same-coloured neighbours.
+  int cell_index = move_x * board_size + move_y;
+  int merge_count_before_move = merge_count;
+  for (std::int16_t neighbour : adjacency->get_neighbours(cell_index)) {
+    if (neighbour != Hex_adjacency::off_board &&
+        (stones[adjacency->get_row(neighbour) + 1] >>
+             adjacency->get_column(neighbour) &
+         1u)) {
+      merge_sets(cell_index, neighbour);
+    }
+  }
+  // Merge the new stone with the virtual nodes of the edges it touches. Blue
+  // connects top to bottom, Red connects left to right.
+  std::uint8_t edge_flags = adjacency->get_edge_flags(cell_index);
+  if (player == Cell_state::Blue) {
+    if (edge_flags & Hex_adjacency::On_top_edge) {
+      merge_sets(cell_index, get_edge_node_index(Top_edge));
+    }
+    if (edge_flags & Hex_adjacency::On_bottom_edge) {
+      merge_sets(cell_index, get_edge_node_index(Bottom_edge));
+    }
+  } else if (player == Cell_state::Red) {
+    if (edge_flags & Hex_adjacency::On_left_edge) {
+      merge_sets(cell_index, get_edge_node_index(Left_edge));
+    }
+    if (edge_flags & Hex_adjacency::On_right_edge) {
+      merge_sets(cell_index, get_edge_node_index(Right_edge));
+    }
+  }
+  // Record the move so that it can be undone.
+  move_history[move_count] = static_cast<std::int16_t>(cell_index);
+  move_merge_counts[move_count] =
+      static_cast<std::uint8_t>(merge_count - merge_count_before_move);
+  ++move_count;
+}
+
+void Board::undo_move() {
+  if (move_count == 0) {
+    throw std::logic_error("There is no move to undo!");
+  }
+  --move_count;
+  int cell_index = move_history[move_count];
+  // Roll back the move's merges, most recent first.
+  for (int i = 0; i < move_merge_counts[move_count]; ++i) {
+    int attached_root = merge_history[--merge_count];
+    int parent_root = set_parent[attached_root];
+    set_size[parent_root] -= set_size[attached_root];
+    set_parent[attached_root] = static_cast<std::int16_t>(attached_root);
+  }
+  // Remove the stone from whichever bitboard holds it.
+  int column = adjacency->get_column(cell_index);
+  std::uint32_t column_bit = 1u << column;
+  int row = adjacency->get_row(cell_index);
+  hash ^= get_zobrist_key(row, column,
+                          (blue_stones[row + 1] & column_bit)
+                              ? Cell_state::Blue
+                              : Cell_state::Red);
+  blue_stones[row + 1] &= ~column_bit;
+  red_stones[row + 1] &= ~column_bit;
+}
+
+void Board::fill_cells_alternately(
+    const std::vector<std::pair<int, int>>& cells, Cell_state first_player) {
+  Bitboard* current_stones =
+      (first_player == Cell_state::Blue) ? &blue_stones : &red_stones;
+  Bitboard* other_stones =
+      (first_player == Cell_state::Blue) ? &red_stones : &blue_stones;
+  for (const auto& cell : cells) {
+    if (!is_valid_move(cell.first, cell.second)) {
+      throw std::invalid_argument("Invalid fill attempt at position (" +
+                                  std::to_string(cell.first) + ", " +
+                                  std::to_string(cell.second) + ")!");
+    }
+    (*current_stones)[cell.first + 1] |= 1u << cell.second;
+    std::swap(current_stones, other_stones);
+  }
+  // The new stones were not merged, so the winner has to be found by a flood
+  // fill from now on.
+  if (!cells.empty()) is_disjoint_set_current = false;
+}
+
+std::uint64_t Board::get_zobrist_key(int move_x, int move_y,
+                                     Cell_state player) {
+  int key_index = move_x * max_board_size + move_y;
+  return player == Cell_state::Blue ? zobrist_keys.blue[key_index]
+                                    : zobrist_keys.red[key_index];
+}
+
+int Board::get_edge_node_index(Edge_node edge) const {
+  return board_size * board_size + static_cast<int>(edge);
+}
+
+int Board::find_set_root(int element_index) const {
+  while (set_parent[element_index] != element_index) {
+    element_index = set_parent[element_index];
+  }
+  return element_index;
+}
+
+void Board::merge_sets(int first_element_index, int second_element_index) {
+  int first_root = find_set_root(first_element_index);
+  int second_root = find_set_root(second_element_index);
+  if (first_root == second_root) return;
+  // Attach the smaller set below the larger one to keep the trees shallow.
+  if (set_size[first_root] < set_size[second_root]) {
+    std::swap(first_root, second_root);
+  }
+  set_parent[second_root] = static_cast<std::int16_t>(first_root);
+  set_size[first_root] += set_size[second_root];
+  merge_history[merge_count++] = static_cast<std::int16_t>(second_root);
 }
 
 bool Board::are_cells_connected(int first_cell_x, int first_cell_y,
                                 int second_cell_x, int second_cell_y) const {
-  // Iterate over all possible neighboring cells of the first cell
-  for (std::size_t i = 0; i < neighbour_offset_x.size(); ++i) {
-    int neighbour_cell_x = first_cell_x + neighbour_offset_x[i];
-    int neighbour_cell_y = first_cell_y + neighbour_offset_y[i];
-    if (is_within_bounds(neighbour_cell_x, neighbour_cell_y) &&
-        neighbour_cell_x == second_cell_x &&
-        neighbour_cell_y == second_cell_y) {
-      return true;
-    }
+  if (!is_within_bounds(first_cell_x, first_cell_y) ||
+      !is_within_bounds(second_cell_x, second_cell_y)) {
+    return false;
   }
-  // If none of the neighboring cells match the second cell, return false.
-  return false;
+  // Look for the second cell among the neighbours of the first cell
+  return adjacency->are_adjacent(first_cell_x * board_size + first_cell_y,
+                                 second_cell_x * board_size + second_cell_y);
 }
 
 bool Board::depth_first_search(
@@ -80,15 +367,15 @@ bool Board::depth_first_search(
   game_board_snapshot[start_x][start_y] = Cell_state::Empty;
 
   // For each neighboring cell...
-  for (std::size_t i = 0; i < neighbour_offset_x.size(); ++i) {
-    int new_x = start_x + neighbour_offset_x[i];
-    int new_y = start_y + neighbour_offset_y[i];
+  for (std::int16_t neighbour :
+       adjacency->get_neighbours(start_x * board_size + start_y)) {
+    if (neighbour == Hex_adjacency::off_board) continue;
+    int new_x = adjacency->get_row(neighbour);
+    int new_y = adjacency->get_column(neighbour);
 
-    // If the neighboring cell is within the bounds of the board and has the
-    // same symbol as the player_symbol...
-    if (is_within_bounds(new_x, new_y) &&
+    // If the neighboring cell has the same symbol as the player_symbol...
+    if (game_board_snapshot[new_x][new_y] == player_symbol &&
         // Recursively perform a DFS from the neighboring cell.
-        game_board_snapshot[new_x][new_y] == player_symbol &&
         depth_first_search(new_x, new_y, destination_x, destination_y,
                            player_symbol, game_board_snapshot)) {
       // If a path is found, restore the player's symbol in the current cell and
@@ -104,42 +391,51 @@ bool Board::depth_first_search(
   return false;
 }
 
-Cell_state Board::check_winner() const {
-  // Check for player B (top to bottom)
-  for (int top_row_index = 0; top_row_index < board_size; ++top_row_index) {
-    if (board[0][top_row_index] == Cell_state::Blue) {
-      for (int bottom_row_index = 0; bottom_row_index < board_size;
-           ++bottom_row_index) {
-        // Copy the current board to pass to the depth_first_search function
-        std::vector<std::vector<Cell_state>> board_copy = board;
-        // If a path is found between the top and bottom of the board for player
-        // Blue, return Blue as the winner
-        if (board[board_size - 1][bottom_row_index] == Cell_state::Blue &&
-            depth_first_search(0, top_row_index, board_size - 1,
-                               bottom_row_index, Cell_state::Blue,
-                               board_copy)) {
-          return Cell_state::Blue;
-        }
-      }
+bool Board::is_connected_by_flood_fill(Cell_state player) const {
+  const Bitboard& stones =
+      (player == Cell_state::Blue) ? blue_stones : red_stones;
+  Bitboard reached = {};
+  // Seed the fill with the player's stones on their first edge: the top row
+  // for Blue and the leftmost column for Red.
+  if (player == Cell_state::Blue) {
+    reached[1] = stones[1];
+  } else {
+    for (int row = 1; row <= board_size; ++row) {
+      reached[row] = stones[row] & 1u;
     }
   }
-  // Check for player R (left to right)
-  for (int left_column_index = 0; left_column_index < board_size;
-       ++left_column_index) {
-    if (board[left_column_index][0] == Cell_state::Red) {
-      for (int right_column_index = 0; right_column_index < board_size;
-           ++right_column_index) {
-        // Copy the current board to pass to the depth_first_search function
-        std::vector<std::vector<Cell_state>> board_copy = board;
-        // If a path is found between the left and right of the board for player
-        // Red, return Red as the winner
-        if (board[right_column_index][board_size - 1] == Cell_state::Red &&
-            depth_first_search(left_column_index, 0, right_column_index,
-                               board_size - 1, Cell_state::Red, board_copy)) {
-          return Cell_state::Red;
-        }
+  std::uint32_t last_column_bit = 1u << (board_size - 1);
+  while (true) {
+    // Stop as soon as the opposite edge has been reached.
+    if (player == Cell_state::Blue) {
+      if (reached[board_size]) return true;
+    } else {
+      for (int row = 1; row <= board_size; ++row) {
+        if (reached[row] & last_column_bit) return true;
       }
     }
+    if (!grow_reached_cells(reached.data(), stones.data(), board_size)) {
+      return false;
+    }
+  }
+}
+
+Cell_state Board::check_winner() const {
+  // Bulk-filled boards have no up-to-date disjoint sets to consult.
+  if (!is_disjoint_set_current) {
+    if (is_connected_by_flood_fill(Cell_state::Blue)) return Cell_state::Blue;
+    if (is_connected_by_flood_fill(Cell_state::Red)) return Cell_state::Red;
+    return Cell_state::Empty;
+  }
+  // Blue wins if the top and bottom edges belong to the same set
+  if (find_set_root(get_edge_node_index(Top_edge)) ==
+      find_set_root(get_edge_node_index(Bottom_edge))) {
+    return Cell_state::Blue;
+  }
+  // Red wins if the left and right edges belong to the same set
+  if (find_set_root(get_edge_node_index(Left_edge)) ==
+      find_set_root(get_edge_node_index(Right_edge))) {
+    return Cell_state::Red;
   }
   // If no paths are found for either player, return Empty to signify that there
   // is no winner yet
@@ -155,7 +451,7 @@ void Board::display_board(std::ostream& os = std::cout) const {
     os << std::string(2 * row, ' ');
     for (size_t col = 0; col < static_cast<std::size_t>(board_size); ++col) {
       // Print the state of the cell.
-      os << board[row][col];
+      os << get_cell_state(static_cast<int>(row), static_cast<int>(col));
       // Print a line (-) between cells in the same row, except for the last
       // cell.
       if (col < static_cast<std::size_t>(board_size) - 1) {
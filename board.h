@@ -2,11 +2,13 @@
 #define BOARD_H
 
 #include <array>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "cell_state.h"
+#include "hex_adjacency.h"
 
 /**
  * @brief The Board class represents the game board for a game of Hex.
@@ -31,19 +33,41 @@
  * The Board class also overloads the << operator to enable printing the board
  * directly to an output stream.
  *
- * The board is represented internally as a 2D vector of Cell_state enums. The
- * Cell_state enum represents the state of a cell on the board (empty, occupied
- * by player 1, or occupied by player 2).
+ * The board is represented internally as one bitboard per player. Each
+ * bitboard is a fixed-size array of 32-bit row masks, where bit y of row x is
+ * set if the player occupies the cell (x, y). All storage is sized at compile
+ * time for boards of up to max_board_size, so copying a board never allocates.
+ *
+ * Alongside the cells, the board maintains a disjoint-set (union-find)
+ * structure over the cells plus four virtual nodes, one for each edge of the
+ * board. Every move merges the new stone with its same-coloured neighbours and
+ * with the edges it touches, so check_winner() only has to compare the set
+ * roots of the two edges of each player. Boards filled in bulk with
+ * fill_cells_alternately() determine the winner with a shift-and-mask flood
+ * fill over the bitboards instead, which is vectorised with SSE2 or AVX2 when
+ * they are available.
+ *
+ * The board also keeps a Zobrist hash of its stones up to date, so game states
+ * that were reached by different move orders can be recognised as the same.
  *
  * Note: This class does not handle player turns or game logic beyond the
  * mechanics of the game board itself.
  */
 class Board {
  public:
+  /**
+   * @brief The largest supported board size, which is the largest size used
+   * in tournament play.
+   */
+  static constexpr int max_board_size = Hex_adjacency::max_board_size;
+
   /**
    * @brief Constructor for Board class.
    *
    * @param size: Integer to set the size of the board.
+   *
+   * @exception std::invalid_argument If the size is less than 2 or greater
+   * than max_board_size.
    */
   Board(int size);
 
@@ -72,6 +96,16 @@ class Board {
    */
   bool is_valid_move(int move_x, int move_y) const;
 
+  /**
+   * @brief Returns the state of a cell on the board.
+   *
+   * @param move_x: The x-coordinate (row) of the cell.
+   * @param move_y: The y-coordinate (column) of the cell.
+   * @return The Cell_state of the cell. The cell must be within the bounds of
+   * the board.
+   */
+  Cell_state get_cell_state(int move_x, int move_y) const;
+
   /**
    * @brief Get all valid moves on the board.
    *
@@ -84,11 +118,32 @@ class Board {
    */
   std::vector<std::pair<int, int>> get_valid_moves() const;
 
+  /**
+   * @brief Get all valid moves on the board without allocating a new vector.
+   *
+   * Works like get_valid_moves(), but writes the moves into a vector provided
+   * by the caller, which is cleared first. No memory is allocated if the
+   * vector's capacity already covers the number of cells.
+   *
+   * @param valid_moves Receives the row and column indices of the valid moves.
+   */
+  void get_valid_moves(std::vector<std::pair<int, int>>& valid_moves) const;
+
+  /**
+   * @brief Returns the number of empty cells, i.e. of valid moves, with one
+   * population count per row.
+   */
+  int get_empty_cell_count() const;
+
   /**
    * @brief Makes a move on the board on behalf of a player. The move is made at
    * the specified x and y coordinates. If the move is invalid, an exception is
    * thrown.
    *
+   * The new stone is merged in the disjoint-set structure with every adjacent
+   * stone of the same colour and with the virtual edge nodes of the player's
+   * edges that it touches.
+   *
    * @param move_x: The x-coordinate (row) of the move.
    * @param move_y: The y-coordinate (column) of the move.
    * @param player: The player making the move (Cell_state).
@@ -98,12 +153,68 @@ class Board {
    */
   void make_move(int move_x, int move_y, Cell_state player);
 
+  /**
+   * @brief Takes back the most recent move made with make_move().
+   *
+   * The stone is removed and every merge that the move performed in the
+   * disjoint-set structure is rolled back in reverse order, so a sequence of
+   * moves can be applied and undone without copying the board. Stones placed
+   * with fill_cells_alternately() are not recorded and cannot be undone.
+   *
+   * @exception std::logic_error If no move has been made on the board.
+   */
+  void undo_move();
+
+  /**
+   * @brief Places stones on the given cells in order, alternating between the
+   * two players and starting with first_player.
+   *
+   * This is a bulk operation intended for random playouts that fill the whole
+   * board. Only the bitboards are updated, so from then on check_winner()
+   * determines the winner with a flood fill instead of the disjoint-set
+   * structure.
+   *
+   * @param cells: The cells to fill, as (row, column) pairs.
+   * @param first_player: The player who claims the first cell (Cell_state).
+   *
+   * @exception std::invalid_argument If any of the cells is not a valid move.
+   */
+  void fill_cells_alternately(const std::vector<std::pair<int, int>>& cells,
+                              Cell_state first_player);
+
+  /**
+   * @brief Returns the Zobrist hash of the stones placed with make_move().
+   *
+   * The hash is the exclusive or of one fixed random key per occupied cell
+   * and colour, see get_zobrist_key(), so two boards holding the same stones
+   * have the same hash, whatever the order in which the stones were placed.
+   * make_move() and undo_move() update it with a single exclusive or. Stones
+   * placed with fill_cells_alternately() are not included.
+   *
+   * @return The hash, which is 0 for an empty board.
+   */
+  std::uint64_t get_hash() const { return hash; }
+
+  /**
+   * @brief Returns the key that a stone contributes to the hash of a board.
+   *
+   * The keys do not depend on the size of the board and are the same in
+   * every run of the program.
+   *
+   * @param move_x: The x-coordinate (row) of the stone.
+   * @param move_y: The y-coordinate (column) of the stone.
+   * @param player: The colour of the stone, Blue or Red.
+   * @return The key of the stone.
+   */
+  static std::uint64_t get_zobrist_key(int move_x, int move_y,
+                                       Cell_state player);
+
   /**
    * @brief Checks if two cells on the board are connected.
    *
    * This function checks if two given cells on the board are connected by
-   * comparing the coordinates of the second cell to the coordinates of all the
-   * neighboring cells of the first cell. In the game of Hex, two cells are
+   * looking the second cell up among the neighbours of the first cell in the
+   * shared adjacency table. In the game of Hex, two cells are
    * considered connected if they are adjacent to each other in any of the six
    * directions.
    *
@@ -124,8 +235,8 @@ class Board {
    * from the start cell to the destination cell.
    *
    * The DFS is performed recursively, starting from the start cell and
-   * exploring the neighboring cells. A cell is considered reachable if it is
-   * within the bounds of the board and has the same symbol as the
+   * exploring the neighboring cells, which are taken from the shared adjacency
+   * table. A cell is considered reachable if it has the same symbol as the
    * player_symbol. During the search, the explored cells are temporarily marked
    * as empty in the game_board_snapshot to prevent loops.
    *
@@ -142,6 +253,9 @@ class Board {
    *
    * @return True if there is a path from the start cell to the destination
    * cell, else False.
+   *
+   * @notes Kept only for debugging and not used in the game. check_winner()
+   * relies on the incrementally maintained disjoint-set structure instead.
    */
   bool depth_first_search(
       int start_x, int start_y, int destination_x, int destination_y,
@@ -154,8 +268,11 @@ class Board {
    * This function checks for a winning path for both players (Blue and Red).
    * For Blue, it checks for a path from any cell in the top row to any cell in
    * the bottom row. For Red, it checks for a path from any cell in the leftmost
-   * column to any cell in the rightmost column. The function utilizes the
-   * depth_first_search method to find a path.
+   * column to any cell in the rightmost column. Since make_move() keeps the
+   * disjoint-set structure up to date, a path exists exactly when the virtual
+   * nodes of the two edges share a set root, so the check takes logarithmic
+   * time in the worst case and does not allocate. After
+   * fill_cells_alternately(), a bitboard flood fill is used instead.
    *
    * @return The Cell_state of the winning player. If there is no winner, it
    * returns Cell_state::Empty.
@@ -185,29 +302,150 @@ class Board {
   friend std::ostream& operator<<(std::ostream& os, const Board& board);
 
  private:
+  /**
+   * @brief The number of row masks in a bitboard. Row x of the board is
+   * stored at index x + 1, so that the flood fill can read the rows above and
+   * below any board row without bounds checks, and the array is padded to a
+   * whole number of 256-bit vectors.
+   */
+  static constexpr int bitboard_rows = 32;
+
+  /**
+   * @brief The largest number of cells on a supported board.
+   */
+  static constexpr int max_cells = max_board_size * max_board_size;
+
+  /**
+   * @brief A bitboard holding one 32-bit mask per row. The padding rows are
+   * always zero.
+   */
+  using Bitboard = std::array<std::uint32_t, bitboard_rows>;
+
   /**
    * @brief The size of the board.
    */
   int board_size;
 
   /**
-   * @brief A 2D vector representing the game board. Each Cell_state
-   * signifies the state of a cell in the board - it can be either empty,
-   * or occupied by one of the two players.
+   * @brief The cells occupied by the Blue player.
+   */
+  Bitboard blue_stones;
+
+  /**
+   * @brief The cells occupied by the Red player.
+   */
+  Bitboard red_stones;
+
+  /**
+   * @brief False once cells have been filled in bulk, which leaves the
+   * disjoint-set structure out of date.
+   */
+  bool is_disjoint_set_current = true;
+
+  /**
+   * @brief The neighbours and edges of every cell for the size of the board.
+   * The table is shared by all boards of the same size, so copying a board
+   * only copies the pointer.
+   */
+  const Hex_adjacency* adjacency;
+
+  /**
+   * @brief Indices of the virtual edge nodes in the disjoint-set structure,
+   * relative to the number of cells on the board. The cells themselves occupy
+   * indices [0, board_size * board_size).
+   */
+  enum Edge_node { Top_edge, Bottom_edge, Left_edge, Right_edge };
+
+  /**
+   * @brief The parent of each element in the disjoint-set structure. A root is
+   * its own parent. The four elements following the cells are the virtual
+   * edge nodes.
+   */
+  std::array<std::int16_t, max_cells + 4> set_parent;
+
+  /**
+   * @brief The number of elements in the set of each root, used for union by
+   * size. Only the entries of roots are meaningful.
+   */
+  std::array<std::int16_t, max_cells + 4> set_size;
+
+  /**
+   * @brief The cell indices of the moves made with make_move(), in order.
+   */
+  std::array<std::int16_t, max_cells> move_history;
+
+  /**
+   * @brief The number of merges performed by each move in move_history.
    */
-  std::vector<std::vector<Cell_state>> board;
+  std::array<std::uint8_t, max_cells> move_merge_counts;
 
   /**
-   * @brief An array storing the x offsets for the six possible directions
-   * in the Hex game. It is used to find neighbouring cells on the board.
+   * @brief The roots that were attached below another root by each merge, in
+   * order. Undoing a merge detaches the root again, which is possible since
+   * roots are never moved by path compression.
    */
-  std::array<int, 6> neighbour_offset_x = {-1, -1, 0, 1, 1, 0};
+  std::array<std::int16_t, max_cells + 4> merge_history;
 
   /**
-   * @brief An array storing the y offsets for the six possible directions
-   * in the Hex game. It is used to find neighbouring cells on the board.
+   * @brief The Zobrist hash of the stones placed with make_move().
+   */
+  std::uint64_t hash = 0;
+
+  /**
+   * @brief The number of recorded moves in move_history.
+   */
+  int move_count = 0;
+
+  /**
+   * @brief The number of recorded merges in merge_history.
+   */
+  int merge_count = 0;
+
+  /**
+   * @brief Returns the index of a virtual edge node in the disjoint-set
+   * structure.
+   *
+   * @param edge: The edge of the board.
+   * @return The index of the virtual node of the edge.
+   */
+  int get_edge_node_index(Edge_node edge) const;
+
+  /**
+   * @brief Finds the root of the set containing the given element.
+   *
+   * Union by size keeps every tree logarithmically shallow, so no path
+   * compression is needed and the lookup can stay const.
+   *
+   * @param element_index: The index of the cell or virtual edge node.
+   * @return The index of the root of the set.
+   */
+  int find_set_root(int element_index) const;
+
+  /**
+   * @brief Merges the sets containing the two given elements, attaching the
+   * smaller set below the root of the larger one. The merge is recorded in
+   * merge_history so that undo_move() can roll it back.
+   *
+   * @param first_element_index: The index of the first element.
+   * @param second_element_index: The index of the second element.
+   */
+  void merge_sets(int first_element_index, int second_element_index);
+
+  /**
+   * @brief Checks whether a player connects their two edges with a flood fill
+   * over the bitboards.
+   *
+   * Starting from the player's stones on their first edge, every step grows
+   * the reached set by its six hex neighbours at once, row masks shifted by
+   * one bit giving the neighbours in the same and adjacent rows, and masks it
+   * with the player's stones. Steps are processed eight (AVX2) or four (SSE2)
+   * rows at a time when the instruction sets are available. The fill stops as
+   * soon as the opposite edge is reached or the reached set stops growing.
+   *
+   * @param player: The player whose connection is checked (Cell_state).
+   * @return True if the player's stones connect their two edges, else False.
    */
-  std::array<int, 6> neighbour_offset_y = {0, 1, 1, 0, -1, -1};
+  bool is_connected_by_flood_fill(Cell_state player) const;
 };
 
 #endif
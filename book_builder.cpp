@@ -0,0 +1,212 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "cell_state.h"
+#include "logger.h"
+#include "mcts_agent.h"
+#include "opening_book.h"
+
+namespace {
+
+/**
+ * @brief The options of a book build, taken from the command line.
+ */
+struct Book_options {
+  std::vector<int> board_sizes = {11, 13};
+  // The number of moves from the empty board up to which the book reaches
+  int depth = 3;
+  // The time, or if set, the number of iterations, of every search
+  double search_time = 10.;
+  int max_iterations = 0;
+  unsigned int thread_count = std::thread::hardware_concurrency();
+  std::string output = "opening_book.bin";
+};
+
+/**
+ * @brief Adds a game state to the states to search, unless the state, or the
+ * state rotated by half a turn, was added before.
+ */
+void add_state(const Board& board, std::unordered_set<std::uint64_t>& hashes,
+               std::vector<Board>& states) {
+  if (hashes.count(board.get_hash()) != 0 ||
+      hashes.count(Opening_book::get_rotated_hash(board)) != 0) {
+    return;
+  }
+  hashes.insert(board.get_hash());
+  states.push_back(board);
+}
+
+/**
+ * @brief Searches the early game states of one board size and adds their
+ * moves to the entries, writing the book after every move number.
+ *
+ * The book plays either colour, and the opponent may play any move. So the
+ * states at move number n + 2 are those that follow a state at move number n
+ * by the book move and any reply, starting from the empty board and from
+ * every first move.
+ */
+void build_book(int board_size, const Book_options& options,
+                std::vector<Opening_book::Entry>& entries) {
+  Search_limits search_limits;
+  if (options.max_iterations > 0) {
+    search_limits.max_iterations = options.max_iterations;
+  } else {
+    search_limits.max_decision_time = std::chrono::milliseconds(
+        static_cast<std::int64_t>(options.search_time * 1000.));
+  }
+  Mcts_agent agent(1.41, search_limits, options.thread_count > 1, false,
+                   Playout_mode::Move_by_move, 0, 0., nullptr,
+                   options.thread_count);
+  std::unordered_set<std::uint64_t> hashes;
+  // The states to search at every move number
+  std::vector<std::vector<Board>> states(
+      static_cast<std::size_t>(options.depth));
+  const Board empty_board(board_size);
+  add_state(empty_board, hashes, states[0]);
+  if (options.depth > 1) {
+    for (const auto& move : empty_board.get_valid_moves()) {
+      Board board = empty_board;
+      board.make_move(move.first, move.second, Cell_state::Blue);
+      add_state(board, hashes, states[1]);
+    }
+  }
+  for (int move_number = 0; move_number < options.depth; ++move_number) {
+    const Cell_state player =
+        move_number % 2 == 0 ? Cell_state::Blue : Cell_state::Red;
+    const std::vector<Board>& current_states = states[move_number];
+    for (std::size_t i = 0; i < current_states.size(); ++i) {
+      std::cerr << "Board size " << board_size << ", move " << move_number + 1
+                << ": state " << i + 1 << " of " << current_states.size()
+                << "\r" << std::flush;
+      Search_statistics statistics;
+      const std::pair<int, int> move =
+          agent.choose_move(current_states[i], player, statistics);
+      Opening_book::Entry entry = Opening_book::Entry();
+      entry.hash = current_states[i].get_hash();
+      entry.iterations = static_cast<std::uint32_t>(statistics.iterations);
+      entry.board_size = static_cast<std::uint8_t>(board_size);
+      entry.move_x = static_cast<std::int8_t>(move.first);
+      entry.move_y = static_cast<std::int8_t>(move.second);
+      entries.push_back(entry);
+      if (move_number + 2 >= options.depth) {
+        continue;
+      }
+      // Follow the book move with every reply of the opponent
+      Board board = current_states[i];
+      board.make_move(move.first, move.second, player);
+      if (board.check_winner() != Cell_state::Empty) {
+        continue;
+      }
+      for (const auto& reply : board.get_valid_moves()) {
+        Board next_board = board;
+        next_board.make_move(reply.first, reply.second, get_opponent(player));
+        if (next_board.check_winner() == Cell_state::Empty) {
+          add_state(next_board, hashes, states[move_number + 2]);
+        }
+      }
+    }
+    std::cerr << "\n";
+    // Keep the finished move numbers if the build is interrupted
+    Opening_book::write(options.output, entries);
+  }
+}
+
+/**
+ * @brief Parses a comma-separated list of board sizes.
+ */
+std::vector<int> parse_board_sizes(const std::string& text) {
+  std::vector<int> board_sizes;
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    int board_size = std::stoi(item);
+    if (board_size < 2 || board_size > Board::max_board_size) {
+      throw std::invalid_argument("Board sizes must be from 2 to " +
+                                  std::to_string(Board::max_board_size) + ".");
+    }
+    board_sizes.push_back(board_size);
+  }
+  return board_sizes;
+}
+
+Book_options parse_options(int argc, char* argv[]) {
+  Book_options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    std::size_t separator = argument.find('=');
+    std::string key = argument.substr(0, separator);
+    std::string value =
+        separator == std::string::npos ? "" : argument.substr(separator + 1);
+    if (key == "--sizes") {
+      options.board_sizes = parse_board_sizes(value);
+    } else if (key == "--depth") {
+      options.depth = std::stoi(value);
+    } else if (key == "--time") {
+      options.search_time = std::stod(value);
+    } else if (key == "--iterations") {
+      options.max_iterations = std::stoi(value);
+    } else if (key == "--threads") {
+      options.thread_count = static_cast<unsigned int>(std::stoul(value));
+    } else if (key == "--output" && !value.empty()) {
+      options.output = value;
+    } else {
+      throw std::invalid_argument("Unknown option: " + argument);
+    }
+  }
+  if (options.depth < 1 || options.max_iterations < 0 ||
+      (options.max_iterations == 0 && options.search_time < 0.001)) {
+    throw std::invalid_argument(
+        "The depth and the search limit must be positive.");
+  }
+  return options;
+}
+
+}  // namespace
+
+/**
+ * @brief Searches the early game states of some board sizes and writes the
+ * chosen moves as an opening book, see Opening_book.
+ *
+ * Options:
+ *   --sizes=11,13,...    The board sizes, 11 and 13 by default.
+ *   --depth=MOVES        The number of moves the book reaches, 3 by default.
+ *   --time=SECONDS       The time of every search, 10 seconds by default.
+ *   --iterations=N       The iterations of every search, instead of a time.
+ *   --threads=N          The search threads, all hardware threads by default.
+ *   --output=PATH        The book file, opening_book.bin by default.
+ */
+int main(int argc, char* argv[]) {
+  Book_options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what()
+              << "\nUsage: MCTS-Hex-book [--sizes=11,13,...] [--depth=MOVES] "
+                 "[--time=SECONDS] [--iterations=N] [--threads=N] "
+                 "[--output=PATH]\n";
+    return 1;
+  }
+  // Keep the agents from printing between the progress lines
+  Logger::instance(false)->set_silent(true);
+  std::vector<Opening_book::Entry> entries;
+  try {
+    for (int board_size : options.board_sizes) {
+      build_book(board_size, options, entries);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  std::cerr << "Wrote " << entries.size() << " game states to "
+            << options.output << ".\n";
+  return 0;
+}
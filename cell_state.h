@@ -42,4 +42,14 @@ enum class Cell_state {
  */
 std::ostream& operator<<(std::ostream& os, const Cell_state& state);
 
+/**
+ * @brief Returns the opponent of a player.
+ *
+ * @param player The player, either Blue or Red.
+ * @return Red for Blue and Blue for Red.
+ */
+inline Cell_state get_opponent(Cell_state player) {
+  return (player == Cell_state::Blue) ? Cell_state::Red : Cell_state::Blue;
+}
+
 #endif  // CELL_STATE_H
\ No newline at end of file
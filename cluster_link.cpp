@@ -0,0 +1,290 @@
+#include "cluster_link.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The hash, the flags, the number of entries and of changed entries
+constexpr std::size_t header_size = 8 + 1 + 2 + 2;
+// The cell, the visits and the wins of a changed entry
+constexpr std::size_t entry_size = 2 + 4 + 4;
+
+// The messages are written in network byte order
+void write_bytes(std::vector<std::uint8_t>& buffer, std::uint64_t value,
+                 int byte_count) {
+  for (int i = byte_count - 1; i >= 0; --i) {
+    buffer.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+std::uint64_t read_bytes(const std::uint8_t*& data, int byte_count) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < byte_count; ++i) {
+    value = (value << 8) | *data++;
+  }
+  return value;
+}
+
+std::runtime_error socket_error(const std::string& action) {
+  return std::runtime_error("Cluster: cannot " + action + ": " +
+                            std::strerror(errno));
+}
+
+#ifndef _WIN32
+void send_all(int socket, const std::uint8_t* data, std::size_t size) {
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  // Report a closed connection as an error instead of a signal
+  flags = MSG_NOSIGNAL;
+#endif
+  while (size > 0) {
+    ssize_t sent = send(socket, data, size, flags);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw socket_error("send the statistics");
+    }
+    data += sent;
+    size -= static_cast<std::size_t>(sent);
+  }
+}
+
+void receive_all(int socket, std::uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t received = recv(socket, data, size, 0);
+    if (received == 0) {
+      throw std::runtime_error("Cluster: a machine left the cluster.");
+    }
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw socket_error("receive the statistics");
+    }
+    data += received;
+    size -= static_cast<std::size_t>(received);
+  }
+}
+
+// The messages are small and every round waits for them, so they are sent
+// right away instead of being coalesced
+void disable_coalescing(int socket) {
+  int is_enabled = 1;
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &is_enabled,
+             sizeof(is_enabled));
+}
+
+addrinfo* resolve(const char* host, std::uint16_t port, int flags) {
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = flags;
+  addrinfo* addresses = nullptr;
+  int result = getaddrinfo(host, std::to_string(port).c_str(), &hints,
+                           &addresses);
+  if (result != 0) {
+    throw std::runtime_error(std::string("Cluster: cannot resolve the hub: ") +
+                             gai_strerror(result));
+  }
+  return addresses;
+}
+#endif
+
+}  // namespace
+
+Cluster_link::Cluster_link(const Cluster_config& config) : config(config) {
+#ifdef _WIN32
+  throw std::runtime_error("Clusters are only supported on POSIX systems.");
+#else
+  if (config.hub_address.empty()) {
+    if (config.peer_count == 0) {
+      throw std::invalid_argument("A cluster needs at least one peer.");
+    }
+    addrinfo* addresses = resolve(nullptr, config.port, AI_PASSIVE);
+    int listener = socket(addresses->ai_family, addresses->ai_socktype,
+                          addresses->ai_protocol);
+    if (listener < 0) {
+      freeaddrinfo(addresses);
+      throw socket_error("create a socket");
+    }
+    int is_enabled = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &is_enabled,
+               sizeof(is_enabled));
+    if (bind(listener, addresses->ai_addr, addresses->ai_addrlen) != 0 ||
+        listen(listener, static_cast<int>(config.peer_count)) != 0) {
+      std::runtime_error error = socket_error("listen for peers");
+      freeaddrinfo(addresses);
+      close(listener);
+      throw error;
+    }
+    freeaddrinfo(addresses);
+    // Wait until every peer has joined
+    while (sockets.size() < config.peer_count) {
+      int peer = accept(listener, nullptr, nullptr);
+      if (peer < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::runtime_error error = socket_error("accept a peer");
+        close(listener);
+        for (int socket : sockets) {
+          close(socket);
+        }
+        throw error;
+      }
+      disable_coalescing(peer);
+      sockets.push_back(peer);
+    }
+    close(listener);
+  } else {
+    addrinfo* addresses = resolve(config.hub_address.c_str(), config.port, 0);
+    // Take the first address of the hub that accepts the connection
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+      int hub = socket(address->ai_family, address->ai_socktype,
+                       address->ai_protocol);
+      if (hub < 0) {
+        continue;
+      }
+      if (connect(hub, address->ai_addr, address->ai_addrlen) == 0) {
+        disable_coalescing(hub);
+        sockets.push_back(hub);
+        break;
+      }
+      close(hub);
+    }
+    freeaddrinfo(addresses);
+    if (sockets.empty()) {
+      throw socket_error("connect to the hub");
+    }
+  }
+#endif
+}
+
+Cluster_link::~Cluster_link() {
+#ifndef _WIN32
+  for (int socket : sockets) {
+    close(socket);
+  }
+#endif
+}
+
+bool Cluster_link::exchange(std::uint64_t position_hash,
+                            bool is_search_finished,
+                            std::vector<std::uint64_t>& statistics) {
+  if (!config.hub_address.empty()) {
+    // A peer sends its counts and receives those of all other machines
+    Message own_message;
+    own_message.position_hash = position_hash;
+    own_message.is_search_finished = is_search_finished;
+    own_message.statistics = statistics;
+    send_message(sockets[0], own_message);
+    Message reply;
+    receive_message(sockets[0], reply);
+    std::fill(statistics.begin(), statistics.end(), 0);
+    if (reply.position_hash == position_hash &&
+        reply.statistics.size() == statistics.size()) {
+      statistics = reply.statistics;
+    }
+    return reply.is_search_finished;
+  }
+  // The hub sums the counts of all machines that search the same game state
+  std::vector<Message> peer_messages(sockets.size());
+  std::vector<std::uint64_t> total = statistics;
+  bool is_every_search_finished = is_search_finished;
+  for (std::size_t i = 0; i < sockets.size(); ++i) {
+    Message& message = peer_messages[i];
+    receive_message(sockets[i], message);
+    is_every_search_finished =
+        is_every_search_finished && message.is_search_finished;
+    if (message.position_hash != position_hash ||
+        message.statistics.size() != total.size()) {
+      message.statistics.assign(total.size(), 0);
+      continue;
+    }
+    for (std::size_t j = 0; j < total.size(); ++j) {
+      total[j] += message.statistics[j];
+    }
+  }
+  // Every machine receives the counts of all others
+  Message reply;
+  reply.position_hash = position_hash;
+  reply.is_search_finished = is_every_search_finished;
+  for (std::size_t i = 0; i < sockets.size(); ++i) {
+    reply.statistics = total;
+    for (std::size_t j = 0; j < total.size(); ++j) {
+      reply.statistics[j] -= peer_messages[i].statistics[j];
+    }
+    send_message(sockets[i], reply);
+  }
+  for (std::size_t j = 0; j < total.size(); ++j) {
+    statistics[j] = total[j] - statistics[j];
+  }
+  return is_every_search_finished;
+}
+
+void Cluster_link::send_message(int socket, const Message& message) {
+  if (message.statistics.size() > 0xffff) {
+    throw std::invalid_argument("Too many statistics for one message.");
+  }
+  std::uint64_t changed_count = 0;
+  for (std::uint64_t entry : message.statistics) {
+    changed_count += entry != 0;
+  }
+  buffer.clear();
+  write_bytes(buffer, message.position_hash, 8);
+  write_bytes(buffer, message.is_search_finished, 1);
+  write_bytes(buffer, message.statistics.size(), 2);
+  write_bytes(buffer, changed_count, 2);
+  // Only the entries that changed are sent
+  for (std::size_t i = 0; i < message.statistics.size(); ++i) {
+    if (message.statistics[i] != 0) {
+      write_bytes(buffer, i, 2);
+      write_bytes(buffer, message.statistics[i] >> 32, 4);
+      write_bytes(buffer, message.statistics[i] & 0xffffffff, 4);
+    }
+  }
+#ifndef _WIN32
+  send_all(socket, buffer.data(), buffer.size());
+#endif
+}
+
+void Cluster_link::receive_message(int socket, Message& message) {
+#ifndef _WIN32
+  buffer.resize(header_size);
+  receive_all(socket, buffer.data(), header_size);
+  const std::uint8_t* data = buffer.data();
+  message.position_hash = read_bytes(data, 8);
+  message.is_search_finished = read_bytes(data, 1) != 0;
+  const std::size_t entry_count = read_bytes(data, 2);
+  const std::size_t changed_count = read_bytes(data, 2);
+  if (changed_count > entry_count) {
+    throw std::runtime_error("Cluster: received a malformed message.");
+  }
+  message.statistics.assign(entry_count, 0);
+  buffer.resize(changed_count * entry_size);
+  receive_all(socket, buffer.data(), buffer.size());
+  data = buffer.data();
+  for (std::size_t i = 0; i < changed_count; ++i) {
+    const std::size_t index = read_bytes(data, 2);
+    const std::uint64_t visits = read_bytes(data, 4);
+    const std::uint64_t wins = read_bytes(data, 4);
+    if (index >= entry_count) {
+      throw std::runtime_error("Cluster: received a malformed message.");
+    }
+    message.statistics[index] = (visits << 32) | wins;
+  }
+#endif
+}
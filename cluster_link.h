@@ -0,0 +1,129 @@
+#ifndef CLUSTER_LINK_H
+#define CLUSTER_LINK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct Cluster_config
+ * @brief How a machine takes part in a cluster of machines that search the
+ * same game state together, see Cluster_link.
+ */
+struct Cluster_config {
+  /**
+   * @brief The host name or address of the machine that hosts the cluster,
+   * or empty if this machine hosts it.
+   */
+  std::string hub_address;
+
+  /**
+   * @brief The TCP port on which the hub accepts the other machines.
+   */
+  std::uint16_t port = 0;
+
+  /**
+   * @brief The number of other machines that join the cluster. Only used by
+   * the hub, which waits for all of them before the first search.
+   */
+  unsigned int peer_count = 0;
+
+  /**
+   * @brief How often the machines exchange their root statistics while they
+   * search. Only the interval of the hub matters, since every exchange waits
+   * for it.
+   */
+  std::chrono::milliseconds sync_interval{100};
+};
+
+/**
+ * @class Cluster_link
+ *
+ * @brief The TCP connections over which the Mcts_agents on several machines
+ * exchange the visit and win counts of the children of their roots while
+ * they search the same game state.
+ *
+ * The machines form a star: one hub, which every other machine, a peer,
+ * connects to. The counts are exchanged in rounds. In every round, each
+ * machine sends the counts it added since its last round, and the hub
+ * replies to every peer with the sum of the counts that all other machines
+ * sent. Only the children whose counts changed are sent, each as its cell
+ * and the two counts, so a round moves a few kilobytes at most.
+ *
+ * A machine whose search has ended keeps taking part in the rounds, with no
+ * counts of its own, until the hub reports that the searches of all machines
+ * have ended. By then every machine has received all counts of the others,
+ * so they all hold the same sums and choose the same move.
+ *
+ * Every message carries the Zobrist hash of the game state, and counts for
+ * another game state or board size are ignored, so a machine that falls out
+ * of step does not corrupt the others. If a connection breaks, the link
+ * throws. The link uses POSIX sockets and cannot be constructed on Windows.
+ *
+ * The link is non-copyable. Its destructor closes the connections.
+ */
+class Cluster_link {
+ public:
+  /**
+   * @brief Joins or hosts a cluster. A hub blocks until all peers have
+   * connected.
+   *
+   * @param config The address and port of the hub, the number of peers and
+   * the interval of the exchanges.
+   *
+   * @throws std::invalid_argument if the hub expects no peers.
+   * @throws std::runtime_error if the connections cannot be established, or
+   * on Windows.
+   */
+  explicit Cluster_link(const Cluster_config& config);
+
+  ~Cluster_link();
+
+  Cluster_link(const Cluster_link&) = delete;
+  Cluster_link& operator=(const Cluster_link&) = delete;
+
+  /**
+   * @brief Returns how often the statistics are to be exchanged.
+   */
+  std::chrono::milliseconds get_sync_interval() const {
+    return config.sync_interval;
+  }
+
+  /**
+   * @brief Runs one round of the exchange. Blocks until the hub has heard
+   * from every machine.
+   *
+   * @param position_hash The Zobrist hash of the game state being searched.
+   * @param is_search_finished Whether the search of this machine has ended.
+   * @param statistics The packed visit and win counts that this machine
+   * added to every root child since its last round, indexed by the cell of
+   * the child's move. Receives the sum of the counts that all other machines
+   * added since their last round.
+   * @return True once the searches of all machines have ended, which makes
+   * this the last round for the game state.
+   *
+   * @throws std::runtime_error if a connection breaks.
+   */
+  bool exchange(std::uint64_t position_hash, bool is_search_finished,
+                std::vector<std::uint64_t>& statistics);
+
+ private:
+  // The contents of one message of a round
+  struct Message {
+    std::uint64_t position_hash = 0;
+    bool is_search_finished = false;
+    std::vector<std::uint64_t> statistics;
+  };
+
+  void send_message(int socket, const Message& message);
+  void receive_message(int socket, Message& message);
+
+  Cluster_config config;
+  // The hub holds one socket per peer, and a peer the socket to the hub
+  std::vector<int> sockets;
+  // The encoded message, kept to avoid allocations between rounds
+  std::vector<std::uint8_t> buffer;
+};
+
+#endif  // CLUSTER_LINK_H
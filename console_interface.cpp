@@ -3,8 +3,11 @@
 #include <chrono>
 #include <thread>
 #include <climits>
+#include <cstdint>
 
 #include "board.h"
+#include "cluster_link.h"
+#include "opening_book.h"
 
 bool is_integer(const std::string& s) {
   std::string::const_iterator it = s.begin();
@@ -99,8 +102,37 @@ std::unique_ptr<Mcts_player> create_mcts_agent(
     const std::string& agent_prompt) {
   std::cout << "\nInitializing " << agent_prompt << ":\n";
 
-  int max_decision_time_ms = get_parameter_within_bounds(
-      "Enter max decision time in milliseconds (at least 100): ", 100, INT_MAX);
+  Search_limits search_limits;
+  if (get_yes_or_no_response("Would you like to limit the agent by the number "
+                             "of iterations instead of time? (y/n): ") == 'y') {
+    search_limits.max_iterations = get_parameter_within_bounds(
+        "Enter max iterations per move (at least 1): ", 1, INT_MAX);
+  } else {
+    search_limits.max_decision_time =
+        std::chrono::milliseconds(get_parameter_within_bounds(
+            "Enter max decision time in milliseconds (at least 100): ", 100,
+            INT_MAX));
+  }
+  if (get_yes_or_no_response("Would you like to cap the number of nodes in the "
+                             "search tree? (y/n): ") == 'y') {
+    search_limits.max_tree_nodes =
+        static_cast<std::uint32_t>(get_parameter_within_bounds(
+            "Enter max tree nodes (between 1000 and 100000000): ", 1000,
+            100000000));
+  }
+  if (get_yes_or_no_response("Would you like the agent to merge positions "
+                             "reached by different move orders? (y/n): ") ==
+      'y') {
+    search_limits.transposition_table_entries =
+        static_cast<std::uint32_t>(get_parameter_within_bounds(
+            "Enter transposition table entries (between 1024 and "
+            "100000000): ",
+            1024, 100000000));
+  }
+  search_limits.is_early_stop_enabled =
+      (get_yes_or_no_response("Would you like the agent to stop early once its "
+                              "best move is unlikely to change? (y/n): ") ==
+       'y');
 
   double exploration_constant = 1.41;
   if (get_yes_or_no_response("Would you like to change the default exploration "
@@ -114,14 +146,86 @@ std::unique_ptr<Mcts_player> create_mcts_agent(
            "Would you like to parallelize the agent? (y/n): ") == 'y');
 
   bool is_verbose = false;
+  Parallel_mode parallel_mode = Parallel_mode::Shared_tree;
   if (!is_parallelized) {
     is_verbose = (get_yes_or_no_response(
                       "Would you like to enable verbose mode? (y/n): ") == 'y');
+  } else if (get_yes_or_no_response(
+                 "Would you like each thread to grow its own tree and merge "
+                 "the results at the end? (y/n): ") == 'y') {
+    parallel_mode = Parallel_mode::Root_trees;
+  }
+
+  Playout_mode playout_mode = Playout_mode::Move_by_move;
+  if (get_yes_or_no_response("Would you like the agent to restore its bridges "
+                             "when they are cut in its playouts? (y/n): ") ==
+      'y') {
+    playout_mode = Playout_mode::Bridge_responses;
+  } else if (get_yes_or_no_response(
+                 "Would you like the agent to fill the whole board "
+                 "in each playout and check the winner once? "
+                 "(y/n): ") == 'y') {
+    playout_mode = Playout_mode::Fill_and_evaluate;
+  }
+
+  double rave_equivalence = 0.;
+  if (get_yes_or_no_response("Would you like the agent to credit every move "
+                             "of a playout as if it were played first "
+                             "(RAVE)? (y/n): ") == 'y') {
+    rave_equivalence = get_parameter_within_bounds(
+        "Enter the number of visits at which a move's own statistics count as "
+        "much as its RAVE statistics (between 1 and 100000): ",
+        1.0, 100000.0);
+  }
+
+  bool is_pondering = false;
+  if (!is_verbose) {
+    is_pondering = (get_yes_or_no_response(
+                        "Would you like the agent to keep thinking during the "
+                        "opponent's turn? (y/n): ") == 'y');
+  }
+
+  std::shared_ptr<Cluster_link> cluster_link;
+  if (get_yes_or_no_response("Would you like the agent to search every move "
+                             "together with agents on other machines? "
+                             "(y/n): ") == 'y') {
+    Cluster_config cluster_config;
+    cluster_config.port = static_cast<std::uint16_t>(
+        get_parameter_within_bounds(
+            "Enter the port of the cluster (between 1024 and 65535): ", 1024,
+            65535));
+    if (get_yes_or_no_response("Will this machine host the cluster? (y/n): ") ==
+        'y') {
+      cluster_config.peer_count =
+          static_cast<unsigned int>(get_parameter_within_bounds(
+              "Enter the number of other machines (between 1 and 64): ", 1,
+              64));
+      cluster_config.sync_interval =
+          std::chrono::milliseconds(get_parameter_within_bounds(
+              "Enter the interval between exchanges of the statistics in "
+              "milliseconds (between 10 and 10000): ",
+              10, 10000));
+      std::cout << "Waiting for the other machines to join...\n";
+    } else {
+      std::cout << "Enter the address of the hosting machine: ";
+      std::cin >> cluster_config.hub_address;
+    }
+    cluster_link = std::make_shared<Cluster_link>(cluster_config);
+  }
+
+  std::shared_ptr<const Opening_book> opening_book;
+  if (get_yes_or_no_response("Would you like the agent to play its first "
+                             "moves from an opening book? (y/n): ") == 'y') {
+    std::string book_path;
+    std::cout << "Enter the path of the opening book: ";
+    std::cin >> book_path;
+    opening_book = std::make_shared<const Opening_book>(book_path);
   }
 
   return std::make_unique<Mcts_player>(
-      exploration_constant, std::chrono::milliseconds(max_decision_time_ms),
-      is_parallelized, is_verbose);
+      exploration_constant, search_limits, is_parallelized, is_verbose,
+      playout_mode, is_pondering, rave_equivalence, parallel_mode,
+      cluster_link, opening_book);
 }
 
 void countdown(int seconds) {
@@ -290,17 +394,17 @@ The robots in this implementation are powered by a AI agent using a powerful str
 
 This implementation of MCTS consists of four main phases:
 
-1. Expansion: From the root node (representing the current game state), child nodes are found by detecting the moves allowed by the game state.
+1. Selection: Starting from the root node (representing the current game state), the child with the most promising score of Upper Confidence Bound applied to Trees (UCT) is followed down the tree until a leaf is reached.
 
-2. Selection: A child with the most promising score of Upper Confidence Bound applied to Trees (UCT) is selected for a random playout.
+2. Expansion: Unless the game is already decided at the leaf, its child nodes are found by detecting the moves allowed by its game state, and the most promising one is selected for a random playout.
 
-3. Simulation: A simulation is run from the child according to the default policy; in this case, a random game is played out.
+3. Simulation: A simulation is run from the child according to the default policy; in this case, a random game is played out. The game can either be played move by move until someone connects their sides, or the board can be filled in a random order at once and the winner determined a single time, which is much faster and leads to the same results since a full Hex board always has exactly one winner.
 
-4. Backpropagation: The result of the simulation is backpropagated through the tree. The parent and the chosen child node have their visit count incremented and their value updated.
+4. Backpropagation: The result of the simulation is backpropagated through the tree. Every node on the path from the root to the chosen node has its visit count incremented and its value updated.
 
-This process is repeated until the computational budget (based on time) is exhausted. The agent then selects the move that leads to the most promising child node.
+This process is repeated until the computational budget is exhausted, so the tree keeps growing deeper the more time the agent is given. The budget is a decision time, a number of iterations, or both, and the size of the tree can be capped as well. The agent can also stop before its budget is used up once the remaining budget is unlikely to change its choice. The agent then selects the move that leads to the most promising child of the root. The agent keeps its tree between moves: once the opponent has replied, the node for the resulting position becomes the new root, so the statistics gathered for it during the previous search are not lost. The agent can also ponder, i.e. keep searching in the background while the opponent is thinking, and continue from that tree when the opponent's move arrives. Optionally, the agent uses Rapid Action Value Estimation (RAVE): a playout then also counts for every move a player made in it, as if that move had been played first, which gives new nodes useful statistics much sooner.
 
-In this implementation, the MCTS agent also supports parallel simulations by running multiple threads, each executing an MCTS iteration. The non-parallelised agent can run in verbose mode, outputting detailed information about each MCTS iteration, which can be a valuable tool for understanding the decision-making process of the AI.
+In this implementation, the MCTS agent also supports parallel search by running a pool of threads, each executing complete MCTS iterations on the shared tree. A pending simulation counts as a loss for its nodes until its result arrives, which spreads the threads out over different branches. The non-parallelised agent can run in verbose mode, outputting detailed information about each MCTS iteration, which can be a valuable tool for understanding the decision-making process of the AI.
 
 It should be noted that while MCTS does incorporate randomness (through the simulation phase), it is not a purely random algorithm. It uses the results of previous iterations to make informed decisions, and over time it builds a more accurate representation of the search space.
 
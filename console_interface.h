@@ -80,8 +80,8 @@ double get_parameter_within_bounds<double>(const std::string& prompt,
  * parameters.
  *
  * This function prompts the user for various parameters to initialize the MCTS
- * agent, such as maximum decision time, exploration constant, parallelization,
- * and verbosity.
+ * agent, such as search limits, exploration constant, parallelization,
+ * verbosity, playout mode, and pondering.
  *
  * @param agent_prompt The string used to indicate the agent being initialized.
  * @return A unique pointer to the MCTS agent.
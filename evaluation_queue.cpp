@@ -0,0 +1,80 @@
+#include "evaluation_queue.h"
+
+#include <algorithm>
+
+Evaluation_queue::Evaluation_queue(Leaf_evaluator& evaluator)
+    : evaluator(evaluator) {}
+
+void Evaluation_queue::start(unsigned int worker_count, int board_size) {
+  std::lock_guard<std::mutex> lock(mutex);
+  active_worker_count = worker_count;
+  // Split a batch evenly between the workers
+  leaves_per_worker =
+      std::max<std::size_t>(1, evaluator.get_max_batch_size() /
+                                   std::max(worker_count, 1u));
+  pending_batch.reset(board_size);
+  requests.clear();
+}
+
+std::size_t Evaluation_queue::get_leaves_per_worker() const {
+  return leaves_per_worker;
+}
+
+void Evaluation_queue::evaluate(const Leaf_batch& leaves,
+                                std::vector<float>& win_probabilities) {
+  std::exception_ptr exception;
+  std::unique_lock<std::mutex> lock(mutex);
+  // The pending batch cannot take leaves while it is being evaluated
+  batch_evaluated.wait(lock, [this]() { return !is_evaluating; });
+  requests.push_back({&win_probabilities, pending_batch.get_leaf_count(),
+                      leaves.get_leaf_count(), &exception});
+  pending_batch.append(leaves);
+  if (pending_batch.get_leaf_count() >= evaluator.get_max_batch_size() ||
+      requests.size() == active_worker_count) {
+    evaluate_pending_batch(lock);
+  } else {
+    unsigned long generation = batch_generation;
+    batch_evaluated.wait(
+        lock, [this, generation]() { return batch_generation != generation; });
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void Evaluation_queue::finish_worker() {
+  std::unique_lock<std::mutex> lock(mutex);
+  batch_evaluated.wait(lock, [this]() { return !is_evaluating; });
+  --active_worker_count;
+  // The remaining workers may all be waiting for this worker's leaves
+  if (!requests.empty() && requests.size() == active_worker_count) {
+    evaluate_pending_batch(lock);
+  }
+}
+
+void Evaluation_queue::evaluate_pending_batch(
+    std::unique_lock<std::mutex>& lock) {
+  is_evaluating = true;
+  std::exception_ptr exception;
+  lock.unlock();
+  try {
+    batch_results.resize(pending_batch.get_leaf_count());
+    evaluator.evaluate(pending_batch, batch_results);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  lock.lock();
+  for (const Request& request : requests) {
+    if (exception) {
+      *request.exception = exception;
+      continue;
+    }
+    auto first = batch_results.begin() + request.first_leaf;
+    request.win_probabilities->assign(first, first + request.leaf_count);
+  }
+  requests.clear();
+  pending_batch.reset(pending_batch.board_size);
+  ++batch_generation;
+  is_evaluating = false;
+  batch_evaluated.notify_all();
+}
@@ -0,0 +1,110 @@
+#ifndef EVALUATION_QUEUE_H
+#define EVALUATION_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include "leaf_evaluator.h"
+
+/**
+ * @class Evaluation_queue
+ *
+ * @brief Collects the leaves of several search workers into batches for a
+ * Leaf_evaluator and hands the results back to the workers.
+ *
+ * A worker queues its leaves with evaluate() and waits until the batch holding
+ * them has been evaluated. The batch is evaluated as soon as it holds
+ * get_max_batch_size() leaves of the evaluator, or as soon as every worker
+ * still searching is waiting for it, so a search never stalls for want of
+ * leaves. The worker whose leaves complete the batch runs the evaluator
+ * itself, while the other workers sleep on a condition variable.
+ *
+ * Leaves queued while a batch is being evaluated wait for the next batch. The
+ * queue is prepared for a search with start(), and every worker calls
+ * finish_worker() when it stops searching.
+ */
+class Evaluation_queue {
+ public:
+  /**
+   * @brief Constructs a queue for an evaluator.
+   *
+   * @param evaluator The evaluator that the batches are handed to. It must
+   * outlive the queue.
+   */
+  explicit Evaluation_queue(Leaf_evaluator& evaluator);
+
+  // Non-copyable and non-movable, since workers wait on it
+  Evaluation_queue(const Evaluation_queue&) = delete;
+  Evaluation_queue& operator=(const Evaluation_queue&) = delete;
+
+  /**
+   * @brief Prepares the queue for a search. Must not be called while workers
+   * are using the queue.
+   *
+   * @param worker_count The number of workers that search at the same time.
+   * @param board_size The side length of the boards of the search.
+   */
+  void start(unsigned int worker_count, int board_size);
+
+  /**
+   * @brief Returns how many leaves a worker should collect before it calls
+   * evaluate(), so that the leaves of all workers together fill a batch.
+   */
+  std::size_t get_leaves_per_worker() const;
+
+  /**
+   * @brief Queues the leaves of a worker and waits until they are evaluated.
+   *
+   * @param leaves The leaves of the calling worker.
+   * @param win_probabilities Receives the probability that the player to move
+   * wins at each of the leaves, in the order of the leaves.
+   * @throws Any exception thrown by the evaluator for the batch holding the
+   * leaves.
+   */
+  void evaluate(const Leaf_batch& leaves,
+                std::vector<float>& win_probabilities);
+
+  /**
+   * @brief Tells the queue that a worker stopped searching, so that the other
+   * workers no longer wait for its leaves.
+   */
+  void finish_worker();
+
+ private:
+  /**
+   * @brief A worker waiting for the evaluation of its leaves.
+   */
+  struct Request {
+    std::vector<float>* win_probabilities;
+    std::size_t first_leaf;
+    std::size_t leaf_count;
+    std::exception_ptr* exception;
+  };
+
+  /**
+   * @brief Evaluates the pending batch with the lock released, delivers the
+   * results to the waiting workers and wakes them up.
+   *
+   * @param lock The lock on the mutex, held on entry and on return.
+   */
+  void evaluate_pending_batch(std::unique_lock<std::mutex>& lock);
+
+  Leaf_evaluator& evaluator;
+  std::mutex mutex;
+  std::condition_variable batch_evaluated;
+  Leaf_batch pending_batch;
+  std::vector<Request> requests;
+  std::vector<float> batch_results;
+  unsigned int active_worker_count = 0;
+  std::size_t leaves_per_worker = 1;
+  // Set while a worker evaluates the pending batch without holding the lock
+  bool is_evaluating = false;
+  // Incremented for every evaluated batch, so that workers can tell whether
+  // their batch is done
+  unsigned long batch_generation = 0;
+};
+
+#endif  // EVALUATION_QUEUE_H
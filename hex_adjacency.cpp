@@ -0,0 +1,82 @@
+#include "hex_adjacency.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr int Hex_adjacency::max_board_size;
+constexpr int Hex_adjacency::max_cells;
+constexpr int Hex_adjacency::direction_count;
+constexpr std::int16_t Hex_adjacency::off_board;
+
+namespace {
+
+// The offsets of the six neighbours in ring order
+constexpr int neighbour_offset_x[Hex_adjacency::direction_count] = {
+    -1, -1, 0, 1, 1, 0};
+constexpr int neighbour_offset_y[Hex_adjacency::direction_count] = {
+    0, 1, 1, 0, -1, -1};
+
+}  // namespace
+
+Hex_adjacency::Hex_adjacency(int board_size)
+    : board_size(board_size),
+      neighbours(),
+      edge_flags(),
+      rows(),
+      columns() {
+  if (board_size < 2 || board_size > max_board_size) {
+    throw std::invalid_argument("There is no adjacency table for size " +
+                                std::to_string(board_size) + ".");
+  }
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      int cell_index = x * board_size + y;
+      rows[cell_index] = static_cast<std::uint8_t>(x);
+      columns[cell_index] = static_cast<std::uint8_t>(y);
+      for (int direction = 0; direction < direction_count; ++direction) {
+        int neighbour_x = x + neighbour_offset_x[direction];
+        int neighbour_y = y + neighbour_offset_y[direction];
+        bool is_on_board = neighbour_x >= 0 && neighbour_x < board_size &&
+                           neighbour_y >= 0 && neighbour_y < board_size;
+        neighbours[cell_index][direction] =
+            is_on_board
+                ? static_cast<std::int16_t>(neighbour_x * board_size +
+                                            neighbour_y)
+                : off_board;
+      }
+      edge_flags[cell_index] = static_cast<std::uint8_t>(
+          (x == 0 ? On_top_edge : 0) |
+          (x == board_size - 1 ? On_bottom_edge : 0) |
+          (y == 0 ? On_left_edge : 0) |
+          (y == board_size - 1 ? On_right_edge : 0));
+    }
+  }
+}
+
+const Hex_adjacency& Hex_adjacency::for_board_size(int board_size) {
+  // Built on first use. The initialization of a local static is thread-safe.
+  static const std::vector<Hex_adjacency> tables = []() {
+    std::vector<Hex_adjacency> all_tables;
+    all_tables.reserve(max_board_size - 1);
+    for (int size = 2; size <= max_board_size; ++size) {
+      all_tables.emplace_back(size);
+    }
+    return all_tables;
+  }();
+  if (board_size < 2 || board_size > max_board_size) {
+    throw std::invalid_argument("There is no adjacency table for size " +
+                                std::to_string(board_size) + ".");
+  }
+  return tables[board_size - 2];
+}
+
+bool Hex_adjacency::are_adjacent(int first_cell_index,
+                                 int second_cell_index) const {
+  for (std::int16_t neighbour : neighbours[first_cell_index]) {
+    if (neighbour == second_cell_index) {
+      return true;
+    }
+  }
+  return false;
+}
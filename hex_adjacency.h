@@ -0,0 +1,141 @@
+#ifndef HEX_ADJACENCY_H
+#define HEX_ADJACENCY_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @class Hex_adjacency
+ *
+ * @brief A precomputed table of the neighbours and edges of every cell of a
+ * Hex board of one size.
+ *
+ * Cells are addressed by their index x * board_size + y. For every cell, the
+ * table holds the indices of its six neighbours in ring order, i.e. each
+ * neighbour is adjacent to the next one and the last to the first:
+ *
+ *   0: (x - 1, y)      1: (x - 1, y + 1)   2: (x, y + 1)
+ *   3: (x + 1, y)      4: (x + 1, y - 1)   5: (x, y - 1)
+ *
+ * Directions that lead off the board hold off_board, so a direction always
+ * keeps its position in the ring, which pattern matching around a cell relies
+ * on. Every cell also has flags for the edges of the board it lies on, and
+ * its row and column.
+ *
+ * The tables of all supported sizes are built once, on first use, and shared
+ * by all boards and threads. They are never modified afterwards, so they can
+ * be read concurrently without synchronisation.
+ */
+class Hex_adjacency {
+ public:
+  /**
+   * @brief The largest board size with a table.
+   */
+  static constexpr int max_board_size = 19;
+
+  /**
+   * @brief The largest number of cells on a board with a table.
+   */
+  static constexpr int max_cells = max_board_size * max_board_size;
+
+  /**
+   * @brief The number of neighbours of a cell in the middle of the board.
+   */
+  static constexpr int direction_count = 6;
+
+  /**
+   * @brief The neighbour index of a direction that leads off the board.
+   */
+  static constexpr std::int16_t off_board = -1;
+
+  /**
+   * @brief The flags for the edges a cell lies on. Blue connects the top and
+   * bottom edges, Red connects the left and right edges.
+   */
+  enum Edge_flag : std::uint8_t {
+    On_top_edge = 1,     ///< The cell is in the first row.
+    On_bottom_edge = 2,  ///< The cell is in the last row.
+    On_left_edge = 4,    ///< The cell is in the first column.
+    On_right_edge = 8    ///< The cell is in the last column.
+  };
+
+  /**
+   * @brief The neighbours of a cell in ring order.
+   */
+  using Neighbours = std::array<std::int16_t, direction_count>;
+
+  /**
+   * @brief Returns the shared table for a board size. It is thread-safe.
+   *
+   * @param board_size The side length of the board, from 2 to
+   * max_board_size.
+   * @return The table, which lives until the program ends.
+   * @throws std::invalid_argument If there is no table for the size.
+   */
+  static const Hex_adjacency& for_board_size(int board_size);
+
+  /**
+   * @brief Returns the side length of the board the table describes.
+   */
+  int get_board_size() const { return board_size; }
+
+  /**
+   * @brief Returns the neighbours of a cell in ring order, with off_board for
+   * the directions that leave the board.
+   *
+   * @param cell_index The index of the cell.
+   */
+  const Neighbours& get_neighbours(int cell_index) const {
+    return neighbours[cell_index];
+  }
+
+  /**
+   * @brief Returns the Edge_flag values of the edges a cell lies on, combined
+   * with bitwise or.
+   *
+   * @param cell_index The index of the cell.
+   */
+  std::uint8_t get_edge_flags(int cell_index) const {
+    return edge_flags[cell_index];
+  }
+
+  /**
+   * @brief Returns the row of a cell, which saves a division.
+   *
+   * @param cell_index The index of the cell.
+   */
+  int get_row(int cell_index) const { return rows[cell_index]; }
+
+  /**
+   * @brief Returns the column of a cell, which saves a division.
+   *
+   * @param cell_index The index of the cell.
+   */
+  int get_column(int cell_index) const { return columns[cell_index]; }
+
+  /**
+   * @brief Returns whether two cells are adjacent.
+   *
+   * @param first_cell_index The index of the first cell.
+   * @param second_cell_index The index of the second cell.
+   */
+  bool are_adjacent(int first_cell_index, int second_cell_index) const;
+
+  /**
+   * @brief Builds the table for a board size. Use for_board_size() to get the
+   * shared table instead.
+   *
+   * @param board_size The side length of the board, from 2 to
+   * max_board_size.
+   */
+  explicit Hex_adjacency(int board_size);
+
+ private:
+  int board_size;
+  std::array<Neighbours, max_cells> neighbours;
+  std::array<std::uint8_t, max_cells> edge_flags;
+  std::array<std::uint8_t, max_cells> rows;
+  std::array<std::uint8_t, max_cells> columns;
+};
+
+#endif  // HEX_ADJACENCY_H
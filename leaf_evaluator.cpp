@@ -0,0 +1,68 @@
+#include "leaf_evaluator.h"
+
+#include <stdexcept>
+
+void Leaf_batch::reset(int board_size) {
+  this->board_size = board_size;
+  cells.clear();
+  players_to_move.clear();
+}
+
+void Leaf_batch::add_leaf(const Board& board, Cell_state player_to_move) {
+  if (board.get_board_size() != board_size) {
+    throw std::invalid_argument(
+        "The board size of a leaf does not match its batch.");
+  }
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      cells.push_back(static_cast<std::int8_t>(board.get_cell_state(x, y)));
+    }
+  }
+  players_to_move.push_back(player_to_move);
+}
+
+void Leaf_batch::append(const Leaf_batch& other) {
+  if (other.board_size != board_size) {
+    throw std::invalid_argument(
+        "Only batches of one board size can be merged.");
+  }
+  cells.insert(cells.end(), other.cells.begin(), other.cells.end());
+  players_to_move.insert(players_to_move.end(), other.players_to_move.begin(),
+                         other.players_to_move.end());
+}
+
+Random_playout_evaluator::Random_playout_evaluator(std::uint64_t random_seed,
+                                                   std::size_t max_batch_size)
+    : max_batch_size(max_batch_size == 0 ? 1 : max_batch_size),
+      random_generator(random_seed) {}
+
+std::size_t Random_playout_evaluator::get_max_batch_size() const {
+  return max_batch_size;
+}
+
+void Random_playout_evaluator::evaluate(const Leaf_batch& batch,
+                                        std::vector<float>& win_probabilities) {
+  const int board_size = batch.board_size;
+  const std::size_t cell_count =
+      static_cast<std::size_t>(board_size) * board_size;
+  for (std::size_t leaf = 0; leaf < batch.get_leaf_count(); ++leaf) {
+    // Set up the leaf on a board
+    Board board(board_size);
+    const std::int8_t* cells = batch.cells.data() + leaf * cell_count;
+    for (int x = 0; x < board_size; ++x) {
+      for (int y = 0; y < board_size; ++y) {
+        Cell_state state = static_cast<Cell_state>(cells[x * board_size + y]);
+        if (state != Cell_state::Empty) {
+          board.make_move(x, y, state);
+        }
+      }
+    }
+    // Fill the empty cells in random order and see who connected their sides
+    board.get_valid_moves(empty_cells);
+    random_generator.shuffle(empty_cells);
+    Cell_state player_to_move = batch.players_to_move[leaf];
+    board.fill_cells_alternately(empty_cells, player_to_move);
+    win_probabilities[leaf] =
+        board.check_winner() == player_to_move ? 1.f : 0.f;
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef LEAF_EVALUATOR_H
+#define LEAF_EVALUATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "board.h"
+#include "cell_state.h"
+#include "xoshiro_generator.h"
+
+/**
+ * @struct Leaf_batch
+ * @brief A batch of game states at leaves of the search tree, laid out for
+ * evaluation in one go.
+ *
+ * The cells of all leaves are stored in one contiguous array, leaf after leaf.
+ * Every leaf occupies board_size * board_size entries in row-major order, so
+ * the cell (x, y) of leaf i is at index (i * board_size + x) * board_size + y.
+ * An entry holds the value of its Cell_state: 0 for an empty cell, 1 for a
+ * blue stone and 2 for a red stone. The array can thus be handed to a tensor
+ * library or SIMD code as it is.
+ */
+struct Leaf_batch {
+  /**
+   * @brief The side length of the boards in the batch.
+   */
+  int board_size = 0;
+
+  /**
+   * @brief The cells of all leaves, as described above.
+   */
+  std::vector<std::int8_t> cells;
+
+  /**
+   * @brief The player to move at every leaf.
+   */
+  std::vector<Cell_state> players_to_move;
+
+  /**
+   * @brief Returns the number of leaves in the batch.
+   */
+  std::size_t get_leaf_count() const { return players_to_move.size(); }
+
+  /**
+   * @brief Removes all leaves and sets the size of the boards to come. The
+   * memory of the batch is kept for the next leaves.
+   *
+   * @param board_size The side length of the boards to come.
+   */
+  void reset(int board_size);
+
+  /**
+   * @brief Appends the game state on a board as a new leaf.
+   *
+   * @param board The game state. Its size must be the size of the batch.
+   * @param player_to_move The player to move in the game state.
+   */
+  void add_leaf(const Board& board, Cell_state player_to_move);
+
+  /**
+   * @brief Appends all leaves of another batch of the same board size.
+   *
+   * @param other The batch to append.
+   */
+  void append(const Leaf_batch& other);
+};
+
+/**
+ * @class Leaf_evaluator
+ *
+ * @brief An interface for estimating the outcome of the game at leaves of the
+ * search tree, used by Mcts_agent in place of its own playouts.
+ *
+ * The agent collects leaves from all of its workers and hands them over in
+ * batches of up to get_max_batch_size() leaves, so an expensive evaluator, e.g.
+ * a neural network on a GPU, can amortise its overhead over many leaves. The
+ * agent calls evaluate() from one thread at a time, but not always from the
+ * same one, so an implementation needs no locking of its own. For the same
+ * reason, an evaluator must not be shared by agents that search at the same
+ * time, e.g. while one of them is pondering.
+ */
+class Leaf_evaluator {
+ public:
+  virtual ~Leaf_evaluator() = default;
+
+  /**
+   * @brief Returns the largest number of leaves the evaluator accepts in one
+   * batch. Must be at least 1 and must not change while an agent uses the
+   * evaluator.
+   */
+  virtual std::size_t get_max_batch_size() const = 0;
+
+  /**
+   * @brief Estimates, for every leaf of a batch, the probability that the
+   * player to move wins the game.
+   *
+   * @param batch The leaves to evaluate. None of them is a finished game.
+   * @param win_probabilities Receives the probability for leaf i at index i,
+   * between 0 and 1. It is already sized to the number of leaves.
+   */
+  virtual void evaluate(const Leaf_batch& batch,
+                        std::vector<float>& win_probabilities) = 0;
+};
+
+/**
+ * @class Random_playout_evaluator
+ *
+ * @brief The default Leaf_evaluator, which evaluates a leaf by a single random
+ * playout, just like the built-in playouts of Mcts_agent.
+ *
+ * Every leaf is set up on a board and the empty cells are filled alternately
+ * in random order, starting with the player to move. A full Hex board always
+ * has exactly one winner, so every probability is 0 or 1. The agent uses its
+ * built-in playouts if it is given no evaluator, which saves copying the
+ * leaves into batches, so this class mainly serves as the reference
+ * implementation of the interface and as a baseline for other evaluators.
+ */
+class Random_playout_evaluator : public Leaf_evaluator {
+ public:
+  /**
+   * @brief Constructs an evaluator with its own random number generator.
+   *
+   * @param random_seed The seed of the generator.
+   * @param max_batch_size The largest number of leaves per batch. Zero is
+   * treated as one.
+   */
+  explicit Random_playout_evaluator(std::uint64_t random_seed,
+                                    std::size_t max_batch_size = 64);
+
+  std::size_t get_max_batch_size() const override;
+
+  void evaluate(const Leaf_batch& batch,
+                std::vector<float>& win_probabilities) override;
+
+ private:
+  std::size_t max_batch_size;
+  Xoshiro_generator random_generator;
+  // Reused for every leaf, so that playouts do not allocate
+  std::vector<std::pair<int, int>> empty_cells;
+};
+
+#endif  // LEAF_EVALUATOR_H
@@ -10,11 +10,88 @@ std::shared_ptr<Logger> Logger::instance(bool is_verbose) {
   return logger;
 }
 
+constexpr std::size_t Logger::buffer_capacity;
+
+Logger::Logger(bool verbose) : is_verbose(verbose) {
+  if (is_verbose) {
+    buffer.reserve(buffer_capacity);
+    writer_thread = std::thread(&Logger::write_output, this);
+  }
+}
+
+Logger::~Logger() {
+  if (writer_thread.joinable()) {
+    hand_over_buffer();
+    {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      is_stopping = true;
+    }
+    output_available.notify_one();
+    writer_thread.join();
+  }
+}
+
 void Logger::log(const std::string& message, bool always_print = false) {
-  if (is_verbose || always_print) {
-    // Lock the mutex to prevent interleaved output
-    std::lock_guard<std::mutex> lock(mutex);
-    std::cout << message << std::endl;
+  if (!is_verbose) {
+    if (always_print && !is_silent.load(std::memory_order_relaxed)) {
+      std::cout << message << std::endl;
+    }
+    return;
+  }
+  buffer += message;
+  buffer += '\n';
+  if (always_print) {
+    flush();
+  } else if (buffer.size() >= buffer_capacity) {
+    hand_over_buffer();
+  }
+}
+
+void Logger::flush() {
+  if (!writer_thread.joinable()) {
+    return;
+  }
+  hand_over_buffer();
+  std::unique_lock<std::mutex> lock(output_mutex);
+  output_written.wait(
+      lock, [this]() { return pending_output.empty() && !is_writing; });
+}
+
+void Logger::hand_over_buffer() {
+  if (buffer.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (pending_output.empty()) {
+      pending_output.swap(buffer);
+    } else {
+      pending_output += buffer;
+    }
+  }
+  buffer.clear();
+  output_available.notify_one();
+}
+
+void Logger::write_output() {
+  std::string output;
+  std::unique_lock<std::mutex> lock(output_mutex);
+  while (true) {
+    output_available.wait(
+        lock, [this]() { return !pending_output.empty() || is_stopping; });
+    if (pending_output.empty()) {
+      // Stopping, and everything has been written
+      return;
+    }
+    output.swap(pending_output);
+    is_writing = true;
+    lock.unlock();
+    std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+    std::cout.flush();
+    output.clear();
+    lock.lock();
+    is_writing = false;
+    output_written.notify_all();
   }
 }
 
@@ -30,6 +107,14 @@ void Logger::log_mcts_start(Cell_state player) {
   }
 }
 
+void Logger::log_tree_reused(int node_count, int visit_count) {
+  std::ostringstream message;
+  message << "\nREUSING " << node_count
+          << " NODES OF THE PREVIOUS TREE. THE ROOT STARTS WITH " << visit_count
+          << " VISITS.\n";
+  log(message.str());
+}
+
 void Logger::log_iteration_number(int iteration_number) {
   std::ostringstream message;
   message << "\n------------------STARTING SIMULATION " << iteration_number
@@ -130,10 +215,19 @@ void Logger::log_child_node_stats(const std::pair<int, int>& move,
   log(message.str());
 }
 
-void Logger::log_timer_ran_out(int iteration_counter) {
+void Logger::log_timer_ran_out(int iteration_counter,
+                               std::chrono::milliseconds elapsed_time,
+                               std::chrono::milliseconds saved_time) {
   std::ostringstream message;
-  message << "\nTIMER RAN OUT. " << iteration_counter
-          << " iterations completed. CHOOSING A MOVE FROM ROOT'S CHILDREN:\n";
+  if (saved_time.count() > 0) {
+    message << "\nBEST MOVE SETTLED, STOPPING EARLY. " << iteration_counter
+            << " iterations completed in " << elapsed_time.count() << " ms, "
+            << saved_time.count() << " ms saved. ";
+  } else {
+    message << "\nTIMER RAN OUT. " << iteration_counter
+            << " iterations completed in " << elapsed_time.count() << " ms. ";
+  }
+  message << "CHOOSING A MOVE FROM ROOT'S CHILDREN:\n";
   log(message.str());
 }
 
@@ -165,4 +259,5 @@ void Logger::log_best_child_chosen(int iteration_counter,
 
 void Logger::log_mcts_end() {
   log("\n--------------------MCTS VERBOSE END--------------------\n");
+  flush();
 }
@@ -1,11 +1,17 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
 
 #include "board.h"
 #include "cell_state.h"
@@ -13,16 +19,19 @@
 /**
  * @class Logger
  *
- * @brief The Logger class provides a thread-safe, singleton logging utility
- *        for the Monte Carlo Tree Search (MCTS) algorithm used in the
- *        Mcts_agent class.
+ * @brief The Logger class provides a singleton logging utility for the Monte
+ *        Carlo Tree Search (MCTS) algorithm used in the Mcts_agent class.
  *
  * The Logger class is designed as a singleton to ensure that only one logger
  * instance exists across the application, providing a unified source of
  * logging.
  *
- * This class is thread-safe, using a mutex to ensure that concurrent writes to
- * the console do not overlap.
+ * In verbose mode, messages are collected in a buffer without any locking, and
+ * full buffers are written to the console by a background writer thread, so
+ * producing the log does not wait for the console. Only one thread may log at
+ * a time, which holds since verbose search is single-threaded. flush() waits
+ * until everything logged so far has been written, and is called at the end
+ * of every search and before messages that are always printed.
  *
  * Logger provides various logging functions specific to different stages of the
  * MCTS algorithm, such as start and end of MCTS, expanding a child node,
@@ -49,7 +58,11 @@ class Logger {
   Logger& operator=(const Logger&) = delete;
   Logger(Logger&&) = delete;
   Logger& operator=(Logger&&) = delete;
-  Logger(bool verbose = false) : is_verbose(verbose) {}
+  Logger(bool verbose = false);
+  /**
+   * @brief Writes the remaining messages and stops the writer thread.
+   */
+  ~Logger();
 
   /**
    * @brief Returns the verbosity of the logger.
@@ -58,6 +71,20 @@ class Logger {
    */
   bool get_verbosity() const { return is_verbose; }
 
+  /**
+   * @brief Suppresses the messages that are printed even without verbose
+   * mode, e.g. while games are played without a console.
+   *
+   * @param is_silent Whether the messages are suppressed.
+   */
+  void set_silent(bool is_silent) { this->is_silent.store(is_silent); }
+
+  /**
+   * @brief Waits until all messages logged so far have been written to the
+   * console.
+   */
+  void flush();
+
   /**
    * @brief Logs the start of an MCTS operation.
    *
@@ -65,6 +92,15 @@ class Logger {
    */
   void log_mcts_start(Cell_state player);
 
+  /**
+   * @brief Logs that the search continues from a subtree of the previous
+   * search.
+   *
+   * @param node_count The number of nodes kept from the previous tree.
+   * @param visit_count The visit count of the new root node.
+   */
+  void log_tree_reused(int node_count, int visit_count);
+
   /**
    * @brief Logs the start of a simulation iteration.
    *
@@ -144,12 +180,18 @@ class Logger {
                             int visit_count);
 
   /**
-   * @brief Logs that the decision timer ran out.
+   * @brief Logs that the search stopped, either because its budget ran out or
+   * because the best move is unlikely to change.
    *
    * @param iteration_counter The number of iterations completed before the
-   * timer ran out.
+   * search stopped.
+   * @param elapsed_time The time the search took.
+   * @param saved_time The part of the budget left when the search stopped
+   * early, or zero if the budget ran out.
    */
-  void log_timer_ran_out(int iteration_counter);
+  void log_timer_ran_out(int iteration_counter,
+                         std::chrono::milliseconds elapsed_time,
+                         std::chrono::milliseconds saved_time);
 
   /**
    * @brief Logs the current win ratio of a node.
@@ -187,6 +229,12 @@ class Logger {
    */
   bool is_verbose;
 
+  /**
+   * @brief A flag suppressing the messages that are always printed, see
+   * set_silent().
+   */
+  std::atomic<bool> is_silent{false};
+
   /**
    * @brief Print a log message to the console.
    *
@@ -196,9 +244,53 @@ class Logger {
   void log(const std::string& message, bool always_print);
 
   /**
-   * @brief Mutex for ensuring thread safety when logging.
+   * @brief Passes the buffered messages on to the writer thread.
+   */
+  void hand_over_buffer();
+
+  /**
+   * @brief Writes the messages handed over by hand_over_buffer() to the
+   * console until the logger is destroyed.
+   */
+  void write_output();
+
+  /**
+   * @brief The size at which the buffer is handed to the writer thread.
+   */
+  static constexpr std::size_t buffer_capacity = 1 << 16;
+
+  /**
+   * @brief Messages that have been logged but not handed to the writer. Only
+   * accessed by the logging thread.
+   */
+  std::string buffer;
+
+  /**
+   * @brief Messages waiting to be written by the writer thread.
+   */
+  std::string pending_output;
+
+  /**
+   * @brief Whether the writer thread is currently writing to the console.
+   */
+  bool is_writing = false;
+
+  /**
+   * @brief Set by the destructor to stop the writer thread.
+   */
+  bool is_stopping = false;
+
+  /**
+   * @brief Guards the hand-over between the buffer and the writer thread.
+   */
+  std::mutex output_mutex;
+  std::condition_variable output_available;
+  std::condition_variable output_written;
+
+  /**
+   * @brief The thread writing to the console. Only started in verbose mode.
    */
-  std::mutex mutex;
+  std::thread writer_thread;
 };
 
 #endif  // LOGGER_H
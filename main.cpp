@@ -1,9 +1,21 @@
+#include <iostream>
+#include <string>
+
 #include "console_interface.h"
+#include "match_runner.h"
 
 /**
- * @brief Calls the run_console_interface() function.
+ * @brief Calls the run_console_interface() function, or plays a match
+ * without a console if started with `--match <config file>`.
  */
-int main() {
+int main(int argc, char* argv[]) {
+  if (argc == 3 && std::string(argv[1]) == "--match") {
+    return run_headless_match(argv[2]);
+  }
+  if (argc != 1) {
+    std::cerr << "Usage: " << argv[0] << " [--match <config file>]\n";
+    return 1;
+  }
   run_console_interface();
   return 0;
 }
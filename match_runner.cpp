@@ -0,0 +1,370 @@
+#include "match_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "cell_state.h"
+#include "logger.h"
+#include "mcts_agent.h"
+#include "thread_pool.h"
+#include "xoshiro_generator.h"
+
+namespace {
+
+/**
+ * @brief The record of one finished game.
+ */
+struct Game_record {
+  int game_number = 0;
+  // The index of the agent that played Blue and of the agent that won
+  int blue_agent = 0;
+  int winning_agent = 0;
+  std::uint64_t seed = 0;
+  double elapsed_seconds = 0.;
+  std::vector<std::pair<int, int>> moves;
+};
+
+std::string trim(const std::string& text) {
+  const char* whitespace = " \t\r\n";
+  std::size_t first = text.find_first_not_of(whitespace);
+  if (first == std::string::npos) {
+    return "";
+  }
+  std::size_t last = text.find_last_not_of(whitespace);
+  return text.substr(first, last - first + 1);
+}
+
+bool parse_bool(const std::string& value) {
+  if (value == "true" || value == "yes" || value == "1") {
+    return true;
+  }
+  if (value == "false" || value == "no" || value == "0") {
+    return false;
+  }
+  throw std::invalid_argument("'" + value + "' is not true or false.");
+}
+
+// Reads a whole number, rejecting negative values and trailing characters
+unsigned long long parse_count(const std::string& value) {
+  std::size_t length = 0;
+  unsigned long long count = 0;
+  try {
+    if (!value.empty() && value[0] != '-') {
+      count = std::stoull(value, &length);
+    }
+  } catch (const std::logic_error&) {
+    // Not a number, or too large, which the check below reports
+    length = 0;
+  }
+  if (length == 0 || length != value.size()) {
+    throw std::invalid_argument("'" + value + "' is not a count.");
+  }
+  return count;
+}
+
+double parse_number(const std::string& value) {
+  std::size_t length = 0;
+  double number = 0.;
+  try {
+    number = std::stod(value, &length);
+  } catch (const std::logic_error&) {
+    length = 0;
+  }
+  if (length == 0 || length != value.size()) {
+    throw std::invalid_argument("'" + value + "' is not a number.");
+  }
+  return number;
+}
+
+// Sets an agent setting. Returns false if the key is not one.
+bool set_agent_value(Match_agent_config& agent, const std::string& key,
+                     const std::string& value) {
+  if (key == "exploration_factor") {
+    agent.exploration_factor = parse_number(value);
+  } else if (key == "max_iterations") {
+    agent.search_limits.max_iterations =
+        static_cast<int>(std::min<unsigned long long>(parse_count(value),
+                                                      2147483647));
+  } else if (key == "max_decision_time_ms") {
+    agent.search_limits.max_decision_time =
+        std::chrono::milliseconds(parse_count(value));
+  } else if (key == "max_tree_nodes") {
+    agent.search_limits.max_tree_nodes = static_cast<std::uint32_t>(
+        std::min<unsigned long long>(parse_count(value), 0xffffffff));
+  } else if (key == "transposition_table_entries") {
+    agent.search_limits.transposition_table_entries =
+        static_cast<std::uint32_t>(
+            std::min<unsigned long long>(parse_count(value), 0xffffffff));
+  } else if (key == "widening_factor") {
+    agent.search_limits.widening_factor = parse_number(value);
+  } else if (key == "widening_exponent") {
+    agent.search_limits.widening_exponent = parse_number(value);
+  } else if (key == "early_stop") {
+    agent.search_limits.is_early_stop_enabled = parse_bool(value);
+  } else if (key == "playout_mode") {
+    if (value == "move_by_move") {
+      agent.playout_mode = Playout_mode::Move_by_move;
+    } else if (value == "fill_and_evaluate") {
+      agent.playout_mode = Playout_mode::Fill_and_evaluate;
+    } else if (value == "bridge_responses") {
+      agent.playout_mode = Playout_mode::Bridge_responses;
+    } else {
+      throw std::invalid_argument("'" + value + "' is not a playout mode.");
+    }
+  } else if (key == "rave_equivalence") {
+    agent.rave_equivalence = parse_number(value);
+  } else if (key == "parallel_mode") {
+    if (value == "shared_tree") {
+      agent.parallel_mode = Parallel_mode::Shared_tree;
+    } else if (value == "root_trees") {
+      agent.parallel_mode = Parallel_mode::Root_trees;
+    } else {
+      throw std::invalid_argument("'" + value + "' is not a parallel mode.");
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void set_value(Match_config& config, const std::string& key,
+               const std::string& value) {
+  if (key == "board_size") {
+    config.board_size = static_cast<int>(parse_count(value));
+  } else if (key == "games") {
+    config.game_count = static_cast<int>(
+        std::min<unsigned long long>(parse_count(value), 2147483647));
+  } else if (key == "seed") {
+    config.random_seed = parse_count(value);
+  } else if (key == "threads") {
+    config.thread_count = static_cast<unsigned int>(parse_count(value));
+  } else if (key == "threads_per_game") {
+    config.threads_per_game = static_cast<unsigned int>(parse_count(value));
+  } else if (key == "alternate_colours") {
+    config.is_alternating_colours = parse_bool(value);
+  } else if (key == "output") {
+    config.output_path = value;
+  } else if (key.compare(0, 7, "agent1.") == 0 ||
+             key.compare(0, 7, "agent2.") == 0) {
+    if (!set_agent_value(config.agents[key[5] - '1'], key.substr(7), value)) {
+      throw std::invalid_argument("Unknown key '" + key + "'.");
+    }
+  } else if (!set_agent_value(config.agents[0], key, value)) {
+    throw std::invalid_argument("Unknown key '" + key + "'.");
+  } else {
+    set_agent_value(config.agents[1], key, value);
+  }
+}
+
+unsigned int get_total_thread_count(const Match_config& config) {
+  if (config.thread_count != 0) {
+    return config.thread_count;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Writes a move as its row number and column letter, like the console
+void write_move(std::ostream& output, const std::pair<int, int>& move) {
+  output << move.first + 1 << static_cast<char>('a' + move.second);
+}
+
+void write_record(std::ostream& output, const Game_record& record) {
+  output << record.game_number << ',' << record.blue_agent + 1 << ','
+         << record.winning_agent + 1 << ',' << record.moves.size() << ','
+         << record.elapsed_seconds << ',' << record.seed << ',';
+  for (std::size_t i = 0; i < record.moves.size(); ++i) {
+    if (i != 0) {
+      output << ' ';
+    }
+    write_move(output, record.moves[i]);
+  }
+  output << '\n';
+}
+
+/**
+ * @brief Plays one game between two fresh agents. Each agent keeps its tree
+ * between its moves, like Mcts_player does.
+ */
+Game_record play_game(const Match_config& config, int game_number,
+                      std::uint64_t seed, unsigned int threads_per_game) {
+  Game_record record;
+  record.game_number = game_number;
+  record.seed = seed;
+  record.blue_agent =
+      config.is_alternating_colours ? (game_number - 1) % 2 : 0;
+  Xoshiro_generator seed_generator(seed);
+  std::unique_ptr<Mcts_agent> agents[2];
+  for (int i = 0; i < 2; ++i) {
+    const Match_agent_config& agent = config.agents[i];
+    std::uint64_t agent_seed = seed_generator();
+    agents[i] = std::make_unique<Mcts_agent>(
+        agent.exploration_factor, agent.search_limits, threads_per_game > 1,
+        false, agent.playout_mode, agent_seed != 0 ? agent_seed : 1,
+        agent.rave_equivalence, nullptr, threads_per_game,
+        agent.parallel_mode);
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  Board board(config.board_size);
+  record.moves.reserve(
+      static_cast<std::size_t>(config.board_size * config.board_size));
+  Cell_state player = Cell_state::Blue;
+  int agent_index = record.blue_agent;
+  while (board.check_winner() == Cell_state::Empty) {
+    std::pair<int, int> move = agents[agent_index]->choose_move(board, player);
+    board.make_move(move.first, move.second, player);
+    record.moves.push_back(move);
+    player = get_opponent(player);
+    agent_index = 1 - agent_index;
+  }
+  record.winning_agent = board.check_winner() == Cell_state::Blue
+                             ? record.blue_agent
+                             : 1 - record.blue_agent;
+  std::chrono::duration<double> elapsed_time =
+      std::chrono::steady_clock::now() - start_time;
+  record.elapsed_seconds = elapsed_time.count();
+  return record;
+}
+
+}  // namespace
+
+Match_config parse_match_config(std::istream& input) {
+  Match_config config;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(input, line)) {
+    ++line_number;
+    line = trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::size_t separator = line.find('=');
+    try {
+      if (separator == std::string::npos) {
+        throw std::invalid_argument("Expected 'key = value'.");
+      }
+      set_value(config, trim(line.substr(0, separator)),
+                trim(line.substr(separator + 1)));
+    } catch (const std::invalid_argument& e) {
+      throw std::invalid_argument("Line " + std::to_string(line_number) +
+                                  " of the match config: " + e.what());
+    }
+  }
+  if (config.board_size < 2 || config.board_size > Board::max_board_size) {
+    throw std::invalid_argument("The board size must be from 2 to " +
+                                std::to_string(Board::max_board_size) + ".");
+  }
+  if (config.game_count < 1) {
+    throw std::invalid_argument("A match needs at least one game.");
+  }
+  for (const Match_agent_config& agent : config.agents) {
+    const Search_limits& limits = agent.search_limits;
+    if (limits.max_decision_time.count() == 0 && limits.max_iterations == 0) {
+      throw std::invalid_argument(
+          "Every agent needs max_iterations or max_decision_time_ms.");
+    }
+  }
+  return config;
+}
+
+unsigned int get_threads_per_game(const Match_config& config) {
+  unsigned int thread_count = get_total_thread_count(config);
+  if (config.threads_per_game != 0) {
+    return std::min(config.threads_per_game, thread_count);
+  }
+  unsigned int game_count = static_cast<unsigned int>(config.game_count);
+  return game_count < thread_count ? thread_count / game_count : 1;
+}
+
+Match_summary run_match(const Match_config& config, std::ostream& output) {
+  // Keep the agents from printing while the games run. The logger is created
+  // here, before the games create agents on several threads.
+  Logger::instance(false)->set_silent(true);
+  Match_summary summary;
+  summary.threads_per_game = get_threads_per_game(config);
+  summary.parallel_game_count = std::max(
+      1u, std::min(get_total_thread_count(config) / summary.threads_per_game,
+                   static_cast<unsigned int>(config.game_count)));
+  // Draw the seeds of all games up front, so that every game gets the same
+  // seed however the games are spread over the threads
+  std::vector<std::uint64_t> game_seeds(
+      static_cast<std::size_t>(config.game_count));
+  Xoshiro_generator seed_generator(config.random_seed);
+  for (std::uint64_t& seed : game_seeds) {
+    seed = seed_generator();
+  }
+  output << "game,blue_agent,winning_agent,move_count,seconds,seed,moves\n";
+  std::mutex output_mutex;
+  std::atomic<int> next_game(0);
+  auto start_time = std::chrono::steady_clock::now();
+  // Every thread plays one game after the other until none is left
+  Thread_pool game_threads(summary.parallel_game_count);
+  game_threads.run_on_all_workers([&](unsigned int) {
+    int game_index;
+    while ((game_index = next_game.fetch_add(1)) < config.game_count) {
+      Game_record record;
+      try {
+        record = play_game(config, game_index + 1, game_seeds[game_index],
+                           summary.threads_per_game);
+      } catch (...) {
+        // Let the other threads finish their current games and stop
+        next_game.store(config.game_count);
+        throw;
+      }
+      std::lock_guard<std::mutex> lock(output_mutex);
+      write_record(output, record);
+      output.flush();
+      ++summary.game_count;
+      ++summary.wins[record.winning_agent];
+      summary.blue_wins += record.winning_agent == record.blue_agent;
+    }
+  });
+  std::chrono::duration<double> elapsed_time =
+      std::chrono::steady_clock::now() - start_time;
+  summary.elapsed_seconds = elapsed_time.count();
+  Logger::instance(false)->set_silent(false);
+  return summary;
+}
+
+int run_headless_match(const std::string& config_path) {
+  try {
+    std::ifstream config_file(config_path);
+    if (!config_file) {
+      throw std::runtime_error("Cannot open the match config " + config_path +
+                               ".");
+    }
+    Match_config config = parse_match_config(config_file);
+    std::ofstream output(config.output_path);
+    if (!output) {
+      throw std::runtime_error("Cannot write the results to " +
+                               config.output_path + ".");
+    }
+    std::cout << "Playing " << config.game_count << " games on a "
+              << config.board_size << "x" << config.board_size
+              << " board...\n";
+    Match_summary summary = run_match(config, output);
+    std::cout << "Played " << summary.game_count << " games in "
+              << summary.elapsed_seconds << " s, "
+              << summary.parallel_game_count << " at a time with "
+              << summary.threads_per_game << " search thread(s) each.\n";
+    for (int i = 0; i < 2; ++i) {
+      std::cout << "Agent " << i + 1 << " won " << summary.wins[i] << " ("
+                << 100. * summary.wins[i] / summary.game_count << "%).\n";
+    }
+    std::cout << "Blue won " << summary.blue_wins << ". The results are in "
+              << config.output_path << ".\n";
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+}
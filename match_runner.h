@@ -0,0 +1,188 @@
+#ifndef MATCH_RUNNER_H
+#define MATCH_RUNNER_H
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "parallel_mode.h"
+#include "playout_mode.h"
+#include "search_limits.h"
+
+/**
+ * @struct Match_agent_config
+ * @brief The settings of one of the two agents of a match.
+ */
+struct Match_agent_config {
+  /**
+   * @brief The constant of exploration in the UCT formula.
+   */
+  double exploration_factor = 1.41;
+
+  /**
+   * @brief When the agent stops searching for a move. A fixed number of
+   * iterations by default, which makes the games independent of the speed
+   * of the machine and of the number of games played at once.
+   */
+  Search_limits search_limits;
+
+  /**
+   * @brief How the agent simulates random playouts.
+   */
+  Playout_mode playout_mode = Playout_mode::Move_by_move;
+
+  /**
+   * @brief The RAVE equivalence of the agent, or 0 to disable RAVE.
+   */
+  double rave_equivalence = 0.;
+
+  /**
+   * @brief Whether the workers of the agent share one tree or grow one each,
+   * if a game has more than one search thread.
+   */
+  Parallel_mode parallel_mode = Parallel_mode::Shared_tree;
+
+  Match_agent_config() { search_limits.max_iterations = 1000; }
+};
+
+/**
+ * @struct Match_config
+ * @brief The settings of a match of many games between two agents, played
+ * without a console.
+ *
+ * A config is read by parse_match_config() from lines of the form
+ * `key = value`. Empty lines and lines starting with `#` are ignored. The
+ * keys are:
+ *
+ *   board_size, games, seed, threads, threads_per_game,
+ *   alternate_colours (true or false), output (the path of the results),
+ *
+ * and for the agents exploration_factor, max_iterations,
+ * max_decision_time_ms, max_tree_nodes, transposition_table_entries,
+ * widening_factor, widening_exponent, early_stop (true or false),
+ * playout_mode (move_by_move, fill_and_evaluate or bridge_responses),
+ * rave_equivalence and parallel_mode (shared_tree or root_trees).
+ * An agent key prefixed with `agent1.` or `agent2.` sets the value for that
+ * agent only, and without a prefix for both.
+ */
+struct Match_config {
+  /**
+   * @brief The side length of the board.
+   */
+  int board_size = 11;
+
+  /**
+   * @brief The number of games to play.
+   */
+  int game_count = 100;
+
+  /**
+   * @brief The settings of the first and the second agent.
+   */
+  std::array<Match_agent_config, 2> agents;
+
+  /**
+   * @brief The seed from which the seeds of all agents are drawn, so that a
+   * match can be repeated.
+   */
+  std::uint64_t random_seed = 1;
+
+  /**
+   * @brief The number of threads the match may use in total, or 0 for one
+   * per hardware thread.
+   */
+  unsigned int thread_count = 0;
+
+  /**
+   * @brief The number of search threads of every agent, or 0 to choose it
+   * automatically, see get_threads_per_game().
+   */
+  unsigned int threads_per_game = 0;
+
+  /**
+   * @brief Whether the agents swap colours after every game, so that each
+   * plays Blue, who moves first, in half of the games. Otherwise the first
+   * agent always plays Blue.
+   */
+  bool is_alternating_colours = true;
+
+  /**
+   * @brief The path of the file that receives the results.
+   */
+  std::string output_path = "match_results.csv";
+};
+
+/**
+ * @struct Match_summary
+ * @brief The outcome of a whole match.
+ */
+struct Match_summary {
+  int game_count = 0;
+  /**
+   * @brief The number of games won by the first and the second agent.
+   */
+  std::array<int, 2> wins = {{0, 0}};
+  /**
+   * @brief The number of games won by the player moving first.
+   */
+  int blue_wins = 0;
+  unsigned int parallel_game_count = 0;
+  unsigned int threads_per_game = 0;
+  double elapsed_seconds = 0.;
+};
+
+/**
+ * @brief Reads the settings of a match.
+ *
+ * @param input The config, in the format described at Match_config. Keys that
+ * are not given keep their default values.
+ * @return The settings.
+ * @throws std::invalid_argument If a line cannot be read, a key is unknown, a
+ * value is invalid, or an agent has no search limit.
+ */
+Match_config parse_match_config(std::istream& input);
+
+/**
+ * @brief Returns the number of search threads every agent gets.
+ *
+ * Separate games scale perfectly over the cores, while the threads of one
+ * search share its tree and scale less well. So unless the config sets the
+ * number, every game gets a single thread, and only the cores that would be
+ * left idle because there are fewer games than cores are spread over the
+ * games.
+ *
+ * @param config The settings of the match.
+ */
+unsigned int get_threads_per_game(const Match_config& config);
+
+/**
+ * @brief Plays all games of a match, as many at a time as the cores allow,
+ * and writes one line of CSV per game to the output as soon as the game ends.
+ *
+ * Every line holds the number of the game, the agent that played Blue and
+ * the agent that won, as 1 or 2, the number of moves, the duration in
+ * seconds, the seed of the game and the moves in the order they were played,
+ * each as its row number and column letter like in the console, separated by
+ * spaces. The lines are written in the order in which the games end. Nothing
+ * is printed to the console while the games run.
+ *
+ * @param config The settings of the match.
+ * @param output The stream that receives the results, starting with a header
+ * line.
+ * @return The outcome of the match.
+ * @throws Any exception thrown by an agent, once the running games have
+ * ended.
+ */
+Match_summary run_match(const Match_config& config, std::ostream& output);
+
+/**
+ * @brief Reads a config file, plays the match it describes and prints a
+ * summary once all games have ended.
+ *
+ * @param config_path The path of the config file.
+ * @return The exit code of the program, 0 on success.
+ */
+int run_headless_match(const std::string& config_path);
+
+#endif  // MATCH_RUNNER_H
@@ -1,240 +1,2508 @@
 #include "mcts_agent.h"
 
+#include "allocation_counter.h"
+#include "hex_adjacency.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <limits>
 #include <memory>
-#include <mutex>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MCTS_AGENT_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MCTS_AGENT_USE_SSE2
+#endif
+
+namespace {
+
+// Draws a 64-bit seed from the non-deterministic random device
+std::uint64_t seed_from_device() {
+  std::random_device random_device;
+  return (static_cast<std::uint64_t>(random_device()) << 32) ^
+         random_device();
+}
+
+/**
+ * @brief Finds the child with the highest UCT score from a snapshot of the
+ * packed statistics of the children, with the win count in the lower and the
+ * visit count in the upper 32 bits of every entry.
+ *
+ * The scores are computed with the formula of
+ * Mcts_agent::calculate_uct_score(), four children at a time with AVX2 and two
+ * with SSE2, so a child without visits gets the highest score. The operations
+ * are the same in every lane, so the scores match the scalar ones exactly,
+ * and of several children with the highest score the first one is chosen.
+ *
+ * @param child_statistics The statistics of the children, aligned to 32
+ * bytes.
+ * @param child_count The number of children, at least 1.
+ * @param exploration_numerator The numerator of the exploration term.
+ * @return The offset of the best child from the first child.
+ */
+std::uint32_t find_best_uct_child(const std::uint64_t* child_statistics,
+                                  std::uint32_t child_count,
+                                  double exploration_numerator) {
+  double max_score = std::numeric_limits<double>::lowest();
+  std::uint32_t best_offset = 0;
+  std::uint32_t offset = 0;
+#if defined(MCTS_AGENT_USE_AVX2) || defined(MCTS_AGENT_USE_SSE2)
+  // Every lane keeps the best score among the children it has seen and the
+  // offset of that child, as a double so that it can be blended like a score
+#if defined(MCTS_AGENT_USE_AVX2)
+  constexpr std::uint32_t lane_count = 4;
+  const __m256d numerator = _mm256_set1_pd(exploration_numerator);
+  const __m256d unvisited_score =
+      _mm256_set1_pd(std::numeric_limits<double>::max());
+  const __m256d one = _mm256_set1_pd(1.);
+  // Gathers the win counts into the lower and the visit counts into the upper
+  // half of a vector
+  const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  __m256d best_scores = _mm256_set1_pd(max_score);
+  __m256d best_offsets = _mm256_setzero_pd();
+  __m256d offsets = _mm256_setr_pd(0., 1., 2., 3.);
+  for (; offset + lane_count <= child_count; offset += lane_count) {
+    __m256i statistics = _mm256_load_si256(
+        reinterpret_cast<const __m256i*>(child_statistics + offset));
+    __m256i counts = _mm256_permutevar8x32_epi32(statistics, split);
+    __m256d wins = _mm256_cvtepi32_pd(_mm256_castsi256_si128(counts));
+    __m256d visits = _mm256_cvtepi32_pd(_mm256_extracti128_si256(counts, 1));
+    __m256d is_unvisited =
+        _mm256_cmp_pd(visits, _mm256_setzero_pd(), _CMP_EQ_OQ);
+    // Divide unvisited children by one instead of zero, their score is
+    // replaced anyway
+    __m256d divisor = _mm256_max_pd(visits, one);
+    __m256d scores =
+        _mm256_add_pd(_mm256_div_pd(wins, divisor),
+                      _mm256_div_pd(numerator, _mm256_sqrt_pd(divisor)));
+    scores = _mm256_blendv_pd(scores, unvisited_score, is_unvisited);
+    __m256d is_better = _mm256_cmp_pd(scores, best_scores, _CMP_GT_OQ);
+    best_scores = _mm256_blendv_pd(best_scores, scores, is_better);
+    best_offsets = _mm256_blendv_pd(best_offsets, offsets, is_better);
+    offsets = _mm256_add_pd(offsets, _mm256_set1_pd(lane_count));
+  }
+  alignas(32) double lane_scores[lane_count];
+  alignas(32) double lane_offsets[lane_count];
+  _mm256_store_pd(lane_scores, best_scores);
+  _mm256_store_pd(lane_offsets, best_offsets);
+#else
+  constexpr std::uint32_t lane_count = 2;
+  const __m128d numerator = _mm_set1_pd(exploration_numerator);
+  const __m128d unvisited_score =
+      _mm_set1_pd(std::numeric_limits<double>::max());
+  const __m128d one = _mm_set1_pd(1.);
+  __m128d best_scores = _mm_set1_pd(max_score);
+  __m128d best_offsets = _mm_setzero_pd();
+  __m128d offsets = _mm_setr_pd(0., 1.);
+  for (; offset + lane_count <= child_count; offset += lane_count) {
+    __m128i statistics = _mm_load_si128(
+        reinterpret_cast<const __m128i*>(child_statistics + offset));
+    // The win counts go to the lower and the visit counts to the upper half
+    __m128i counts = _mm_shuffle_epi32(statistics, _MM_SHUFFLE(3, 1, 2, 0));
+    __m128d wins = _mm_cvtepi32_pd(counts);
+    __m128d visits = _mm_cvtepi32_pd(_mm_srli_si128(counts, 8));
+    __m128d is_unvisited = _mm_cmpeq_pd(visits, _mm_setzero_pd());
+    // Divide unvisited children by one instead of zero, their score is
+    // replaced anyway
+    __m128d divisor = _mm_max_pd(visits, one);
+    __m128d scores = _mm_add_pd(_mm_div_pd(wins, divisor),
+                                _mm_div_pd(numerator, _mm_sqrt_pd(divisor)));
+    scores = _mm_or_pd(_mm_and_pd(is_unvisited, unvisited_score),
+                       _mm_andnot_pd(is_unvisited, scores));
+    __m128d is_better = _mm_cmpgt_pd(scores, best_scores);
+    best_scores = _mm_or_pd(_mm_and_pd(is_better, scores),
+                            _mm_andnot_pd(is_better, best_scores));
+    best_offsets = _mm_or_pd(_mm_and_pd(is_better, offsets),
+                             _mm_andnot_pd(is_better, best_offsets));
+    offsets = _mm_add_pd(offsets, _mm_set1_pd(lane_count));
+  }
+  alignas(16) double lane_scores[lane_count];
+  alignas(16) double lane_offsets[lane_count];
+  _mm_store_pd(lane_scores, best_scores);
+  _mm_store_pd(lane_offsets, best_offsets);
+#endif
+  if (offset != 0) {
+    // Every lane has seen a child. Of equal scores, the lowest offset wins.
+    for (std::uint32_t lane = 0; lane < lane_count; ++lane) {
+      std::uint32_t lane_offset =
+          static_cast<std::uint32_t>(lane_offsets[lane]);
+      if (lane_scores[lane] > max_score ||
+          (lane_scores[lane] == max_score && lane_offset < best_offset)) {
+        max_score = lane_scores[lane];
+        best_offset = lane_offset;
+      }
+    }
+  }
+#endif
+  // The remaining children, all of them without SSE2
+  for (; offset < child_count; ++offset) {
+    int win_count = static_cast<int>(child_statistics[offset] & 0xffffffff);
+    int visit_count = static_cast<int>(child_statistics[offset] >> 32);
+    double score =
+        visit_count == 0
+            ? std::numeric_limits<double>::max()
+            : static_cast<double>(win_count) / visit_count +
+                  exploration_numerator /
+                      std::sqrt(static_cast<double>(visit_count));
+    if (score > max_score) {
+      max_score = score;
+      best_offset = offset;
+    }
+  }
+  return best_offset;
+}
+
+// The header of a file written by Mcts_agent::save_tree(), followed by the
+// cells of the root game state, padded to 8 bytes, and the node records
+struct Tree_file_header {
+  char magic[8];
+  // Reads as tree_byte_order_mark only in the byte order of the writer
+  std::uint64_t byte_order;
+  std::uint32_t version;
+  std::uint32_t node_size;
+  std::uint32_t node_count;
+  std::uint8_t board_size;
+  // The player who made the move leading to the root
+  std::uint8_t root_player;
+  std::uint16_t reserved;
+};
+
+// A node of the tree in the file. The children of a node follow each other,
+// and first_child_index is the position of the first one in the file.
+struct Tree_file_node {
+  std::uint64_t statistics;
+  std::uint64_t amaf_statistics;
+  // 0 if the node is not expanded, since the root is never a child
+  std::uint32_t first_child_index;
+  std::uint16_t child_count;
+  std::int8_t move_x;
+  std::int8_t move_y;
+};
+
+static_assert(sizeof(Tree_file_header) == 32,
+              "The header must keep the records aligned.");
+static_assert(sizeof(Tree_file_node) == 24,
+              "A node record must consist of three plain words.");
+
+constexpr char tree_magic[8] = {'H', 'E', 'X', 'T', 'R', 'E', 'E', '\0'};
+constexpr std::uint64_t tree_byte_order_mark = 0x0102030405060708;
+constexpr std::uint32_t tree_version = 1;
+
+// The bytes that hold the cells of a board in a tree file
+std::size_t get_padded_cell_count(int board_size) {
+  return (static_cast<std::size_t>(board_size * board_size) + 7) / 8 * 8;
+}
+
+// Adds the statistics of a later part of a search, e.g. of a time slice, to
+// those of the earlier parts
+void add_worker_statistics(Worker_statistics& total,
+                           const Worker_statistics& part) {
+  total.iterations += part.iterations;
+  total.max_depth = std::max(total.max_depth, part.max_depth);
+  total.total_depth += part.total_depth;
+  total.selection_time += part.selection_time;
+  total.expansion_time += part.expansion_time;
+  total.simulation_time += part.simulation_time;
+  total.backpropagation_time += part.backpropagation_time;
+  total.expansion_collisions += part.expansion_collisions;
+  total.failed_expansions += part.failed_expansions;
+  total.transposition_hits += part.transposition_hits;
+  total.evaluation_waits += part.evaluation_waits;
+}
+
+}  // namespace
 
 Mcts_agent::Mcts_agent(double exploration_factor,
-                       std::chrono::milliseconds max_decision_time,
-                       bool is_parallelized, bool is_verbose)
+                       const Search_limits& search_limits,
+                       bool is_parallelized, bool is_verbose,
+                       Playout_mode playout_mode, std::uint64_t random_seed,
+                       double rave_equivalence,
+                       std::shared_ptr<Leaf_evaluator> leaf_evaluator,
+                       unsigned int worker_count, Parallel_mode parallel_mode,
+                       std::shared_ptr<Cluster_link> cluster_link)
     : exploration_factor(exploration_factor),
-      max_decision_time(max_decision_time),
+      search_limits(search_limits),
+      is_parallelized(is_parallelized),
+      is_verbose(is_verbose),
+      playout_mode(playout_mode),
+      rave_equivalence(rave_equivalence),
       logger(Logger::instance(is_verbose)),
-      random_generator(random_device()) {
+      random_generator(random_seed != 0 ? random_seed : seed_from_device()),
+      leaf_evaluator(std::move(leaf_evaluator)),
+      cluster_link(std::move(cluster_link)),
+      // With private trees, the agent's own tree only holds the root and its
+      // children. A block holds fewer than twice as many nodes as children,
+      // so twice the limit on the nodes always has room for them.
+      node_pool(
+          is_parallelized && parallel_mode == Parallel_mode::Root_trees
+              ? Hex_adjacency::max_cells + 1
+          : search_limits.max_tree_nodes != 0
+              ? static_cast<std::uint32_t>(std::min<std::uint64_t>(
+                    2 * std::uint64_t(search_limits.max_tree_nodes),
+                    Node_pool<Node>::null_index))
+              : node_pool_capacity),
+      // Like the nodes, the counts are only written once a node is allocated
+      node_statistics(
+          new std::atomic<std::uint64_t>[node_pool.get_capacity()]),
+      node_amaf_statistics(
+          new std::atomic<std::uint64_t>[node_pool.get_capacity()]) {
+  if (search_limits.max_decision_time.count() < 0 ||
+      search_limits.max_iterations < 0) {
+    throw std::invalid_argument("Search limits must not be negative.");
+  }
+  // A node limit alone is not enough, since the tree stops growing once
+  // every leaf that is still reached ends the game
+  if (search_limits.max_decision_time.count() == 0 &&
+      search_limits.max_iterations == 0) {
+    throw std::invalid_argument(
+        "A decision time or a number of iterations must be set, or the search "
+        "may never end.");
+  }
+  if (rave_equivalence < 0.) {
+    throw std::invalid_argument("The RAVE equivalence must not be negative.");
+  }
+  if (search_limits.widening_factor < 0. ||
+      search_limits.widening_exponent < 0. ||
+      search_limits.widening_exponent > 1.) {
+    throw std::invalid_argument(
+        "The widening factor must not be negative, and the widening exponent "
+        "must be from 0 to 1.");
+  }
+  if (search_limits.time_check_interval < 1) {
+    throw std::invalid_argument("The time check interval must be positive.");
+  }
   if (is_parallelized && is_verbose) {
     throw std::logic_error(
         "Concurrent playouts and verbose mode do not make sense together.");
   }
+  if (is_parallelized) {
+    // Start the long-lived workers, by default one per hardware thread
+    thread_pool = std::make_unique<Thread_pool>(
+        worker_count != 0 ? worker_count : std::thread::hardware_concurrency());
+  }
+  if (is_parallelized && parallel_mode == Parallel_mode::Root_trees) {
+    if (this->leaf_evaluator) {
+      throw std::invalid_argument(
+          "A leaf evaluator cannot be shared by private trees.");
+    }
+    // Every worker gets the same share of the iterations and the memory
+    const unsigned int tree_count = thread_pool->get_number_of_threads();
+    Search_limits tree_limits = search_limits;
+    if (tree_limits.max_iterations != 0) {
+      tree_limits.max_iterations = std::max(
+          tree_limits.max_iterations / static_cast<int>(tree_count), 1);
+    }
+    if (tree_limits.max_tree_nodes != 0) {
+      tree_limits.max_tree_nodes =
+          std::max(tree_limits.max_tree_nodes / tree_count, 1u);
+    }
+    if (tree_limits.transposition_table_entries != 0) {
+      tree_limits.transposition_table_entries =
+          std::max(tree_limits.transposition_table_entries / tree_count, 1u);
+    }
+    for (unsigned int i = 0; i < tree_count; ++i) {
+      std::uint64_t tree_seed = random_generator();
+      root_agents.push_back(std::make_unique<Mcts_agent>(
+          exploration_factor, tree_limits, false, false, playout_mode,
+          tree_seed != 0 ? tree_seed : 1, rave_equivalence));
+    }
+  }
+  if (this->leaf_evaluator) {
+    if (this->leaf_evaluator->get_max_batch_size() == 0) {
+      throw std::invalid_argument(
+          "A leaf evaluator must accept at least one leaf per batch.");
+    }
+    evaluation_queue =
+        std::make_unique<Evaluation_queue>(*this->leaf_evaluator);
+  }
+  if (search_limits.transposition_table_entries != 0 && root_agents.empty()) {
+    transposition_table = std::make_unique<Transposition_table>(
+        search_limits.transposition_table_entries);
+  }
+}
+
+void Mcts_agent::Node::initialize(Cell_state player,
+                                  std::pair<int, int> move) {
+  first_child_index.store(Node_pool<Node>::null_index,
+                          std::memory_order_relaxed);
+  this->player = player;
+  child_count.store(0, std::memory_order_relaxed);
+  child_capacity = 0;
+  move_x = static_cast<std::int8_t>(move.first);
+  move_y = static_cast<std::int8_t>(move.second);
+  expansion_state.store(Unexpanded, std::memory_order_relaxed);
+}
+
+void Mcts_agent::initialize_node(std::uint32_t node_index, Cell_state player,
+                                 std::pair<int, int> move) {
+  node_pool[node_index].initialize(player, move);
+  node_statistics[node_index].store(0, std::memory_order_relaxed);
+  node_amaf_statistics[node_index].store(0, std::memory_order_relaxed);
 }
 
-Mcts_agent::Node::Node(Cell_state player, std::pair<int, int> move,
-                       std::shared_ptr<Node> parent_node)
-    : win_count(0),
-      visit_count(0),
-      move(move),
-      player(player),
-      child_nodes(),
-      parent_node(parent_node) {}
+Mcts_agent::Playout_scratch::Playout_scratch(const Board& board)
+    : board(board),
+      cell_states(static_cast<std::size_t>(board.get_board_size() *
+                                           board.get_board_size())),
+      empty_cell_positions(cell_states.size()),
+      patterns(&Playout_patterns::for_board_size(board.get_board_size())) {
+  empty_cells.reserve(cell_states.size());
+}
+
+// Copying the game state into the scratch board must not allocate
+static_assert(std::is_trivially_copyable<Board>::value,
+              "Board must be trivially copyable.");
+
+constexpr std::uint64_t Mcts_agent::Node::one_visit;
+constexpr std::uint32_t Mcts_agent::node_pool_capacity;
+constexpr double Mcts_agent::early_stop_error_probability;
+constexpr int Mcts_agent::Statistics_recorder::timing_interval;
+
+Mcts_agent::~Mcts_agent() {
+  // The background thread uses the tree and the workers, so it has to
+  // finish before they are destroyed
+  if (background_thread.joinable()) {
+    set_stop_requested(true);
+    background_thread.join();
+  }
+}
 
 std::pair<int, int> Mcts_agent::choose_move(const Board& board,
                                             Cell_state player) {
+  Search_statistics statistics;
+  return choose_move(board, player, statistics);
+}
+
+std::pair<int, int> Mcts_agent::choose_move(const Board& board,
+                                            Cell_state player,
+                                            Search_statistics& statistics) {
+  // Take over the tree grown while pondering, if any
+  stop_pondering();
+  set_stop_requested(false);
+  // Announced on the caller's thread, also by agents that are not verbose,
+  // unlike the searches on background and scheduler threads
   logger->log_mcts_start(player);
-  // Create a new root node for MCTS
-  root = std::make_shared<Node>(player, std::make_pair(-1, -1), nullptr);
-  // Prepare for potential parallelism
-  unsigned int number_of_threads = 1;
-  if (is_parallelized) {
-    // Determine the maximum number of threads available on the hardware.
-    number_of_threads = std::thread::hardware_concurrency();
-  }
-  // Expand root based on the current game state
-  expand_node(root, board);
-  int mcts_iteration_counter = 0;
-  auto start_time = std::chrono::high_resolution_clock::now();
-  auto end_time = start_time + max_decision_time;
-  // Run MCTS until the timer runs out to update root's and its children's
+  return search_move(board, player, statistics);
+}
+
+std::pair<int, int> Mcts_agent::search_move(const Board& board,
+                                            Cell_state player,
+                                            Search_statistics& statistics) {
+  begin_move(board, player);
+  // Exchange the root statistics with the other machines of the cluster, if
+  // any, while searching
+  Search_end_signal search_end_signal;
+  std::exception_ptr sync_exception;
+  std::thread sync_thread;
+  if (cluster_link) {
+    prepared_root_count.store(0);
+    sync_thread = std::thread([&]() {
+      try {
+        synchronize_root_statistics(board.get_hash(), search_end_signal);
+      } catch (...) {
+        sync_exception = std::current_exception();
+      }
+    });
+  }
+  auto finish_synchronization = [&]() {
+    if (!sync_thread.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(search_end_signal.mutex);
+      search_end_signal.is_search_finished = true;
+    }
+    search_end_signal.condition.notify_one();
+    sync_thread.join();
+  };
+  // Run MCTS until a limit is reached to grow the tree and update its
   // statistics
-  perform_mcts_iterations(end_time, mcts_iteration_counter, board,
-                          number_of_threads);
-  logger->log_timer_ran_out(mcts_iteration_counter);
+  try {
+    run_search(board, move_end_time, search_limits.max_iterations,
+               move_iteration_counter);
+  } catch (...) {
+    finish_synchronization();
+    remote_root_statistics.clear();
+    throw;
+  }
+  if (sync_thread.joinable()) {
+    // Wait for the counts of the machines that are still searching
+    finish_synchronization();
+    if (!root_agents.empty()) {
+      merge_root_statistics();
+    }
+    remote_root_statistics.clear();
+    if (sync_exception) {
+      std::rethrow_exception(sync_exception);
+    }
+  }
+  return end_move(statistics);
+}
+
+void Mcts_agent::begin_move(const Board& board, Cell_state player) {
+  prepare_root(board, player);
+  move_iteration_counter.store(0);
+  move_end_time = std::chrono::high_resolution_clock::time_point::max();
+  if (search_limits.max_decision_time.count() > 0) {
+    move_end_time = std::chrono::high_resolution_clock::now() +
+                    search_limits.max_decision_time;
+  }
+  is_move_resumed = false;
+}
+
+bool Mcts_agent::continue_move(std::chrono::nanoseconds slice_duration) {
+  const auto slice_start_time = std::chrono::high_resolution_clock::now();
+  slice_end_time =
+      move_end_time - slice_start_time > slice_duration
+          ? slice_start_time +
+                std::chrono::duration_cast<
+                    std::chrono::high_resolution_clock::duration>(
+                    slice_duration)
+          : move_end_time;
+  run_search(*root_board, move_end_time, search_limits.max_iterations,
+             move_iteration_counter, is_move_resumed);
+  is_move_resumed = true;
+  // A search that returns before the end of its slice reached a limit
+  const auto now = std::chrono::high_resolution_clock::now();
+  const bool is_move_searched = now < slice_end_time ||
+                                now >= move_end_time ||
+                                is_stop_requested.load() ||
+                                is_best_move_settled.load();
+  slice_end_time = std::chrono::high_resolution_clock::time_point::max();
+  return is_move_searched;
+}
+
+std::pair<int, int> Mcts_agent::end_move(Search_statistics& statistics) {
+  const int iteration_count = move_iteration_counter.load();
+  const auto stop_time = std::chrono::high_resolution_clock::now();
+  const auto elapsed_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(stop_time -
+                                                            search_start_time);
+  // Report the part of the budget that was left when the search stopped early
+  std::chrono::milliseconds saved_time(0);
+  if (is_best_move_settled.load()) {
+    if (search_limits.max_decision_time.count() > 0) {
+      saved_time = std::max(
+          saved_time,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              move_end_time - stop_time));
+    } else if (iteration_count > 0) {
+      // Estimate the time the remaining iterations would have taken
+      saved_time = elapsed_time *
+                   (search_limits.max_iterations - iteration_count) /
+                   iteration_count;
+    }
+  }
+  if (is_logging()) {
+    logger->log_timer_ran_out(iteration_count, elapsed_time, saved_time);
+  }
+  statistics = collect_search_statistics(iteration_count,
+                                         stop_time - search_start_time);
   // Select the child with the highest win ratio as the best move:
-  std::shared_ptr<Node> best_child = select_best_child();
-  logger->log_best_child_chosen(
-      mcts_iteration_counter, best_child->move,
-      static_cast<double>(best_child->win_count) / best_child->visit_count);
-  logger->log_mcts_end();
-  return best_child->move;
+  const std::uint32_t best_child_index = select_best_child();
+  const Node& best_child = node_pool[best_child_index];
+  std::uint64_t best_child_statistics =
+      node_statistics[best_child_index].load();
+  if (is_logging()) {
+    logger->log_best_child_chosen(
+        iteration_count, best_child.get_move(),
+        static_cast<double>(Node::get_win_count(best_child_statistics)) /
+            Node::get_visit_count(best_child_statistics));
+    logger->log_mcts_end();
+  }
+  return best_child.get_move();
 }
 
-void Mcts_agent::expand_node(const std::shared_ptr<Node>& node,
-                             const Board& board) {
-  std::vector<std::pair<int, int>> valid_moves = board.get_valid_moves();
-  // For each valid move, create a new child node and add it to the node's
-  // children.
-  for (const auto& move : valid_moves) {
-    std::shared_ptr<Node> new_child =
-        std::make_shared<Node>(node->player, move, node);
-    node->child_nodes.push_back(new_child);
-    logger->log_expanded_child(move);
+void Mcts_agent::start_pondering(const Board& board, Cell_state player) {
+  if (is_verbose) {
+    throw std::logic_error(
+        "Pondering and verbose mode do not make sense together.");
+  }
+  stop_pondering();
+  if (board.check_winner() != Cell_state::Empty) {
+    return;
   }
+  prepare_root(board, player);
+  // Search in the background until stop_pondering() is called. The root
+  // board stays unchanged until then, so the thread can search on it.
+  background_thread = std::thread([this]() {
+    try {
+      std::atomic<int> mcts_iteration_counter(0);
+      run_search(*root_board,
+                 std::chrono::high_resolution_clock::time_point::max(), 0,
+                 mcts_iteration_counter);
+    } catch (...) {
+      ponder_exception = std::current_exception();
+    }
+  });
 }
 
-void Mcts_agent::perform_mcts_iterations(
+void Mcts_agent::stop_pondering() {
+  if (!background_thread.joinable()) {
+    return;
+  }
+  set_stop_requested(true);
+  background_thread.join();
+  set_stop_requested(false);
+  if (ponder_exception) {
+    std::exception_ptr exception = ponder_exception;
+    ponder_exception = nullptr;
+    std::rethrow_exception(exception);
+  }
+}
+
+std::future<std::pair<int, int>> Mcts_agent::start_choosing_move(
+    const Board& board, Cell_state player, bool is_pondering) {
+  if (is_verbose) {
+    throw std::logic_error(
+        "Background searches and verbose mode do not make sense together.");
+  }
+  stop_pondering();
+  set_stop_requested(false);
+  // Shared with the thread, since a thread needs a copyable task in C++14
+  auto promise = std::make_shared<std::promise<std::pair<int, int>>>();
+  std::future<std::pair<int, int>> future = promise->get_future();
+  background_thread = std::thread([this, board, player, is_pondering,
+                                   promise]() {
+    std::pair<int, int> move;
+    try {
+      Search_statistics statistics;
+      move = search_move(board, player, statistics);
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+      return;
+    }
+    if (!is_pondering) {
+      promise->set_value(move);
+      return;
+    }
+    // Think about the opponent's reply until the agent is used again. A
+    // cancellation of the move does not stop pondering, but one after the
+    // move is known does.
+    set_stop_requested(false);
+    promise->set_value(move);
+    Board next_board = board;
+    next_board.make_move(move.first, move.second, player);
+    if (next_board.check_winner() != Cell_state::Empty ||
+        is_stop_requested.load()) {
+      return;
+    }
+    try {
+      prepare_root(next_board, get_opponent(player));
+      std::atomic<int> mcts_iteration_counter(0);
+      run_search(*root_board,
+                 std::chrono::high_resolution_clock::time_point::max(), 0,
+                 mcts_iteration_counter);
+    } catch (...) {
+      ponder_exception = std::current_exception();
+    }
+  });
+  return future;
+}
+
+void Mcts_agent::cancel_search() { set_stop_requested(true); }
+
+Search_progress Mcts_agent::get_search_progress() const {
+  std::uint64_t statistics_by_cell[Hex_adjacency::max_cells] = {};
+  int board_size = 0;
+  if (root_agents.empty()) {
+    add_root_statistics(statistics_by_cell, board_size);
+  } else {
+    for (const auto& root_agent : root_agents) {
+      root_agent->add_root_statistics(statistics_by_cell, board_size);
+    }
+  }
+  // Choose the move the way select_best_child() does
+  Search_progress progress;
+  double max_score = -1.;
+  for (int cell = 0; cell < board_size * board_size; ++cell) {
+    const int visit_count = Node::get_visit_count(statistics_by_cell[cell]);
+    if (visit_count == 0) {
+      continue;
+    }
+    progress.playouts += visit_count;
+    const double win_ratio =
+        static_cast<double>(Node::get_win_count(statistics_by_cell[cell])) /
+        visit_count;
+    const double score = rave_equivalence > 0. ? visit_count : win_ratio;
+    if (score > max_score) {
+      max_score = score;
+      progress.best_move = std::make_pair(cell / board_size, cell % board_size);
+      progress.best_move_visits = visit_count;
+      progress.best_move_win_ratio = win_ratio;
+    }
+  }
+  return progress;
+}
+
+void Mcts_agent::add_root_statistics(std::uint64_t* statistics,
+                                     int& board_size) const {
+  std::lock_guard<std::mutex> lock(root_mutex);
+  if (!root_board) {
+    return;
+  }
+  board_size = root_board->get_board_size();
+  const Node& root = node_pool[root_index];
+  if (!Node::has_children(
+          root.expansion_state.load(std::memory_order_acquire))) {
+    return;
+  }
+  const std::uint32_t child_count =
+      root.child_count.load(std::memory_order_acquire);
+  std::uint32_t child_index =
+      root.first_child_index.load(std::memory_order_acquire);
+  for (std::uint32_t i = 0; i < child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    const Node& child = node_pool[child_index];
+    statistics[child.move_x * board_size + child.move_y] +=
+        node_statistics[child_index].load(std::memory_order_relaxed);
+  }
+}
+
+void Mcts_agent::prepare_root(const Board& board, Cell_state player) {
+  std::lock_guard<std::mutex> lock(root_mutex);
+  // Keep the part of the previous tree that matches the current game state
+  std::uint32_t subtree_index = find_reusable_subtree(board, player);
+  if (subtree_index != Node_pool<Node>::null_index) {
+    promote_subtree(subtree_index, board);
+    if (is_logging()) {
+      logger->log_tree_reused(
+          tree_node_count.load(std::memory_order_relaxed),
+          Node::get_visit_count(node_statistics[root_index].load()));
+    }
+  } else {
+    // Free the previous tree and create a new root node for MCTS. Its player
+    // is the one who made the last move, so that its children belong to the
+    // player to move.
+    node_pool.clear();
+    if (transposition_table) {
+      transposition_table->clear();
+    }
+    root_index = node_pool.allocate(1);
+    initialize_node(root_index, get_opponent(player), std::make_pair(-1, -1));
+    tree_node_count.store(1, std::memory_order_relaxed);
+  }
+  root_board = std::make_unique<Board>(board);
+  // Expand root based on the current game state. A reused root has a
+  // child for every move only once every move was tried, and the root's
+  // statistics are read by move through its children, so complete it.
+  Statistics_recorder recorder;
+  const std::uint32_t all_moves = Hex_adjacency::max_cells;
+  if (is_logging()) {
+    if (expand_node<true>(root_index, board, recorder)) {
+      add_children<true>(root_index, board, all_moves);
+    }
+  } else if (expand_node<false>(root_index, board, recorder)) {
+    add_children<false>(root_index, board, all_moves);
+  }
+}
+
+void Mcts_agent::run_search(
+    const Board& board,
     const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
-    int& mcts_iteration_counter, const Board& board,
-    unsigned int number_of_threads) {
-  while (std::chrono::high_resolution_clock::now() < end_time) {
-    logger->log_iteration_number(mcts_iteration_counter + 1);
-    // Select a child node for playout using UCT
-    std::shared_ptr<Node> chosen_child = select_child_for_playout(root);
-    // If parallelization is enabled, run playouts concurrently:
-    if (is_parallelized) {
-      std::vector<Cell_state> results =
-          parallel_playout(chosen_child, board, number_of_threads);
-      // Backpropagate each of the results
-      for (Cell_state playout_winner : results) {
-        backpropagate(chosen_child, playout_winner);
-      }
-      // Else, just do a single playout:
+    int max_iterations, std::atomic<int>& mcts_iteration_counter,
+    bool is_resumed) {
+  if (!is_resumed) {
+    playout_allocation_count.store(0);
+    is_best_move_settled.store(false);
+    search_start_time = std::chrono::high_resolution_clock::now();
+  }
+  if (!root_agents.empty()) {
+    run_root_search(board, end_time, max_iterations, mcts_iteration_counter);
+    return;
+  }
+  if (evaluation_queue) {
+    evaluation_queue->start(
+        thread_pool ? thread_pool->get_number_of_threads() : 1,
+        board.get_board_size());
+  }
+  if (!is_resumed) {
+    worker_statistics.assign(
+        thread_pool ? thread_pool->get_number_of_threads() : 1,
+        Worker_statistics());
+  }
+  if (thread_pool) {
+    // Every worker runs whole iterations on the shared tree at the same time,
+    // each with its own board and random number generator
+    std::vector<Xoshiro_generator::result_type> worker_seeds(
+        thread_pool->get_number_of_threads());
+    for (auto& seed : worker_seeds) {
+      seed = random_generator();
+    }
+    // Parallel search is never verbose, so the workers run the search without
+    // any logging
+    thread_pool->run_on_all_workers([&](unsigned int worker_index) {
+      Xoshiro_generator worker_generator(worker_seeds[worker_index]);
+      Statistics_recorder recorder;
+      perform_mcts_iterations<false>(end_time, max_iterations,
+                                     mcts_iteration_counter, board,
+                                     worker_generator, recorder);
+      worker_statistics[worker_index] = recorder.statistics;
+    });
+  } else {
+    Statistics_recorder recorder;
+    if (is_logging()) {
+      perform_mcts_iterations<true>(end_time, max_iterations,
+                                    mcts_iteration_counter, board,
+                                    random_generator, recorder);
+    } else {
+      perform_mcts_iterations<false>(end_time, max_iterations,
+                                     mcts_iteration_counter, board,
+                                     random_generator, recorder);
+    }
+    if (is_resumed) {
+      add_worker_statistics(worker_statistics[0], recorder.statistics);
     } else {
-      Cell_state playout_winner = simulate_random_playout(chosen_child, board);
-      backpropagate(chosen_child, playout_winner);
+      worker_statistics[0] = recorder.statistics;
+    }
+  }
+}
+
+void Mcts_agent::run_root_search(
+    const Board& board,
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
+    int max_iterations, std::atomic<int>& mcts_iteration_counter) {
+  const Cell_state player = get_opponent(node_pool[root_index].player);
+  const int tree_count = static_cast<int>(root_agents.size());
+  std::vector<int> iteration_counts(root_agents.size(), 0);
+  worker_statistics.assign(root_agents.size(), Worker_statistics());
+  thread_pool->run_on_all_workers([&](unsigned int worker_index) {
+    Mcts_agent& root_agent = *root_agents[worker_index];
+    // The tree is prepared by its worker, which touches its memory first
+    root_agent.prepare_root(board, player);
+    prepared_root_count.fetch_add(1, std::memory_order_release);
+    // Divide the iterations among the trees. A tree that gets none keeps the
+    // counts of its reused subtree.
+    int tree_iterations = 0;
+    if (max_iterations != 0) {
+      tree_iterations = max_iterations / tree_count +
+                        (static_cast<int>(worker_index) <
+                         max_iterations % tree_count);
+      if (tree_iterations == 0) {
+        return;
+      }
+    }
+    std::atomic<int> tree_iteration_counter(0);
+    root_agent.run_search(*root_agent.root_board, end_time, tree_iterations,
+                          tree_iteration_counter);
+    iteration_counts[worker_index] = tree_iteration_counter;
+    worker_statistics[worker_index] = root_agent.worker_statistics[0];
+    playout_allocation_count.fetch_add(
+        root_agent.get_playout_allocation_count(), std::memory_order_relaxed);
+  });
+  int iteration_count = 0;
+  bool is_every_tree_settled = true;
+  for (int i = 0; i < tree_count; ++i) {
+    iteration_count += iteration_counts[i];
+    is_every_tree_settled =
+        is_every_tree_settled && root_agents[i]->is_best_move_settled.load();
+  }
+  mcts_iteration_counter.store(iteration_count);
+  is_best_move_settled.store(is_every_tree_settled);
+  merge_root_statistics();
+}
+
+void Mcts_agent::merge_root_statistics() {
+  const Node& root = node_pool[root_index];
+  const int board_size = root_board->get_board_size();
+  // The offset of the root child of every cell, so that the children of the
+  // private roots can be matched by move
+  std::uint16_t child_offsets[Hex_adjacency::max_cells];
+  std::uint32_t child_index = root.first_child_index;
+  for (std::uint16_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    const Node& child = node_pool[child_index];
+    child_offsets[child.move_x * board_size + child.move_y] = i;
+  }
+  std::vector<std::uint64_t> child_statistics(root.child_count, 0);
+  std::uint64_t root_statistics = 0;
+  for (const auto& root_agent : root_agents) {
+    const Node& tree_root = root_agent->node_pool[root_agent->root_index];
+    root_statistics += root_agent->node_statistics[root_agent->root_index];
+    if (!Node::has_children(tree_root.expansion_state.load())) {
+      continue;
+    }
+    std::uint32_t tree_child_index = tree_root.first_child_index;
+    for (std::uint32_t i = 0; i < tree_root.child_count;
+         tree_child_index =
+             root_agent->get_next_child_index(tree_child_index, i++)) {
+      const Node& child = root_agent->node_pool[tree_child_index];
+      // The packed counts can be added as a whole
+      child_statistics[child_offsets[child.move_x * board_size +
+                                     child.move_y]] +=
+          root_agent->node_statistics[tree_child_index].load();
+    }
+  }
+  // Add the counts received from the cluster, if any. The root counts a loss
+  // for every win of a child.
+  for (std::size_t cell = 0; cell < remote_root_statistics.size(); ++cell) {
+    const std::uint64_t statistics = remote_root_statistics[cell];
+    if (statistics != 0) {
+      child_statistics[child_offsets[cell]] += statistics;
+      root_statistics += Node::get_visit_count(statistics) * Node::one_visit +
+                         Node::get_visit_count(statistics) -
+                         Node::get_win_count(statistics);
+    }
+  }
+  node_statistics[root_index].store(root_statistics);
+  child_index = root.first_child_index;
+  for (std::uint32_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    node_statistics[child_index].store(child_statistics[i]);
+  }
+}
+
+void Mcts_agent::synchronize_root_statistics(std::uint64_t position_hash,
+                                             Search_end_signal& signal) {
+  const std::size_t cell_count = static_cast<std::size_t>(
+      root_board->get_board_size() * root_board->get_board_size());
+  // The local counts that were sent and the counts that were received in the
+  // previous rounds
+  std::vector<std::uint64_t> sent_statistics(cell_count, 0);
+  std::vector<std::uint64_t> received_statistics(cell_count, 0);
+  std::vector<std::uint64_t> local_statistics(cell_count, 0);
+  std::vector<std::uint64_t> statistics(cell_count, 0);
+  bool is_cluster_finished = false;
+  while (!is_cluster_finished) {
+    bool is_search_finished;
+    {
+      std::unique_lock<std::mutex> lock(signal.mutex);
+      signal.condition.wait_for(
+          lock, cluster_link->get_sync_interval(),
+          [&signal]() { return signal.is_search_finished; });
+      is_search_finished = signal.is_search_finished;
+    }
+    // Send only what the local search added since the previous round. The
+    // counts only grow, since a virtual loss is counted as a visit for good.
+    std::fill(statistics.begin(), statistics.end(), 0);
+    if (read_local_root_statistics(received_statistics, local_statistics)) {
+      for (std::size_t cell = 0; cell < cell_count; ++cell) {
+        statistics[cell] = local_statistics[cell] - sent_statistics[cell];
+      }
+      sent_statistics.swap(local_statistics);
+    }
+    is_cluster_finished =
+        cluster_link->exchange(position_hash, is_search_finished, statistics);
+    for (std::size_t cell = 0; cell < cell_count; ++cell) {
+      received_statistics[cell] += statistics[cell];
+    }
+    // The private trees never see the counts, which are added when they are
+    // merged after the synchronization
+    if (root_agents.empty()) {
+      add_remote_root_statistics(statistics);
+    }
+  }
+  remote_root_statistics.swap(received_statistics);
+}
+
+bool Mcts_agent::read_local_root_statistics(
+    const std::vector<std::uint64_t>& received_statistics,
+    std::vector<std::uint64_t>& statistics) const {
+  const int board_size = root_board->get_board_size();
+  std::fill(statistics.begin(), statistics.end(), 0);
+  if (root_agents.empty()) {
+    // The root children also hold the counts received so far
+    const Node& root = node_pool[root_index];
+    std::uint32_t child_index = root.first_child_index;
+    for (std::uint32_t i = 0; i < root.child_count;
+         child_index = get_next_child_index(child_index, i++)) {
+      const Node& child = node_pool[child_index];
+      const int cell = child.move_x * board_size + child.move_y;
+      statistics[cell] =
+          node_statistics[child_index].load(std::memory_order_relaxed) -
+          received_statistics[cell];
+    }
+    return true;
+  }
+  // The workers prepare the private roots when the search starts
+  if (prepared_root_count.load(std::memory_order_acquire) <
+      root_agents.size()) {
+    return false;
+  }
+  for (const auto& root_agent : root_agents) {
+    const Node& tree_root = root_agent->node_pool[root_agent->root_index];
+    std::uint32_t child_index = tree_root.first_child_index;
+    for (std::uint32_t i = 0; i < tree_root.child_count;
+         child_index = root_agent->get_next_child_index(child_index, i++)) {
+      const Node& child = root_agent->node_pool[child_index];
+      statistics[child.move_x * board_size + child.move_y] +=
+          root_agent->node_statistics[child_index].load(
+              std::memory_order_relaxed);
+    }
+  }
+  return true;
+}
+
+void Mcts_agent::add_remote_root_statistics(
+    const std::vector<std::uint64_t>& statistics) {
+  // Let the counts steer the selection at the root right away. The root
+  // counts a loss for every win of a child.
+  const int board_size = root_board->get_board_size();
+  const Node& root = node_pool[root_index];
+  std::uint64_t root_statistics = 0;
+  std::uint32_t child_index = root.first_child_index;
+  for (std::uint32_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    const Node& child = node_pool[child_index];
+    const std::uint64_t child_statistics =
+        statistics[child.move_x * board_size + child.move_y];
+    if (child_statistics != 0) {
+      node_statistics[child_index].fetch_add(
+          child_statistics, std::memory_order_relaxed);
+      root_statistics +=
+          Node::get_visit_count(child_statistics) * Node::one_visit +
+          Node::get_visit_count(child_statistics) -
+          Node::get_win_count(child_statistics);
+    }
+  }
+  node_statistics[root_index].fetch_add(root_statistics,
+                                        std::memory_order_relaxed);
+}
+
+std::size_t Mcts_agent::get_playout_allocation_count() const {
+  return playout_allocation_count.load();
+}
+
+std::size_t Mcts_agent::get_bytes_per_node() {
+  return sizeof(Node) + sizeof(std::atomic<std::uint64_t>) * 2;
+}
+
+Search_statistics Mcts_agent::collect_search_statistics(
+    int iteration_count, std::chrono::nanoseconds elapsed_time) const {
+  Search_statistics statistics;
+  statistics.iterations = iteration_count;
+  statistics.elapsed_time = elapsed_time;
+  if (elapsed_time.count() > 0) {
+    statistics.playouts_per_second =
+        iteration_count / std::chrono::duration<double>(elapsed_time).count();
+  }
+  std::int64_t total_depth = 0;
+  int depth_count = 0;
+  for (const Worker_statistics& worker : worker_statistics) {
+    statistics.max_depth = std::max(statistics.max_depth, worker.max_depth);
+    total_depth += worker.total_depth;
+    depth_count += worker.iterations;
+    statistics.selection_time += worker.selection_time;
+    statistics.expansion_time += worker.expansion_time;
+    statistics.simulation_time += worker.simulation_time;
+    statistics.backpropagation_time += worker.backpropagation_time;
+    statistics.expansion_collisions += worker.expansion_collisions;
+    statistics.failed_expansions += worker.failed_expansions;
+    statistics.transposition_hits += worker.transposition_hits;
+    statistics.evaluation_waits += worker.evaluation_waits;
+  }
+  if (depth_count > 0) {
+    statistics.average_depth =
+        static_cast<double>(total_depth) / depth_count;
+  }
+  statistics.node_count = get_tree_node_count();
+  statistics.tree_bytes = statistics.node_count * get_bytes_per_node();
+  statistics.workers = worker_statistics;
+  return statistics;
+}
+
+bool Mcts_agent::is_logging() const {
+  return is_verbose && logger->get_verbosity();
+}
+
+void Mcts_agent::set_stop_requested(bool is_requested) {
+  is_stop_requested.store(is_requested);
+  for (const auto& root_agent : root_agents) {
+    root_agent->is_stop_requested.store(is_requested);
+  }
+}
+
+std::uint32_t Mcts_agent::get_tree_node_count() const {
+  if (root_agents.empty()) {
+    return tree_node_count.load(std::memory_order_relaxed);
+  }
+  std::uint32_t node_count = 0;
+  for (const auto& root_agent : root_agents) {
+    node_count += root_agent->tree_node_count.load(std::memory_order_relaxed);
+  }
+  return node_count;
+}
+
+template <bool verbose>
+bool Mcts_agent::expand_node(std::uint32_t node_index, const Board& board,
+                             Statistics_recorder& recorder) {
+  Node& node = node_pool[node_index];
+  // Only the worker that claims the node may expand it. The others find it
+  // either already expanded or still being expanded.
+  std::uint8_t expected_state = Node::Unexpanded;
+  if (!node.expansion_state.compare_exchange_strong(
+          expected_state, Node::Expanding, std::memory_order_acquire)) {
+    ++recorder.statistics.expansion_collisions;
+    return Node::has_children(expected_state);
+  }
+  // Share the children of the same game state reached by another move order
+  std::uint32_t first_child_index = Node_pool<Node>::null_index;
+  std::uint16_t child_count = 0;
+  if (transposition_table &&
+      transposition_table->find(board.get_hash(), first_child_index,
+                                child_count)) {
+    ++recorder.statistics.transposition_hits;
+    node.first_child_index.store(first_child_index,
+                                 std::memory_order_relaxed);
+    node.child_count.store(child_count, std::memory_order_relaxed);
+    node.child_capacity = child_count;
+    node.expansion_state.store(Node::Expanded, std::memory_order_release);
+    return true;
+  }
+  // The root and, since only children collect AMAF counts, every node with
+  // RAVE get all their children right away
+  const bool is_complete = node_index == root_index || rave_equivalence > 0.;
+  if (!add_children<verbose>(
+          node_index, board,
+          is_complete ? static_cast<std::uint32_t>(Hex_adjacency::max_cells)
+                      : 1)) {
+    // The pool is full, so the node stays a leaf
+    ++recorder.statistics.failed_expansions;
+    node.expansion_state.store(Node::Unexpanded, std::memory_order_relaxed);
+    return false;
+  }
+  // Publish the children to the workers descending through the node
+  node.expansion_state.store(Node::Expanded, std::memory_order_release);
+  return true;
+}
+
+std::uint32_t Mcts_agent::get_child_moves(const Board& board,
+                                          std::uint32_t move_count,
+                                          std::pair<int, int>* moves) {
+  const int board_size = board.get_board_size();
+  const Hex_adjacency& adjacency = Hex_adjacency::for_board_size(board_size);
+  // Count the stones next to every cell
+  std::uint8_t stone_counts[Hex_adjacency::max_cells] = {};
+  for (int cell_index = 0; cell_index < board_size * board_size;
+       ++cell_index) {
+    if (board.get_cell_state(adjacency.get_row(cell_index),
+                             adjacency.get_column(cell_index)) ==
+        Cell_state::Empty) {
+      continue;
+    }
+    for (std::int16_t neighbour : adjacency.get_neighbours(cell_index)) {
+      if (neighbour != Hex_adjacency::off_board) {
+        ++stone_counts[neighbour];
+      }
+    }
+  }
+  // Sort the empty cells by a key of the stone count, the closeness to the
+  // centre and the cell index, in this order
+  std::uint32_t keys[Hex_adjacency::max_cells];
+  std::uint32_t cell_count = 0;
+  for (int cell_index = 0; cell_index < board_size * board_size;
+       ++cell_index) {
+    const int x = adjacency.get_row(cell_index);
+    const int y = adjacency.get_column(cell_index);
+    if (board.get_cell_state(x, y) != Cell_state::Empty) {
+      continue;
+    }
+    // The hexagonal distance to the centre, in half cells
+    const int offset_x = 2 * x - (board_size - 1);
+    const int offset_y = 2 * y - (board_size - 1);
+    const int distance =
+        std::max({std::abs(offset_x), std::abs(offset_y),
+                  std::abs(offset_x + offset_y)});
+    keys[cell_count++] =
+        static_cast<std::uint32_t>(stone_counts[cell_index]) << 24 |
+        static_cast<std::uint32_t>(255 - distance) << 16 |
+        static_cast<std::uint32_t>(0xffff - cell_index);
+  }
+  move_count = std::min(move_count, cell_count);
+  std::partial_sort(keys, keys + move_count, keys + cell_count,
+                    std::greater<std::uint32_t>());
+  for (std::uint32_t i = 0; i < move_count; ++i) {
+    const int cell_index = 0xffff - static_cast<int>(keys[i] & 0xffff);
+    moves[i] = std::make_pair(adjacency.get_row(cell_index),
+                              adjacency.get_column(cell_index));
+  }
+  return move_count;
+}
+
+std::uint32_t Mcts_agent::get_chunk_end(std::uint32_t child_count,
+                                        std::uint32_t move_count) {
+  // The chunks end after 1, 3, 7, 15 and so on children
+  std::uint32_t chunk_end = 1;
+  while (chunk_end < child_count) {
+    chunk_end = 2 * chunk_end + 1;
+  }
+  return std::min(chunk_end, move_count);
+}
+
+std::uint32_t Mcts_agent::get_child_index(std::uint32_t first_child_index,
+                                          std::uint32_t child_offset) const {
+  // Skip the chunks before the one of the child. The chunk that starts at
+  // position s holds s + 1 children.
+  std::uint32_t child_index = first_child_index;
+  std::uint32_t chunk_start = 0;
+  while (child_offset > 2 * chunk_start) {
+    child_index = node_pool[child_index].next_chunk_index.load(
+        std::memory_order_relaxed);
+    chunk_start = 2 * chunk_start + 1;
+  }
+  return child_index + (child_offset - chunk_start);
+}
+
+std::uint32_t Mcts_agent::get_next_child_index(
+    std::uint32_t child_index, std::uint32_t child_offset) const {
+  // Only the child at position 2s ends the chunk that starts at position s
+  if (((child_offset + 2) & (child_offset + 1)) != 0) {
+    return child_index + 1;
+  }
+  return node_pool[child_index - (child_offset - child_offset / 2)]
+      .next_chunk_index.load(std::memory_order_relaxed);
+}
+
+template <bool verbose>
+bool Mcts_agent::add_children(std::uint32_t node_index, const Board& board,
+                              std::uint32_t child_count) {
+  Node& node = node_pool[node_index];
+  const std::uint32_t old_child_count =
+      node.child_count.load(std::memory_order_relaxed);
+  std::pair<int, int> moves[Hex_adjacency::max_cells];
+  child_count = get_child_moves(board, child_count, moves);
+  if (child_count <= old_child_count) {
+    return true;
+  }
+  std::uint32_t first_child_index =
+      node.first_child_index.load(std::memory_order_relaxed);
+  const std::uint32_t old_capacity = node.child_capacity;
+  if (child_count > old_capacity) {
+    // Allocate the chunks up to the one of the last new child in one piece,
+    // and link them to each other and to the last chunk of the block. The
+    // workers that descend through the node only follow the links once the
+    // new children are published.
+    const std::uint32_t capacity = get_chunk_end(
+        child_count, static_cast<std::uint32_t>(board.get_empty_cell_count()));
+    const std::uint32_t chunk_index =
+        node_pool.allocate(capacity - old_capacity);
+    if (chunk_index == Node_pool<Node>::null_index) {
+      return false;
+    }
+    for (std::uint32_t chunk_start = old_capacity; chunk_start < capacity;
+         chunk_start = 2 * chunk_start + 1) {
+      const std::uint32_t next_chunk_start = 2 * chunk_start + 1;
+      node_pool[chunk_index + chunk_start - old_capacity]
+          .next_chunk_index.store(
+              next_chunk_start < capacity
+                  ? chunk_index + next_chunk_start - old_capacity
+                  : Node_pool<Node>::null_index,
+              std::memory_order_relaxed);
+    }
+    if (old_capacity == 0) {
+      first_child_index = chunk_index;
+    } else {
+      node_pool[get_child_index(first_child_index, (old_capacity - 1) / 2)]
+          .next_chunk_index.store(chunk_index, std::memory_order_relaxed);
+    }
+    node.child_capacity = static_cast<std::uint16_t>(capacity);
+  }
+  // The moves are made by the opponent of the node's player
+  const Cell_state child_player = get_opponent(node.player);
+  std::uint32_t child_index =
+      get_child_index(first_child_index, old_child_count);
+  for (std::uint32_t i = old_child_count; i < child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    initialize_node(child_index, child_player, moves[i]);
+    if (verbose) {
+      logger->log_expanded_child(moves[i]);
+    }
+  }
+  tree_node_count.fetch_add(child_count - old_child_count,
+                            std::memory_order_relaxed);
+  // Publish the children to the workers descending through the node, and,
+  // once the block is complete and cannot grow anymore, through the nodes of
+  // the same game state
+  node.first_child_index.store(first_child_index, std::memory_order_release);
+  node.child_count.store(static_cast<std::uint16_t>(child_count),
+                         std::memory_order_release);
+  if (transposition_table &&
+      child_count == static_cast<std::uint32_t>(board.get_empty_cell_count())) {
+    transposition_table->store(board.get_hash(), first_child_index,
+                               static_cast<std::uint16_t>(child_count));
+  }
+  return true;
+}
+
+std::uint32_t Mcts_agent::get_widened_child_count(
+    int visit_count, std::uint32_t move_count) const {
+  if (search_limits.widening_factor <= 0.) {
+    return move_count;
+  }
+  const double widened_count =
+      std::ceil(search_limits.widening_factor *
+                std::pow(visit_count, search_limits.widening_exponent));
+  if (widened_count >= move_count) {
+    return move_count;
+  }
+  return std::max(static_cast<std::uint32_t>(widened_count), 1u);
+}
+
+int Mcts_agent::claim_iteration(
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
+    int max_iterations, std::atomic<int>& mcts_iteration_counter,
+    int& iterations_until_time_check) {
+  if (is_stop_requested.load(std::memory_order_relaxed) ||
+      is_best_move_settled.load(std::memory_order_relaxed)) {
+    return 0;
+  }
+  const bool is_timed =
+      end_time != std::chrono::high_resolution_clock::time_point::max();
+  const bool is_sliced =
+      slice_end_time != std::chrono::high_resolution_clock::time_point::max();
+  const bool is_stopping_early = search_limits.is_early_stop_enabled &&
+                                 (is_timed || max_iterations != 0);
+  // Read the clock and check whether the best move is settled only once per
+  // time check interval
+  if ((is_timed || is_sliced || is_stopping_early) &&
+      --iterations_until_time_check <= 0) {
+    const auto now = is_timed || is_sliced
+                         ? std::chrono::high_resolution_clock::now()
+                         : search_start_time;
+    if ((is_timed && now >= end_time) || (is_sliced && now >= slice_end_time)) {
+      return 0;
+    }
+    if (is_stopping_early &&
+        check_best_move_settled(
+            mcts_iteration_counter.load(std::memory_order_relaxed),
+            max_iterations, end_time, now)) {
+      // Stop the other workers as well
+      is_best_move_settled.store(true, std::memory_order_relaxed);
+      return 0;
+    }
+    iterations_until_time_check = search_limits.time_check_interval;
+  }
+  if (search_limits.max_tree_nodes != 0 &&
+      tree_node_count.load(std::memory_order_relaxed) >=
+          search_limits.max_tree_nodes) {
+    return 0;
+  }
+  // Claim an iteration, and give it back if the budget is used up
+  int iteration_number = mcts_iteration_counter.fetch_add(1) + 1;
+  if (max_iterations != 0 && iteration_number > max_iterations) {
+    mcts_iteration_counter.fetch_sub(1);
+    return 0;
+  }
+  return iteration_number;
+}
+
+template <bool verbose>
+std::uint32_t Mcts_agent::select_and_expand_leaf(
+    Board& board, Search_path& path, Cell_state& winner,
+    Statistics_recorder& recorder) {
+  // Select a leaf of the tree using UCT and apply the moves leading to it
+  std::uint32_t leaf_index = select_leaf<verbose>(board, path);
+  recorder.end_phase(recorder.statistics.selection_time);
+  // Expand the leaf if the game is not over yet, and step into one of its
+  // new children. If another worker is still expanding the leaf, simulate
+  // from the leaf itself instead of waiting.
+  winner = board.check_winner();
+  if (winner == Cell_state::Empty &&
+      expand_node<verbose>(leaf_index, board, recorder)) {
+    leaf_index = select_child_for_playout<verbose>(leaf_index, board);
+    const Node& leaf = node_pool[leaf_index];
+    board.make_move(leaf.move_x, leaf.move_y, leaf.player);
+    path.push_back(leaf_index);
+    winner = board.check_winner();
+  }
+  recorder.end_phase(recorder.statistics.expansion_time);
+  recorder.record_depth(static_cast<int>(path.size()) - 1);
+  return leaf_index;
+}
+
+template <bool verbose>
+void Mcts_agent::perform_mcts_iterations(
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
+    int max_iterations, std::atomic<int>& mcts_iteration_counter,
+    const Board& board, Xoshiro_generator& generator,
+    Statistics_recorder& recorder) {
+  if (evaluation_queue) {
+    perform_batched_iterations<verbose>(end_time, max_iterations,
+                                        mcts_iteration_counter, board,
+                                        generator, recorder);
+    return;
+  }
+  // The moves along the selected path are applied to and undone on this copy,
+  // so the board is copied once per decision rather than once per iteration.
+  Board search_board = board;
+  // Everything a playout needs is allocated here once
+  Playout_scratch scratch(board);
+  Search_path path;
+  path.reserve(Hex_adjacency::max_cells + 1);
+  int iterations_until_time_check = 0;
+  while (int iteration_number =
+             claim_iteration(end_time, max_iterations, mcts_iteration_counter,
+                             iterations_until_time_check)) {
+    if (verbose) {
+      logger->log_iteration_number(iteration_number);
+    }
+    Cell_state winner = Cell_state::Empty;
+    recorder.start_iteration();
+    std::uint32_t leaf_index =
+        select_and_expand_leaf<verbose>(search_board, path, winner, recorder);
+    // Simulate a playout unless the game is already decided, in which case
+    // the search board holds the final position
+    const Board* final_board = &search_board;
+    if (winner == Cell_state::Empty) {
+      std::size_t allocations_before = get_thread_allocation_count();
+      winner = simulate_playout<verbose>(node_pool[leaf_index], search_board,
+                                         scratch, generator);
+      final_board = &scratch.board;
+      std::size_t allocations = get_thread_allocation_count() -
+                                allocations_before;
+      if (allocations != 0) {
+        playout_allocation_count.fetch_add(allocations,
+                                           std::memory_order_relaxed);
+      }
+      recorder.end_phase(recorder.statistics.simulation_time);
+    }
+    backpropagate<verbose>(path, winner, *final_board);
+    recorder.end_phase(recorder.statistics.backpropagation_time);
+    // Restore the board to the root position
+    for (std::size_t i = 1; i < path.size(); ++i) {
+      search_board.undo_move();
     }
     // Print statistics:
-    logger->log_root_stats(root->visit_count, root->win_count,
-                           root->child_nodes.size());
-    for (const auto& child : root->child_nodes) {
-      logger->log_child_node_stats(child->move, child->win_count,
-                                   child->visit_count);
+    if (verbose) {
+      const Node& root = node_pool[root_index];
+      std::uint64_t root_statistics = node_statistics[root_index].load();
+      logger->log_root_stats(Node::get_visit_count(root_statistics),
+                             Node::get_win_count(root_statistics),
+                             root.child_count);
+      std::uint32_t child_index = root.first_child_index;
+      for (std::uint32_t i = 0; i < root.child_count;
+           child_index = get_next_child_index(child_index, i++)) {
+        const Node& child = node_pool[child_index];
+        std::uint64_t child_statistics = node_statistics[child_index].load();
+        logger->log_child_node_stats(child.get_move(),
+                                     Node::get_win_count(child_statistics),
+                                     Node::get_visit_count(child_statistics));
+      }
     }
-    mcts_iteration_counter++;
   }
 }
 
-std::shared_ptr<Mcts_agent::Node> Mcts_agent::select_child_for_playout(
-    const std::shared_ptr<Node>& parent_node) {
-  // Initialize best_child as the first child and calculate its UCT score
-  std::shared_ptr<Node> best_child = parent_node->child_nodes[0];
-  double max_score = calculate_uct_score(best_child, parent_node);
-  // Iterate over the remaining child nodes to find the one with the highest UCT
-  // score
-  for (auto iterator = std::next(parent_node->child_nodes.begin());
-       iterator != parent_node->child_nodes.end(); ++iterator) {
-    const auto& child = *iterator;
-    double uct_score = calculate_uct_score(child, parent_node);
+template <bool verbose>
+void Mcts_agent::perform_batched_iterations(
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
+    int max_iterations, std::atomic<int>& mcts_iteration_counter,
+    const Board& board, Xoshiro_generator& generator,
+    Statistics_recorder& recorder) {
+  // Let the other workers know when this one stops, however it stops
+  struct Worker_exit {
+    Evaluation_queue& queue;
+    ~Worker_exit() { queue.finish_worker(); }
+  } worker_exit{*evaluation_queue};
+  Board search_board = board;
+  const std::size_t leaves_per_worker =
+      evaluation_queue->get_leaves_per_worker();
+  // The leaves collected before they are evaluated together, with the paths
+  // that lead to them. Their boards are kept for the AMAF statistics.
+  Leaf_batch leaves;
+  std::vector<Search_path> leaf_paths(leaves_per_worker);
+  std::vector<Board> leaf_boards;
+  std::vector<float> win_probabilities;
+  for (Search_path& path : leaf_paths) {
+    path.reserve(Hex_adjacency::max_cells + 1);
+  }
+  leaf_boards.reserve(leaves_per_worker);
+  int iterations_until_time_check = 0;
+  bool is_searching = true;
+  while (is_searching) {
+    leaves.reset(board.get_board_size());
+    leaf_boards.clear();
+    std::size_t leaf_count = 0;
+    // Collect leaves. The virtual losses of the pending leaves steer the
+    // selection of the next ones to other branches.
+    while (leaf_count < leaves_per_worker) {
+      int iteration_number =
+          claim_iteration(end_time, max_iterations, mcts_iteration_counter,
+                          iterations_until_time_check);
+      if (iteration_number == 0) {
+        is_searching = false;
+        break;
+      }
+      if (verbose) {
+        logger->log_iteration_number(iteration_number);
+      }
+      Search_path& path = leaf_paths[leaf_count];
+      Cell_state winner = Cell_state::Empty;
+      recorder.start_iteration();
+      std::uint32_t leaf_index =
+          select_and_expand_leaf<verbose>(search_board, path, winner, recorder);
+      if (winner != Cell_state::Empty) {
+        // A decided game needs no evaluation, and its path is reused
+        backpropagate<verbose>(path, winner, search_board);
+        recorder.end_phase(recorder.statistics.backpropagation_time);
+      } else {
+        leaves.add_leaf(search_board,
+                        get_opponent(node_pool[leaf_index].player));
+        leaf_boards.push_back(search_board);
+        ++leaf_count;
+      }
+      for (std::size_t i = 1; i < path.size(); ++i) {
+        search_board.undo_move();
+      }
+    }
+    if (leaf_count == 0) {
+      continue;
+    }
+    recorder.start_batch();
+    evaluation_queue->evaluate(leaves, win_probabilities);
+    ++recorder.statistics.evaluation_waits;
+    recorder.end_phase(recorder.statistics.simulation_time);
+    // Draw the winner of every leaf from its win probability, so that the
+    // statistics keep counting whole wins
+    for (std::size_t i = 0; i < leaf_count; ++i) {
+      Cell_state player_to_move = leaves.players_to_move[i];
+      Cell_state winner = generator.bernoulli(win_probabilities[i])
+                              ? player_to_move
+                              : get_opponent(player_to_move);
+      backpropagate<verbose>(leaf_paths[i], winner, leaf_boards[i]);
+    }
+    recorder.end_phase(recorder.statistics.backpropagation_time);
+  }
+}
 
-    if (uct_score > max_score) {
-      max_score = uct_score;
-      best_child = child;
+template <bool verbose>
+std::uint32_t Mcts_agent::select_leaf(Board& board, Search_path& path) {
+  std::uint32_t node_index = root_index;
+  path.clear();
+  path.push_back(node_index);
+  add_virtual_loss(node_index);
+  // Descend along the children with the highest UCT scores until a node
+  // that has not been expanded is reached, playing their moves on the board
+  while (Node::has_children(node_pool[node_index].expansion_state.load(
+      std::memory_order_acquire))) {
+    node_index = select_child_for_playout<verbose>(node_index, board);
+    const Node& node = node_pool[node_index];
+    board.make_move(node.move_x, node.move_y, node.player);
+    path.push_back(node_index);
+  }
+  return node_index;
+}
+
+template <bool verbose>
+std::uint32_t Mcts_agent::select_child_for_playout(std::uint32_t parent_index,
+                                                   const Board& board) {
+  Node& parent_node = node_pool[parent_index];
+  std::uint32_t child_count =
+      parent_node.child_count.load(std::memory_order_acquire);
+  const std::uint32_t first_child_index =
+      parent_node.first_child_index.load(std::memory_order_acquire);
+  int parent_visit_count = Node::get_visit_count(
+      node_statistics[parent_index].load(std::memory_order_relaxed));
+  const std::uint32_t widened_child_count = get_widened_child_count(
+      std::max(parent_visit_count, 1),
+      static_cast<std::uint32_t>(board.get_empty_cell_count()));
+  // Once the newest child has been tried, the next move gets its child. If
+  // another worker is adding a child, choose among the existing ones.
+  std::uint8_t expected_state = Node::Expanded;
+  if (child_count < widened_child_count &&
+      Node::get_visit_count(
+          node_statistics[get_child_index(first_child_index, child_count - 1)]
+              .load(std::memory_order_relaxed)) != 0 &&
+      parent_node.expansion_state.compare_exchange_strong(
+          expected_state, Node::Widening, std::memory_order_acquire)) {
+    const std::uint32_t old_child_count =
+        parent_node.child_count.load(std::memory_order_relaxed);
+    const bool is_added =
+        old_child_count < widened_child_count &&
+        add_children<verbose>(parent_index, board, old_child_count + 1);
+    const std::uint32_t new_child_index =
+        get_child_index(first_child_index, old_child_count);
+    parent_node.expansion_state.store(Node::Expanded,
+                                      std::memory_order_release);
+    if (is_added) {
+      add_virtual_loss(new_child_index);
+      if (verbose) {
+        logger->log_selected_child(node_pool[new_child_index].get_move(),
+                                   std::numeric_limits<double>::max());
+      }
+      return new_child_index;
+    }
+  }
+  child_count = std::min(child_count, widened_child_count);
+  if (transposition_table) {
+    // Children shared with transposed nodes were also visited through them,
+    // which has to count for the exploration as well
+    int child_visit_count = 0;
+    std::uint32_t child_index = first_child_index;
+    for (std::uint32_t i = 0; i < child_count;
+         child_index = get_next_child_index(child_index, i++)) {
+      child_visit_count += Node::get_visit_count(
+          node_statistics[child_index].load(std::memory_order_relaxed));
+    }
+    parent_visit_count = std::max(parent_visit_count, child_visit_count);
+  }
+  const double exploration_numerator =
+      get_exploration_numerator(parent_visit_count);
+  // Find the child with the highest UCT score. Other workers may be updating
+  // the statistics, so each child's counts are taken from a single load.
+  std::uint32_t best_child_index = first_child_index;
+  double max_score = std::numeric_limits<double>::lowest();
+  if (rave_equivalence > 0.) {
+    std::uint32_t child_index = first_child_index;
+    for (std::uint32_t i = 0; i < child_count;
+         child_index = get_next_child_index(child_index, i++)) {
+      double rave_score = calculate_rave_score(
+          node_statistics[child_index].load(std::memory_order_relaxed),
+          node_amaf_statistics[child_index].load(std::memory_order_relaxed),
+          exploration_numerator);
+      if (rave_score > max_score) {
+        max_score = rave_score;
+        best_child_index = child_index;
+      }
+    }
+  } else {
+    // Take a snapshot of the children's counts, which the scores are then
+    // computed from several at a time
+    alignas(32) std::uint64_t child_statistics[Hex_adjacency::max_cells];
+    std::uint32_t child_index = first_child_index;
+    for (std::uint32_t i = 0; i < child_count;
+         child_index = get_next_child_index(child_index, i++)) {
+      child_statistics[i] =
+          node_statistics[child_index].load(std::memory_order_relaxed);
+    }
+    std::uint32_t best_offset = find_best_uct_child(
+        child_statistics, child_count, exploration_numerator);
+    best_child_index = get_child_index(first_child_index, best_offset);
+    if (verbose) {
+      std::uint64_t statistics = child_statistics[best_offset];
+      max_score = calculate_uct_score(Node::get_win_count(statistics),
+                                      Node::get_visit_count(statistics),
+                                      exploration_numerator);
     }
   }
+  // Count the visit right away so that other workers see the pending playout
+  // as a loss and spread out to other branches
+  add_virtual_loss(best_child_index);
   // If verbose mode is enabled, print the move coordinates and UCT score of the
   // selected child
-  logger->log_selected_child(best_child->move, max_score);
-  return best_child;
+  if (verbose) {
+    logger->log_selected_child(node_pool[best_child_index].get_move(),
+                               max_score);
+  }
+  return best_child_index;
 }
 
-double Mcts_agent::calculate_uct_score(
-    const std::shared_ptr<Node>& child_node,
-    const std::shared_ptr<Node>& parent_node) {
+double Mcts_agent::calculate_uct_score(int win_count, int visit_count,
+                                       double exploration_numerator) const {
   // If any child node has not been visited yet, return a high value to
   // encourage exploration
-  if (child_node->visit_count == 0) {
+  if (visit_count == 0) {
     return std::numeric_limits<double>::max();
   } else {
-    // Otherwise, calculate the UCT score using the UCT formula.
-    return static_cast<double>(child_node->win_count) /
-               child_node->visit_count +
-           exploration_factor * std::sqrt(std::log(parent_node->visit_count) /
-                                          child_node->visit_count);
+    // Otherwise, calculate the UCT score using the UCT formula. It is written
+    // exactly like in find_best_uct_child(), so both give the same scores.
+    return static_cast<double>(win_count) / visit_count +
+           exploration_numerator / std::sqrt(static_cast<double>(visit_count));
+  }
+}
+
+double Mcts_agent::get_exploration_numerator(int parent_visit_count) const {
+  return exploration_factor * std::sqrt(std::log(parent_visit_count));
+}
+
+double Mcts_agent::calculate_rave_score(std::uint64_t statistics,
+                                        std::uint64_t amaf_statistics,
+                                        double exploration_numerator) const {
+  int win_count = Node::get_win_count(statistics);
+  int visit_count = Node::get_visit_count(statistics);
+  int amaf_visit_count = Node::get_visit_count(amaf_statistics);
+  if (amaf_visit_count == 0) {
+    return calculate_uct_score(win_count, visit_count, exploration_numerator);
+  }
+  double amaf_win_ratio =
+      static_cast<double>(Node::get_win_count(amaf_statistics)) /
+      amaf_visit_count;
+  // Trust the AMAF statistics less the more often the node itself is visited
+  double beta = std::sqrt(rave_equivalence /
+                          (3. * visit_count + rave_equivalence));
+  double win_ratio =
+      visit_count == 0 ? 0. : static_cast<double>(win_count) / visit_count;
+  return (1. - beta) * win_ratio + beta * amaf_win_ratio +
+         exploration_numerator /
+             std::sqrt(static_cast<double>(std::max(visit_count, 1)));
+}
+
+void Mcts_agent::add_virtual_loss(std::uint32_t node_index) {
+  node_statistics[node_index].fetch_add(Node::one_visit,
+                                        std::memory_order_relaxed);
+}
+
+template <bool verbose>
+Cell_state Mcts_agent::simulate_playout(const Node& node, const Board& board,
+                                        Playout_scratch& scratch,
+                                        Xoshiro_generator& generator) {
+  switch (playout_mode) {
+    case Playout_mode::Fill_and_evaluate:
+      return simulate_filled_playout<verbose>(node, board, scratch, generator);
+    case Playout_mode::Bridge_responses:
+      return simulate_bridge_playout<verbose>(node, board, scratch, generator);
+    case Playout_mode::Move_by_move:
+    default:
+      return simulate_random_playout<verbose>(node, board, scratch, generator);
+  }
+}
+
+template <bool verbose>
+Cell_state Mcts_agent::simulate_random_playout(const Node& node,
+                                               const Board& board,
+                                               Playout_scratch& scratch,
+                                               Xoshiro_generator& generator) {
+  Board& playout_board = scratch.board;
+  playout_board = board;
+  // Start the simulation with the player at the node's move, which is already
+  // on the board
+  Cell_state current_player = node.player;
+  if (verbose) {
+    logger->log_simulation_start(node.get_move(), playout_board);
+  }
+  // Collect the empty cells once. Every move removes its cell from the list.
+  std::vector<std::pair<int, int>>& empty_cells = scratch.empty_cells;
+  playout_board.get_valid_moves(empty_cells);
+  // Continue simulation until a winner is detected
+  while (playout_board.check_winner() == Cell_state::Empty) {
+    // Switch player
+    current_player = get_opponent(current_player);
+    // Choose a move randomly and swap the last empty cell into its place
+    std::uint32_t move_index =
+        generator.bounded(static_cast<std::uint32_t>(empty_cells.size()));
+    std::pair<int, int> random_move = empty_cells[move_index];
+    empty_cells[move_index] = empty_cells.back();
+    empty_cells.pop_back();
+    if (verbose) {
+      logger->log_simulation_step(current_player, playout_board, random_move);
+    }
+    playout_board.make_move(random_move.first, random_move.second,
+                            current_player);
+    // If a player has won, break the loop
+    if (playout_board.check_winner() != Cell_state::Empty) {
+      if (verbose) {
+        logger->log_simulation_end(current_player, playout_board);
+      }
+      break;
+    }
+  }
+  return current_player;
+}
+
+template <bool verbose>
+Cell_state Mcts_agent::simulate_filled_playout(const Node& node,
+                                               const Board& board,
+                                               Playout_scratch& scratch,
+                                               Xoshiro_generator& generator) {
+  Board& playout_board = scratch.board;
+  playout_board = board;
+  // Start the simulation with the player at the node's move, which is already
+  // on the board
+  Cell_state current_player = node.player;
+  if (verbose) {
+    logger->log_simulation_start(node.get_move(), playout_board);
+  }
+  // Shuffle the remaining empty cells once to get a random filling order
+  std::vector<std::pair<int, int>>& empty_cells = scratch.empty_cells;
+  playout_board.get_valid_moves(empty_cells);
+  generator.shuffle(empty_cells);
+  // Assign the empty cells alternately to both players, starting with the
+  // opponent of the node's player
+  if (verbose) {
+    for (const auto& cell : empty_cells) {
+      current_player = get_opponent(current_player);
+      logger->log_simulation_step(current_player, playout_board, cell);
+      playout_board.make_move(cell.first, cell.second, current_player);
+    }
+  } else {
+    playout_board.fill_cells_alternately(empty_cells,
+                                         get_opponent(current_player));
+  }
+  // A full board always has exactly one winner, which a single flood fill
+  // determines
+  Cell_state winner = playout_board.check_winner();
+  if (verbose) {
+    logger->log_simulation_end(winner, playout_board);
   }
+  return winner;
 }
 
-Cell_state Mcts_agent::simulate_random_playout(
-    const std::shared_ptr<Node>& node, Board board) {
-  // Start the simulation with the player at the node's move
-  Cell_state current_player = node->player;
-  // Make the move at the node to make random moves from it
-  board.make_move(node->move.first, node->move.second, current_player);
-  logger->log_simulation_start(node->move, board);
+template <bool verbose>
+Cell_state Mcts_agent::simulate_bridge_playout(const Node& node,
+                                               const Board& board,
+                                               Playout_scratch& scratch,
+                                               Xoshiro_generator& generator) {
+  Board& playout_board = scratch.board;
+  playout_board = board;
+  // Start the simulation with the player at the node's move, which is already
+  // on the board
+  Cell_state current_player = node.player;
+  if (verbose) {
+    logger->log_simulation_start(node.get_move(), playout_board);
+  }
+  const Playout_patterns& patterns = *scratch.patterns;
+  const Hex_adjacency& adjacency = patterns.get_adjacency();
+  const int board_size = playout_board.get_board_size();
+  // Collect the cell states and the empty cells once. Every move removes its
+  // cell from the list.
+  std::vector<std::pair<int, int>>& empty_cells = scratch.empty_cells;
+  empty_cells.clear();
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      const int cell_index = x * board_size + y;
+      const Cell_state state = playout_board.get_cell_state(x, y);
+      scratch.cell_states[cell_index] = static_cast<std::uint8_t>(state);
+      if (state == Cell_state::Empty) {
+        scratch.empty_cell_positions[cell_index] =
+            static_cast<std::int16_t>(empty_cells.size());
+        empty_cells.emplace_back(x, y);
+      }
+    }
+  }
+  int last_cell_index = node.move_x < 0
+                            ? -1
+                            : node.move_x * board_size + node.move_y;
   // Continue simulation until a winner is detected
-  while (board.check_winner() == Cell_state::Empty) {
+  while (playout_board.check_winner() == Cell_state::Empty) {
     // Switch player
-    current_player = (current_player == Cell_state::Blue) ? Cell_state::Red
-                                                          : Cell_state::Blue;
-    // Get valid moves
-    std::vector<std::pair<int, int>> valid_moves = board.get_valid_moves();
-    // Generate a distribution and choose a move randomly
-    std::uniform_int_distribution<> distribution(
-        0, static_cast<int>(valid_moves.size() - 1));
-    std::pair<int, int> random_move =
-        valid_moves[distribution(random_generator)];
-    logger->log_simulation_step(current_player, board, random_move);
-    board.make_move(random_move.first, random_move.second, current_player);
+    current_player = get_opponent(current_player);
+    std::uint32_t move_index = 0;
+    std::uint8_t responses = 0;
+    if (last_cell_index >= 0) {
+      responses = patterns.get_responses(
+          current_player,
+          patterns.get_pattern(scratch.cell_states.data(), last_cell_index));
+    }
+    if (responses != 0) {
+      // Restore the intruded bridge, or a random one if the move intruded
+      // into several
+      std::uint32_t skipped_count = 0;
+      if ((responses & (responses - 1)) != 0) {
+        skipped_count = generator.bounded(static_cast<std::uint32_t>(
+            std::bitset<Hex_adjacency::direction_count>(responses).count()));
+      }
+      int direction = 0;
+      while ((responses >> direction & 1) == 0 || skipped_count-- != 0) {
+        ++direction;
+      }
+      move_index = static_cast<std::uint32_t>(
+          scratch.empty_cell_positions[adjacency.get_neighbours(
+              last_cell_index)[direction]]);
+    } else {
+      move_index =
+          generator.bounded(static_cast<std::uint32_t>(empty_cells.size()));
+    }
+    // Swap the last empty cell into the place of the move
+    const std::pair<int, int> move = empty_cells[move_index];
+    empty_cells[move_index] = empty_cells.back();
+    scratch.empty_cell_positions[empty_cells[move_index].first * board_size +
+                                 empty_cells[move_index].second] =
+        static_cast<std::int16_t>(move_index);
+    empty_cells.pop_back();
+    last_cell_index = move.first * board_size + move.second;
+    scratch.cell_states[last_cell_index] =
+        static_cast<std::uint8_t>(current_player);
+    if (verbose) {
+      logger->log_simulation_step(current_player, playout_board, move);
+    }
+    playout_board.make_move(move.first, move.second, current_player);
     // If a player has won, break the loop
-    if (board.check_winner() != Cell_state::Empty) {
-      logger->log_simulation_end(current_player, board);
+    if (playout_board.check_winner() != Cell_state::Empty) {
+      if (verbose) {
+        logger->log_simulation_end(current_player, playout_board);
+      }
       break;
     }
   }
   return current_player;
 }
 
-std::vector<Cell_state> Mcts_agent::parallel_playout(
-    std::shared_ptr<Node> node, const Board& board,
-    unsigned int number_of_threads) {
-  // Create a vector of threads and a vector to store the results
-  std::vector<std::thread> threads;
-  std::vector<Cell_state> results(number_of_threads);
-  // Start the threads and put their separate results into a vector
-  for (unsigned int thread_index = 0; thread_index < number_of_threads;
-       thread_index++) {
-    threads.push_back(std::thread([&, thread_index]() {
-      results[thread_index] = simulate_random_playout(node, board);
-    }));
-  }
-  // Join the threads
-  for (auto& thread : threads) {
-    thread.join();
-  }
-  return results;
-}
-
-void Mcts_agent::backpropagate(std::shared_ptr<Node>& node, Cell_state winner) {
-  // Start backpropagation from the given node
-  std::shared_ptr<Node> current_node = node;
-  while (current_node != nullptr) {
-    // Lock the node's mutex before updating its data
-    std::lock_guard<std::mutex> lock(current_node->node_mutex);
-    // Increment the node's visit count
-    current_node->visit_count += 1;
-    // If the winner is the same as the player at the node, increment the node's
-    // win count
-    if (winner == current_node->player) {
-      current_node->win_count += 1;
-    }
-    logger->log_backpropagation_result(
-        current_node->move, current_node->win_count, current_node->visit_count);
-    // Move to the parent node for the next iteration
-    current_node = current_node->parent_node;
-  }
-}
-
-std::shared_ptr<Mcts_agent::Node> Mcts_agent::select_best_child() {
-  double max_win_ratio = -1.;
-  std::shared_ptr<Node> best_child;
+template <bool verbose>
+void Mcts_agent::backpropagate(const Search_path& path, Cell_state winner,
+                               const Board& final_board) {
+  // Start backpropagation from the last node of the path and move up to the
+  // root along the path, since a node may have several parents
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    const std::uint32_t node_index = *it;
+    const Node& current_node = node_pool[node_index];
+    if (rave_equivalence > 0. &&
+        Node::has_children(
+            current_node.expansion_state.load(std::memory_order_acquire))) {
+      // Credit every move the players made after this node as if it had been
+      // made right away
+      const std::uint32_t child_count =
+          current_node.child_count.load(std::memory_order_acquire);
+      std::uint32_t child_index =
+          current_node.first_child_index.load(std::memory_order_acquire);
+      for (std::uint32_t i = 0; i < child_count;
+           child_index = get_next_child_index(child_index, i++)) {
+        const Node& child = node_pool[child_index];
+        if (final_board.get_cell_state(child.move_x, child.move_y) ==
+            child.player) {
+          node_amaf_statistics[child_index].fetch_add(
+              Node::one_visit + (winner == child.player),
+              std::memory_order_relaxed);
+        }
+      }
+    }
+    // The visit was already counted as a virtual loss when the node was
+    // selected. If the winner is the same as the player at the node, turn it
+    // into a win by incrementing the node's win count
+    if (winner == current_node.player) {
+      node_statistics[node_index].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (verbose) {
+      std::uint64_t statistics = node_statistics[node_index].load();
+      logger->log_backpropagation_result(current_node.get_move(),
+                                         Node::get_win_count(statistics),
+                                         Node::get_visit_count(statistics));
+    }
+  }
+}
+
+std::uint32_t Mcts_agent::find_reusable_subtree(const Board& board,
+                                               Cell_state player) const {
+  if (!root_board || root_board->get_board_size() != board.get_board_size()) {
+    return Node_pool<Node>::null_index;
+  }
+  // Every stone of the previous root position must still be on the board.
+  // Count the stones that were placed since then.
+  int board_size = board.get_board_size();
+  int new_stone_count = 0;
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      Cell_state previous_state = root_board->get_cell_state(x, y);
+      Cell_state current_state = board.get_cell_state(x, y);
+      if (previous_state == Cell_state::Empty) {
+        new_stone_count += (current_state != Cell_state::Empty);
+      } else if (previous_state != current_state) {
+        return Node_pool<Node>::null_index;
+      }
+    }
+  }
+  // Follow the new stones down the tree. At every level, the child that
+  // matches a new stone of the player to move at that level is taken. The
+  // moves on the path are already on the board, so no stone is used twice.
+  std::uint32_t node_index = root_index;
+  for (int depth = 0; depth < new_stone_count; ++depth) {
+    const Node& node = node_pool[node_index];
+    if (!Node::has_children(node.expansion_state.load())) {
+      return Node_pool<Node>::null_index;
+    }
+    Cell_state mover = get_opponent(node.player);
+    std::uint32_t next_index = Node_pool<Node>::null_index;
+    std::uint32_t child_index = node.first_child_index;
+    for (std::uint32_t i = 0; i < node.child_count;
+         child_index = get_next_child_index(child_index, i++)) {
+      const Node& child = node_pool[child_index];
+      if (board.get_cell_state(child.move_x, child.move_y) == mover &&
+          root_board->get_cell_state(child.move_x, child.move_y) ==
+              Cell_state::Empty) {
+        next_index = child_index;
+        break;
+      }
+    }
+    if (next_index == Node_pool<Node>::null_index) {
+      return Node_pool<Node>::null_index;
+    }
+    node_index = next_index;
+  }
+  // The subtree is only valid if the same player is to move
+  if (get_opponent(node_pool[node_index].player) != player) {
+    return Node_pool<Node>::null_index;
+  }
+  return node_index;
+}
+
+void Mcts_agent::promote_subtree(std::uint32_t subtree_index,
+                                 const Board& board) {
+  // The contents of a node that is moved to the front of the pool
+  struct Node_copy {
+    std::uint64_t statistics;
+    std::uint64_t amaf_statistics;
+    std::uint64_t hash;
+    std::uint32_t first_child_index;
+    std::uint16_t child_count;
+    std::uint16_t move_count;
+    Cell_state player;
+    std::pair<int, int> move;
+    bool is_expanded;
+  };
+  // Copy the subtree out of the pool in breadth-first order. The children of
+  // a node stay contiguous because they are visited one after the other. A
+  // block shared by several nodes is only copied when it is first reached.
+  // Nodes that share a block may hold different numbers of its children, so
+  // a block is identified by its first child and its count. The hash and the
+  // number of moves of every game state are derived from its parent's.
+  std::vector<std::uint32_t> old_indices(1, subtree_index);
+  std::vector<std::uint64_t> hashes(1, board.get_hash());
+  std::vector<std::uint16_t> move_counts(
+      1, static_cast<std::uint16_t>(board.get_empty_cell_count()));
+  // The room to leave after every copied node, which is the rest of the
+  // chunks of its block if it is the last child of the block
+  std::vector<std::uint16_t> paddings(1, 0);
+  std::unordered_map<std::uint64_t, std::uint32_t> new_first_child_indices;
+  std::vector<Node_copy> copies;
+  for (std::uint32_t new_index = 0; new_index < old_indices.size();
+       ++new_index) {
+    const std::uint32_t old_index = old_indices[new_index];
+    const Node& node = node_pool[old_index];
+    Node_copy copy;
+    copy.statistics =
+        node_statistics[old_index].load(std::memory_order_relaxed);
+    copy.amaf_statistics =
+        node_amaf_statistics[old_index].load(std::memory_order_relaxed);
+    copy.hash = hashes[new_index];
+    copy.first_child_index = Node_pool<Node>::null_index;
+    copy.child_count = 0;
+    copy.move_count = move_counts[new_index];
+    copy.player = node.player;
+    copy.move = node.get_move();
+    copy.is_expanded = Node::has_children(
+        node.expansion_state.load(std::memory_order_relaxed));
+    if (copy.is_expanded) {
+      copy.child_count = node.child_count.load(std::memory_order_relaxed);
+      const std::uint32_t first_child_index =
+          node.first_child_index.load(std::memory_order_relaxed);
+      const std::uint64_t block_key =
+          first_child_index |
+          static_cast<std::uint64_t>(copy.child_count) << 32;
+      auto copied_block = new_first_child_indices.find(block_key);
+      if (copied_block != new_first_child_indices.end()) {
+        // Only the node that reached the block first may add children to
+        // it, so a node that shares an incomplete block is expanded again
+        copy.first_child_index = copied_block->second;
+        copy.is_expanded = copy.child_count == copy.move_count;
+      } else {
+        copy.first_child_index = static_cast<std::uint32_t>(old_indices.size());
+        new_first_child_indices.emplace(block_key, copy.first_child_index);
+        std::uint32_t child_index = first_child_index;
+        for (std::uint32_t i = 0; i < copy.child_count;
+             child_index = get_next_child_index(child_index, i++)) {
+          const Node& child = node_pool[child_index];
+          old_indices.push_back(child_index);
+          hashes.push_back(copy.hash ^ Board::get_zobrist_key(child.move_x,
+                                                              child.move_y,
+                                                              child.player));
+          move_counts.push_back(
+              static_cast<std::uint16_t>(copy.move_count - 1));
+          paddings.push_back(0);
+        }
+        if (copy.child_count != 0) {
+          paddings.back() = static_cast<std::uint16_t>(
+              get_chunk_end(copy.child_count, copy.move_count) -
+              copy.child_count);
+        }
+      }
+    }
+    copies.push_back(copy);
+  }
+  // Lay the copies out in the same order, with the rest of the last chunk of
+  // every block left free, so that every block is a run of consecutive
+  // chunks. The subtree took at least as much room before.
+  std::vector<std::uint32_t> new_indices(copies.size());
+  std::uint32_t node_count = 0;
+  for (std::size_t i = 0; i < copies.size(); ++i) {
+    new_indices[i] = node_count;
+    node_count += 1 + paddings[i];
+  }
+  // Release the rest of the previous tree and write the subtree back
+  node_pool.clear();
+  if (transposition_table) {
+    transposition_table->clear();
+  }
+  node_pool.allocate(node_count);
+  tree_node_count.store(static_cast<std::uint32_t>(copies.size()),
+                        std::memory_order_relaxed);
+  for (std::size_t i = 0; i < copies.size(); ++i) {
+    const Node_copy& copy = copies[i];
+    const std::uint32_t new_index = new_indices[i];
+    Node& node = node_pool[new_index];
+    node.initialize(copy.player, copy.move);
+    node_statistics[new_index].store(copy.statistics,
+                                     std::memory_order_relaxed);
+    node_amaf_statistics[new_index].store(copy.amaf_statistics,
+                                          std::memory_order_relaxed);
+    if (copy.is_expanded) {
+      const std::uint32_t first_child_index =
+          new_indices[copy.first_child_index];
+      const std::uint32_t capacity =
+          get_chunk_end(copy.child_count, copy.move_count);
+      for (std::uint32_t chunk_start = 0; chunk_start < capacity;
+           chunk_start = 2 * chunk_start + 1) {
+        const std::uint32_t next_chunk_start = 2 * chunk_start + 1;
+        node_pool[first_child_index + chunk_start].next_chunk_index.store(
+            next_chunk_start < capacity ? first_child_index + next_chunk_start
+                                        : Node_pool<Node>::null_index,
+            std::memory_order_relaxed);
+      }
+      node.first_child_index.store(first_child_index,
+                                   std::memory_order_relaxed);
+      node.child_count.store(copy.child_count, std::memory_order_relaxed);
+      node.child_capacity = static_cast<std::uint16_t>(capacity);
+      node.expansion_state.store(Node::Expanded, std::memory_order_relaxed);
+      if (transposition_table && copy.child_count == copy.move_count) {
+        transposition_table->store(copy.hash, first_child_index,
+                                   copy.child_count);
+      }
+    }
+  }
+  root_index = 0;
+}
+
+void Mcts_agent::save_tree(const std::string& path,
+                           unsigned int max_expanded_children) {
+  stop_pondering();
+  if (!root_agents.empty()) {
+    throw std::logic_error("Private trees cannot be saved.");
+  }
+  if (!root_board) {
+    throw std::logic_error("The agent has no tree to save yet.");
+  }
+  // Copy the tree into records in breadth-first order, like
+  // promote_subtree(), so that the children of a node stay contiguous and a
+  // shared block is only copied when it is first reached
+  std::vector<std::uint32_t> old_indices(1, root_index);
+  // Whether the subtree of the node of every record is written
+  std::vector<bool> is_subtree_kept(1, true);
+  std::unordered_map<std::uint64_t, std::uint32_t> new_first_child_indices;
+  std::vector<Tree_file_node> records;
+  std::vector<std::uint32_t> ranked_offsets;
+  for (std::uint32_t new_index = 0; new_index < old_indices.size();
+       ++new_index) {
+    const std::uint32_t old_index = old_indices[new_index];
+    const Node& node = node_pool[old_index];
+    Tree_file_node record = Tree_file_node();
+    record.statistics =
+        node_statistics[old_index].load(std::memory_order_relaxed);
+    record.amaf_statistics =
+        node_amaf_statistics[old_index].load(std::memory_order_relaxed);
+    record.move_x = node.move_x;
+    record.move_y = node.move_y;
+    if (is_subtree_kept[new_index] &&
+        Node::has_children(
+            node.expansion_state.load(std::memory_order_relaxed))) {
+      record.child_count = node.child_count.load(std::memory_order_relaxed);
+      const std::uint32_t first_child_index =
+          node.first_child_index.load(std::memory_order_relaxed);
+      const std::uint64_t block_key =
+          first_child_index |
+          static_cast<std::uint64_t>(record.child_count) << 32;
+      auto copied_block = new_first_child_indices.find(block_key);
+      if (copied_block != new_first_child_indices.end()) {
+        record.first_child_index = copied_block->second;
+      } else {
+        record.first_child_index =
+            static_cast<std::uint32_t>(old_indices.size());
+        new_first_child_indices.emplace(block_key, record.first_child_index);
+        std::uint32_t kept_count = record.child_count;
+        if (max_expanded_children != 0 && max_expanded_children < kept_count) {
+          kept_count = max_expanded_children;
+        }
+        const std::size_t first_new_child = old_indices.size();
+        std::uint32_t child_index = first_child_index;
+        for (std::uint32_t i = 0; i < record.child_count;
+             child_index = get_next_child_index(child_index, i++)) {
+          old_indices.push_back(child_index);
+          is_subtree_kept.push_back(kept_count == record.child_count);
+        }
+        if (kept_count < record.child_count) {
+          // Rank the children by their visits to keep the subtrees of the
+          // most visited ones
+          const std::uint32_t* child_indices = &old_indices[first_new_child];
+          ranked_offsets.resize(record.child_count);
+          for (std::uint32_t i = 0; i < record.child_count; ++i) {
+            ranked_offsets[i] = i;
+          }
+          std::partial_sort(
+              ranked_offsets.begin(), ranked_offsets.begin() + kept_count,
+              ranked_offsets.end(),
+              [this, child_indices](std::uint32_t first,
+                                    std::uint32_t second) {
+                return node_statistics[child_indices[first]].load(
+                           std::memory_order_relaxed) >
+                       node_statistics[child_indices[second]].load(
+                           std::memory_order_relaxed);
+              });
+          for (std::uint32_t i = 0; i < kept_count; ++i) {
+            is_subtree_kept[first_new_child + ranked_offsets[i]] = true;
+          }
+        }
+      }
+    }
+    records.push_back(record);
+  }
+
+  Tree_file_header header = Tree_file_header();
+  std::memcpy(header.magic, tree_magic, sizeof(tree_magic));
+  header.byte_order = tree_byte_order_mark;
+  header.version = tree_version;
+  header.node_size = sizeof(Tree_file_node);
+  header.node_count = static_cast<std::uint32_t>(records.size());
+  header.board_size = static_cast<std::uint8_t>(root_board->get_board_size());
+  header.root_player = static_cast<std::uint8_t>(node_pool[root_index].player);
+  std::vector<std::uint8_t> cells(
+      get_padded_cell_count(root_board->get_board_size()), 0);
+  for (int x = 0; x < header.board_size; ++x) {
+    for (int y = 0; y < header.board_size; ++y) {
+      cells[x * header.board_size + y] =
+          static_cast<std::uint8_t>(root_board->get_cell_state(x, y));
+    }
+  }
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(cells.data()),
+             static_cast<std::streamsize>(cells.size()));
+  file.write(reinterpret_cast<const char*>(records.data()),
+             static_cast<std::streamsize>(records.size() *
+                                          sizeof(Tree_file_node)));
+  file.close();
+  if (!file) {
+    throw std::runtime_error("Cannot write the tree to " + path + ".");
+  }
+}
+
+void Mcts_agent::load_tree(const std::string& path) {
+  stop_pondering();
+  if (!root_agents.empty()) {
+    throw std::logic_error("Private trees cannot be loaded.");
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open the tree " + path + ".");
+  }
+  Tree_file_header header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || std::memcmp(header.magic, tree_magic, sizeof(tree_magic)) != 0 ||
+      header.board_size < 2 || header.board_size > Board::max_board_size ||
+      header.node_count == 0 ||
+      (header.root_player != static_cast<std::uint8_t>(Cell_state::Blue) &&
+       header.root_player != static_cast<std::uint8_t>(Cell_state::Red))) {
+    throw std::runtime_error(path + " is not a search tree.");
+  }
+  if (header.byte_order != tree_byte_order_mark) {
+    throw std::runtime_error(path +
+                             " was written on a machine with another byte "
+                             "order.");
+  }
+  if (header.version != tree_version ||
+      header.node_size != sizeof(Tree_file_node)) {
+    throw std::runtime_error(path + " is a tree of another version.");
+  }
+  if (header.node_count > node_pool.get_capacity()) {
+    throw std::runtime_error("The tree in " + path +
+                             " has more nodes than the agent may hold.");
+  }
+  const int board_size = header.board_size;
+  std::vector<std::uint8_t> cells(get_padded_cell_count(board_size));
+  file.read(reinterpret_cast<char*>(cells.data()),
+            static_cast<std::streamsize>(cells.size()));
+  std::vector<Tree_file_node> records(header.node_count);
+  file.read(reinterpret_cast<char*>(records.data()),
+            static_cast<std::streamsize>(records.size() *
+                                         sizeof(Tree_file_node)));
+  if (!file) {
+    throw std::runtime_error("The tree in " + path + " is truncated.");
+  }
+  Board board(board_size);
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      std::uint8_t cell = cells[x * board_size + y];
+      if (cell > static_cast<std::uint8_t>(Cell_state::Red)) {
+        throw std::runtime_error(path + " is not a search tree.");
+      }
+      if (cell != static_cast<std::uint8_t>(Cell_state::Empty)) {
+        board.make_move(x, y, static_cast<Cell_state>(cell));
+      }
+    }
+  }
+  if (file.peek() != std::ifstream::traits_type::eof()) {
+    throw std::runtime_error(path + " is not a search tree.");
+  }
+  // Derive the player, the hash of the game state and the depth of every node
+  // from the node that first reaches it, which precedes it in breadth-first
+  // order. A block of children that the transposition table shares among
+  // several parents must be reached at the same depth with the same game
+  // state from all of them, which also rules out cycles
+  std::vector<Cell_state> players(records.size(), Cell_state::Empty);
+  std::vector<std::uint64_t> hashes(records.size(), 0);
+  std::vector<int> depths(records.size(), -1);
+  std::vector<std::uint32_t> parents(records.size(), 0);
+  players[0] = static_cast<Cell_state>(header.root_player);
+  hashes[0] = board.get_hash();
+  depths[0] = 0;
+  const int empty_cell_count = board.get_empty_cell_count();
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    const Tree_file_node& record = records[i];
+    if (players[i] == Cell_state::Empty ||
+        (record.child_count != 0 &&
+         (static_cast<std::uint64_t>(record.first_child_index) +
+                  record.child_count >
+              records.size() ||
+          record.child_count > empty_cell_count - depths[i]))) {
+      throw std::runtime_error(path + " is not a search tree.");
+    }
+    for (std::uint32_t j = record.first_child_index;
+         j < record.first_child_index + record.child_count; ++j) {
+      const int move_x = records[j].move_x;
+      const int move_y = records[j].move_y;
+      if (move_x < 0 || move_x >= board_size || move_y < 0 ||
+          move_y >= board_size ||
+          board.get_cell_state(move_x, move_y) != Cell_state::Empty) {
+        throw std::runtime_error(path + " is not a search tree.");
+      }
+      const Cell_state player = get_opponent(players[i]);
+      const std::uint64_t hash =
+          hashes[i] ^ Board::get_zobrist_key(move_x, move_y, player);
+      if (players[j] != Cell_state::Empty) {
+        if (depths[j] != depths[i] + 1 || players[j] != player ||
+            hashes[j] != hash) {
+          throw std::runtime_error(path + " is not a search tree.");
+        }
+        continue;
+      }
+      // Replay the path to the parent, whose moves must all differ
+      for (std::uint32_t ancestor = static_cast<std::uint32_t>(i);
+           ancestor != 0; ancestor = parents[ancestor]) {
+        if (records[ancestor].move_x == move_x &&
+            records[ancestor].move_y == move_y) {
+          throw std::runtime_error(path + " is not a search tree.");
+        }
+      }
+      players[j] = player;
+      hashes[j] = hash;
+      depths[j] = depths[i] + 1;
+      parents[j] = static_cast<std::uint32_t>(i);
+    }
+  }
+  // The tree must also fit with the rest of the last chunk of every block,
+  // which promote_subtree() leaves free
+  std::uint64_t laid_out_node_count = header.node_count;
+  std::unordered_set<std::uint64_t> blocks;
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    const Tree_file_node& record = records[i];
+    if (record.child_count != 0 &&
+        blocks
+            .insert(record.first_child_index |
+                    static_cast<std::uint64_t>(record.child_count) << 32)
+            .second) {
+      laid_out_node_count +=
+          get_chunk_end(record.child_count,
+                        static_cast<std::uint32_t>(empty_cell_count -
+                                                   depths[i])) -
+          record.child_count;
+    }
+  }
+  if (laid_out_node_count > node_pool.get_capacity()) {
+    throw std::runtime_error("The tree in " + path +
+                             " has more nodes than the agent may hold.");
+  }
+
+  // Replace the tree as it is stored, and let promote_subtree() lay it out
+  // with room for the children that the search adds and fill the
+  // transposition table. The blocks of the file are runs of consecutive
+  // chunks.
+  std::lock_guard<std::mutex> lock(root_mutex);
+  node_pool.clear();
+  if (transposition_table) {
+    transposition_table->clear();
+  }
+  node_pool.allocate(header.node_count);
+  for (std::uint32_t index = 0; index < header.node_count; ++index) {
+    const Tree_file_node& record = records[index];
+    Node& node = node_pool[index];
+    node.initialize(players[index],
+                    std::make_pair(record.move_x, record.move_y));
+    node_statistics[index].store(record.statistics, std::memory_order_relaxed);
+    node_amaf_statistics[index].store(record.amaf_statistics,
+                                      std::memory_order_relaxed);
+    if (record.child_count != 0) {
+      for (std::uint32_t chunk_start = 0; chunk_start < record.child_count;
+           chunk_start = 2 * chunk_start + 1) {
+        node_pool[record.first_child_index + chunk_start]
+            .next_chunk_index.store(
+                2 * chunk_start + 1 < record.child_count
+                    ? record.first_child_index + 2 * chunk_start + 1
+                    : Node_pool<Node>::null_index,
+                std::memory_order_relaxed);
+      }
+      node.first_child_index.store(record.first_child_index,
+                                   std::memory_order_relaxed);
+      node.child_count.store(record.child_count, std::memory_order_relaxed);
+      node.child_capacity = record.child_count;
+      node.expansion_state.store(Node::Expanded, std::memory_order_relaxed);
+    }
+  }
+  promote_subtree(0, board);
+  root_board = std::make_unique<Board>(board);
+}
+
+std::uint32_t Mcts_agent::select_best_child() {
+  double max_score = -1.;
+  std::uint32_t best_child_index = Node_pool<Node>::null_index;
+  const Node& root = node_pool[root_index];
   // iterate over the child nodes of the root node to find the one with the
-  // highest win ratio
-  for (const auto& child : root->child_nodes) {
-    double win_ratio =
-        static_cast<double>(child->win_count) / child->visit_count;
+  // highest win ratio. With RAVE, many children are visited only a few times,
+  // so a lucky win ratio is likely and the most visited child is taken.
+  std::uint32_t child_index = root.first_child_index;
+  for (std::uint32_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    const Node& child = node_pool[child_index];
+    std::uint64_t statistics = node_statistics[child_index].load();
+    int win_count = Node::get_win_count(statistics);
+    int visit_count = Node::get_visit_count(statistics);
+    double score = rave_equivalence > 0.
+                       ? visit_count
+                       : static_cast<double>(win_count) / visit_count;
     // If verbose mode is on, print the win ratio for each child node.
-    logger->log_node_win_ratio(child->move, child->win_count,
-                               child->visit_count);
-    if (win_ratio > max_win_ratio) {
-      max_win_ratio = win_ratio;
-      best_child = child;
+    if (is_logging()) {
+      logger->log_node_win_ratio(child.get_move(), win_count, visit_count);
+    }
+    if (score > max_score) {
+      max_score = score;
+      best_child_index = child_index;
     }
   }
-  if (!best_child) {
+  if (best_child_index == Node_pool<Node>::null_index) {
+    // A search that is cancelled before its first playout has no statistics
+    // yet, so the first move in the order of get_child_moves() stands in
+    if (is_stop_requested.load() && root.child_count != 0) {
+      return root.first_child_index;
+    }
     throw std::runtime_error(
         "Statistics are not sufficient to choose a move. You likely gave the "
         "robot too little time for the given board size.");
   }
-  return best_child;
-}
\ No newline at end of file
+  return best_child_index;
+}
+
+bool Mcts_agent::check_best_move_settled(
+    int iteration_count, int max_iterations,
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& end_time,
+    const std::chrono::time_point<std::chrono::high_resolution_clock>& now)
+    const {
+  // Estimate how many more iterations the budget allows
+  double remaining_iterations = std::numeric_limits<double>::infinity();
+  if (max_iterations != 0) {
+    remaining_iterations = max_iterations - iteration_count;
+  }
+  if (end_time != std::chrono::high_resolution_clock::time_point::max()) {
+    std::chrono::duration<double> elapsed_time = now - search_start_time;
+    if (iteration_count == 0 || elapsed_time.count() <= 0.) {
+      return false;
+    }
+    std::chrono::duration<double> remaining_time = end_time - now;
+    remaining_iterations =
+        std::min(remaining_iterations, iteration_count *
+                                           remaining_time.count() /
+                                           elapsed_time.count());
+  }
+  if (remaining_iterations == std::numeric_limits<double>::infinity()) {
+    return false;
+  }
+  // Find the child that select_best_child() would choose, and the two most
+  // visited children
+  const Node& root = node_pool[root_index];
+  std::uint32_t best_index = Node_pool<Node>::null_index;
+  std::uint32_t most_visited_index = Node_pool<Node>::null_index;
+  double best_score = -1.;
+  int most_visits = 0;
+  int runner_up_visits = 0;
+  std::uint32_t child_index = root.first_child_index;
+  for (std::uint32_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    std::uint64_t statistics =
+        node_statistics[child_index].load(std::memory_order_relaxed);
+    int visit_count = Node::get_visit_count(statistics);
+    if (visit_count == 0) {
+      continue;
+    }
+    double score = rave_equivalence > 0.
+                       ? visit_count
+                       : static_cast<double>(Node::get_win_count(statistics)) /
+                             visit_count;
+    if (score > best_score) {
+      best_score = score;
+      best_index = child_index;
+    }
+    if (visit_count > most_visits) {
+      runner_up_visits = most_visits;
+      most_visits = visit_count;
+      most_visited_index = child_index;
+    } else if (visit_count > runner_up_visits) {
+      runner_up_visits = visit_count;
+    }
+  }
+  if (best_index == Node_pool<Node>::null_index) {
+    return false;
+  }
+  // The runner-up cannot catch up in visits with the rest of the budget. This
+  // only settles the move if select_best_child() chooses by visits, since a
+  // less visited child may still overtake the best one on the win ratio.
+  if (rave_equivalence > 0. && best_index == most_visited_index &&
+      most_visits - runner_up_visits > remaining_iterations) {
+    return true;
+  }
+  // Hoeffding's inequality bounds every win ratio within half_width(n) of its
+  // expected value, except with the error probability
+  const double log_inverse_error = std::log(1. / early_stop_error_probability);
+  auto half_width = [log_inverse_error](int visit_count) {
+    return std::sqrt(log_inverse_error / (2. * visit_count));
+  };
+  std::uint64_t best_statistics =
+      node_statistics[best_index].load(std::memory_order_relaxed);
+  const int best_visit_count = Node::get_visit_count(best_statistics);
+  const double best_lower_bound =
+      static_cast<double>(Node::get_win_count(best_statistics)) /
+          best_visit_count -
+      half_width(best_visit_count);
+  child_index = root.first_child_index;
+  for (std::uint32_t i = 0; i < root.child_count;
+       child_index = get_next_child_index(child_index, i++)) {
+    if (child_index == best_index) {
+      continue;
+    }
+    std::uint64_t statistics =
+        node_statistics[child_index].load(std::memory_order_relaxed);
+    int visit_count = Node::get_visit_count(statistics);
+    if (visit_count == 0) {
+      return false;
+    }
+    double win_ratio =
+        static_cast<double>(Node::get_win_count(statistics)) / visit_count;
+    if (win_ratio + half_width(visit_count) >= best_lower_bound) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Instantiated for benchmark.cpp, which measures single playouts
+template Cell_state Mcts_agent::simulate_random_playout<false>(
+    const Node& node, const Board& board, Playout_scratch& scratch,
+    Xoshiro_generator& generator);
+template Cell_state Mcts_agent::simulate_filled_playout<false>(
+    const Node& node, const Board& board, Playout_scratch& scratch,
+    Xoshiro_generator& generator);
+template Cell_state Mcts_agent::simulate_bridge_playout<false>(
+    const Node& node, const Board& board, Playout_scratch& scratch,
+    Xoshiro_generator& generator);
@@ -1,14 +1,34 @@
 #ifndef MCTS_AGENT_H
 #define MCTS_AGENT_H
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
 #include <memory>
 #include <mutex>
-#include <random>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "board.h"
+#include "cluster_link.h"
+#include "evaluation_queue.h"
+#include "leaf_evaluator.h"
 #include "logger.h"
+#include "node_pool.h"
+#include "parallel_mode.h"
+#include "playout_mode.h"
+#include "playout_patterns.h"
+#include "search_limits.h"
+#include "search_statistics.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+#include "xoshiro_generator.h"
 
 /**
  * @class Mcts_agent
@@ -17,13 +37,21 @@
  * moves in a game.
  *
  * The `Mcts_agent` class uses MCTS to simulate game play and choose the best
- * move for a given game state. It supports optional parallelization for
+ * move for a given game state. It supports optional tree parallelization for
  * increased performance, and offers optional verbosity for logging purposes.
  *
- * MCTS works by simulating the game from the current state to a terminal state,
- * then updating the statistics of each visited node based on the outcome. This
- * is done repeatedly until a pre-set time limit is reached. The agent then
- * chooses the move that leads to the node with the highest win ratio.
+ * MCTS works by descending the search tree from the current state along the
+ * most promising moves, expanding the leaf that is reached, simulating the game
+ * from there to a terminal state, and then updating the statistics of each node
+ * on the path based on the outcome. This is done repeatedly until a pre-set
+ * time limit is reached, so the tree grows deeper with more time. The agent
+ * then chooses the move that leads to the root child with the highest win
+ * ratio.
+ *
+ * With a transposition table, see Search_limits::transposition_table_entries,
+ * a leaf whose game state is already expanded elsewhere in the tree shares the
+ * children of that node instead of creating its own, which turns the tree into
+ * a directed acyclic graph.
  *
  * @note This class assumes a game interface with `Board` and `Cell_state` types
  * defined, and a `Logger` class for logging purposes. The `Board` class should
@@ -37,9 +65,22 @@
  * @param max_decision_time The maximum time in milliseconds that the agent can
  * use to make a decision.
  * @param is_parallelized Determines whether the MCTS iterations should be
- * parallelized.
+ * parallelized. If so, a pool of long-lived worker threads, one per hardware
+ * thread, runs complete iterations on the shared tree at the same time, using
+ * virtual loss to spread out over different branches, or grows one private
+ * tree per worker, depending on the parallel mode.
  * @param is_verbose If true, the agent logs more detailed information about its
  * decision-making process.
+ * @param playout_mode Selects how random playouts are simulated.
+ * @param rave_equivalence Enables Rapid Action Value Estimation (RAVE) if it is
+ * positive. Every playout then also counts for all moves that a player made
+ * after a node, as if each of them had been played first (All-Moves-As-First),
+ * and these statistics are blended into the UCT score.
+ * @param leaf_evaluator Replaces the random playouts if it is given. The
+ * workers then collect leaves into batches for the evaluator.
+ * @param cluster_link Lets agents on several machines search the same game
+ * state together if it is given, exchanging their root statistics while they
+ * search.
  *
  */
 class Mcts_agent {
@@ -49,19 +90,76 @@ class Mcts_agent {
    *
    * @param exploration_factor Determines the constant of exploration in
    * the UCT formula.
-   * @param max_decision_time Maximum time allowed for making a decision
-   * in milliseconds.
-   * @param is_parallelized Determines if playouts are performed in parallel.
-   * Sufficient time has to be given for this to be effective.
+   * @param search_limits Determines when the search for a move stops, e.g.
+   * after a maximum time in milliseconds, which converts to Search_limits.
+   * If a maximum number of tree nodes is given, the tree never grows beyond
+   * it.
+   * @param is_parallelized Determines if iterations are performed in parallel
+   * by a thread pool owned by the agent.
    * @param is_verbose If true, enables detailed logging to the console
    * using the Logger class.
+   * @param playout_mode Selects between checking for a winner after every
+   * playout move, filling the board before checking once, and answering
+   * bridge intrusions in the playouts.
+   * @param random_seed The seed of the agent's random number generator, which
+   * also seeds the generators of the workers. Agents with the same nonzero
+   * seed draw the same random numbers. If it is 0, a seed is taken from
+   * std::random_device.
+   * @param rave_equivalence The number of visits of a node at which its own
+   * statistics and its AMAF statistics weigh the same in the UCT score. The
+   * AMAF statistics dominate while a node has few visits, and fade out as it
+   * gets more. If it is 0, RAVE is disabled.
+   * @param leaf_evaluator Estimates the outcome at the leaves in place of the
+   * random playouts, which then ignores playout_mode. The leaves of all
+   * workers are collected and handed to the evaluator in batches, and the
+   * result of every leaf is drawn from the estimated win probability. If it
+   * is nullptr, the agent simulates random playouts, the same way as
+   * Random_playout_evaluator does.
+   * @param worker_count The number of worker threads in parallel mode, e.g. to
+   * share the cores among several agents that search at the same time. If it
+   * is 0, one worker per hardware thread is started.
+   * @param parallel_mode Selects whether the workers share one tree or grow
+   * one each in parallel mode, and is ignored otherwise. With Root_trees,
+   * every worker owns a private agent that searches serially, and the limits
+   * on the iterations, the tree nodes and the transposition table entries
+   * are divided among them.
+   * @param cluster_link Spreads every choose_move() over the machines of a
+   * cluster if it is given. Each machine searches with its own limits, and
+   * every sync interval, a background thread sends the visit and win counts
+   * that the local search added to the root children to the other machines
+   * and adds theirs. The counts of the other machines enter the root
+   * children right away, so they steer the local search, or, with private
+   * trees, when the trees are merged. Once all machines have finished, all
+   * of them hold the same counts and choose the same move. Pondering stays
+   * local.
    *
    * @throws std::logic_error if is_parallelized and is_verbose are both true.
    * This is because the output would be garbled.
+   * @throws std::invalid_argument if neither a decision time nor a number of
+   * iterations is set, if a limit or the RAVE
+   * equivalence is negative, if the time check interval is not positive, if
+   * the widening factor is negative or the widening exponent is not from 0
+   * to 1, or if a leaf evaluator is combined with private trees.
+   */
+  Mcts_agent(double exploration_factor, const Search_limits& search_limits,
+             bool is_parallelized, bool is_verbose = false,
+             Playout_mode playout_mode = Playout_mode::Move_by_move,
+             std::uint64_t random_seed = 0, double rave_equivalence = 0.,
+             std::shared_ptr<Leaf_evaluator> leaf_evaluator = nullptr,
+             unsigned int worker_count = 0,
+             Parallel_mode parallel_mode = Parallel_mode::Shared_tree,
+             std::shared_ptr<Cluster_link> cluster_link = nullptr);
+
+  /**
+   * @brief Stops the background search, if any, before the tree and the
+   * worker threads are destroyed.
    */
-  Mcts_agent(double exploration_factor,
-             std::chrono::milliseconds max_decision_time, bool is_parallelized,
-             bool is_verbose = false);
+  ~Mcts_agent();
+
+  // Non-copyable and non-movable, since the background thread refers to the
+  // agent
+  Mcts_agent(const Mcts_agent&) = delete;
+  Mcts_agent& operator=(const Mcts_agent&) = delete;
 
   /**
    * Chooses the best move for a given game state using the Monte Carlo Tree
@@ -72,18 +170,25 @@ class Mcts_agent {
    * games starting at the current state, then uses the results of these
    * simulations to make a decision.
    *
-   * The function creates a new root node for the MCTS, then expands this node
-   * based on the current game state. It then enters a loop in which it selects
-   * a child node, simulates a game from this node, and backpropagates the
-   * result of the game back up the tree. This loop continues until the
-   * allocated decision-making time is exhausted.
+   * The function continues from the subtree of the previous search that
+   * matches the current game state if there is one, and creates a new root
+   * node for the MCTS otherwise. It then expands the root node based on the
+   * current game state. It then enters a loop in which it
+   * descends the tree to a leaf, expands the leaf, simulates a game from one of
+   * its children, and backpropagates the result of the game back up the tree.
+   * This loop continues until one of the search limits is reached, e.g. until
+   * the allocated decision-making time is exhausted.
    *
    * After the loop, the function chooses the child of the root node with the
    * highest win ratio as the best move. If verbose mode is active, it also
    * prints various statistics about the MCTS process using Logger.
    *
    * Note: The function can work in both a single-threaded and a multi-threaded
-   * mode. The latter is activated by setting `is_parallelized` to `true`.
+   * mode. The latter is activated by setting `is_parallelized` to `true`, in
+   * which case every worker of the thread pool performs iterations on the
+   * shared tree until the time runs out, or on a private tree with
+   * Parallel_mode::Root_trees. The counts of the children of the private
+   * roots are then summed before the best child is chosen.
    *
    * @param board The current game state.
    * @param player The player for whom the move is being chosen.
@@ -95,23 +200,327 @@ class Mcts_agent {
    */
   std::pair<int, int> choose_move(const Board& board, Cell_state player);
 
+  /**
+   * @brief Chooses the best move like choose_move(const Board&, Cell_state)
+   * and reports how the search went.
+   *
+   * The statistics are collected by every search, with counters of their own
+   * for every worker, so asking for them costs nothing extra during the
+   * search.
+   *
+   * @param board The current game state.
+   * @param player The player for whom the move is being chosen.
+   * @param statistics Receives the statistics of the search.
+   * @return The best move for the given player in the current game state.
+   * @throws runtime_error If the statistics are not sufficient to choose a
+   * move.
+   */
+  std::pair<int, int> choose_move(const Board& board, Cell_state player,
+                                  Search_statistics& statistics);
+
+  /**
+   * @brief Starts searching a game state in the background, typically the
+   * state after the agent's own move while the opponent is thinking.
+   *
+   * A background thread, together with the thread pool in parallel mode,
+   * runs MCTS iterations on the given state until stop_pondering() or
+   * choose_move() is called. The grown tree is kept, so when choose_move() is
+   * then called with the opponent's reply on the board, the search continues
+   * from the matching child instead of starting from nothing. Nothing happens
+   * if the game is already decided.
+   *
+   * @param board The game state to search. It is copied.
+   * @param player The player to move in the given game state.
+   * @throws std::logic_error If the agent is in verbose mode, since the log of
+   * the background search would be mixed with the rest of the output.
+   */
+  void start_pondering(const Board& board, Cell_state player);
+
+  /**
+   * @brief Stops the background search started by start_pondering() or
+   * start_choosing_move() and waits for it to finish. A move that is still
+   * being chosen is then the best one so far. Does nothing if there is no
+   * background search.
+   *
+   * @throws Any exception thrown by the background search.
+   */
+  void stop_pondering();
+
+  /**
+   * @brief Starts choosing a move in the background and returns right away,
+   * so that the caller is not blocked for the decision time.
+   *
+   * A background thread, together with the thread pool in parallel mode,
+   * searches the game state like choose_move() and then fulfils the
+   * returned future with the move. cancel_search() ends the search early,
+   * and get_search_progress() tells the best move so far. The agent must
+   * not be used otherwise until the future is ready, except that calling
+   * choose_move(), start_choosing_move(), start_pondering(), save_tree() or
+   * load_tree() cancels the search and waits for it first.
+   *
+   * @param board The current game state. It is copied.
+   * @param player The player for whom the move is being chosen.
+   * @param is_pondering If true, the background thread then searches the
+   * game state after the chosen move until the agent is used again, like
+   * start_pondering().
+   * @return The future of the move. It holds the exception instead if
+   * choose_move() would have thrown one.
+   * @throws std::logic_error If the agent is in verbose mode, since the log
+   * may only be written by one thread at a time.
+   */
+  std::future<std::pair<int, int>> start_choosing_move(
+      const Board& board, Cell_state player, bool is_pondering = false);
+
+  /**
+   * @brief Asks the running search to stop after its current iterations,
+   * without waiting for it. A search of choose_move() or
+   * start_choosing_move() then returns the best move so far, or the first
+   * move in the order of get_child_moves() if it has not finished a playout
+   * yet, and pondering stops. It is thread-safe and has no effect if no
+   * search is running.
+   */
+  void cancel_search();
+
+  /**
+   * @brief Returns the best move of the running search so far, or of the
+   * last search if none is running. It is thread-safe, so another thread
+   * can watch a search of start_choosing_move(), pondering or the search of
+   * a Search_scheduler.
+   *
+   * The counts are read one child at a time while the workers update them,
+   * so they are a snapshot per child rather than of the whole root. With
+   * Parallel_mode::Root_trees, the counts of the private trees are summed.
+   */
+  Search_progress get_search_progress() const;
+
+  /**
+   * @brief Writes the tree of the last search to a file, so that a later
+   * session can continue the search with load_tree() instead of growing the
+   * tree again.
+   *
+   * The file is flat and holds no pointers, like the node pool: a header,
+   * the game state of the root, and one record of 24 bytes per node in
+   * breadth-first order, in which the children of a node are contiguous and
+   * referred to by the position of the first one. A block of children that
+   * several game states share through the transposition table is written
+   * once. The records are written in one piece, in the byte order of the
+   * machine.
+   *
+   * Stops pondering first, if the agent is pondering.
+   *
+   * @param path The path of the file, which is replaced.
+   * @param max_expanded_children If positive, only the subtrees of the most
+   * visited children of every node are written, up to this number per node.
+   * The other children are written as unexpanded leaves that keep their
+   * counts, so every node keeps all its moves and the file stays small.
+   *
+   * @throws std::logic_error if the agent has not searched yet or grows
+   * private trees, whose counts are only merged at the root.
+   * @throws std::runtime_error if the file cannot be written.
+   */
+  void save_tree(const std::string& path,
+                 unsigned int max_expanded_children = 0);
+
+  /**
+   * @brief Replaces the tree with one written by save_tree(). The next
+   * choose_move() continues the search from it, or from its subtree that
+   * matches the game state, like with a tree kept from the previous move.
+   *
+   * The records are read in one piece and written into the node pool, and
+   * laid out by promote_subtree() with room for the children that the search
+   * adds. If the agent has a transposition table, it is filled with the
+   * loaded complete blocks of children. Before that, every record is checked
+   * against the game state it is reached with, so that a corrupt file is
+   * rejected instead of leaving moves into occupied cells, cycles or
+   * oversized blocks in the tree.
+   *
+   * Stops pondering first, if the agent is pondering.
+   *
+   * @param path The path of the file.
+   *
+   * @throws std::logic_error if the agent grows private trees.
+   * @throws std::runtime_error if the file cannot be read, is not a tree in
+   * the byte order of this machine, or holds more nodes than the tree may.
+   */
+  void load_tree(const std::string& path);
+
+  /**
+   * @brief Returns the number of heap allocations made inside playouts during
+   * the last search, summed over all workers.
+   *
+   * Playouts work on scratch buffers that every worker allocates once per
+   * search, so this is 0 unless something on the playout path allocates. It
+   * is only counted if the program is built with MCTS_HEX_COUNT_ALLOCATIONS,
+   * see allocation_counter.h, and is always 0 otherwise.
+   *
+   * @return The number of allocations made by playouts.
+   */
+  std::size_t get_playout_allocation_count() const;
+
+  /**
+   * @brief Returns the memory that one node of the tree occupies, including
+   * its statistics.
+   */
+  static std::size_t get_bytes_per_node();
+
  private:
+  // Measures the internals of the agent, see benchmark.cpp
+  friend struct Mcts_agent_benchmark;
+  // Searches moves in time slices, see begin_move()
+  friend class Search_scheduler;
+
   // Agent configuration parameters
   double exploration_factor;
-  std::chrono::milliseconds max_decision_time;
+  Search_limits search_limits;
   bool is_parallelized = false;
   bool is_verbose = false;
+  Playout_mode playout_mode = Playout_mode::Move_by_move;
+  double rave_equivalence = 0.;
 
   // For logging
   std::shared_ptr<Logger> logger;
 
-  // For random number generation
-  std::random_device random_device;
-  std::mt19937 random_generator;
+  // For random number generation. In parallel mode, it only seeds the
+  // generators of the workers.
+  Xoshiro_generator random_generator;
+
+  // The worker threads used in parallel mode, or nullptr
+  std::unique_ptr<Thread_pool> thread_pool;
+
+  // With Parallel_mode::Root_trees, the serial agents that grow the private
+  // trees, one per worker. The tree of this agent then only holds the root
+  // and its children, which receive the summed counts. Empty otherwise.
+  std::vector<std::unique_ptr<Mcts_agent>> root_agents;
+
+  // The evaluator replacing the random playouts and the queue that batches
+  // the leaves for it, or nullptr
+  std::shared_ptr<Leaf_evaluator> leaf_evaluator;
+  std::unique_ptr<Evaluation_queue> evaluation_queue;
+
+  // The thread running the background search while pondering or choosing a
+  // move with start_choosing_move()
+  std::thread background_thread;
+  // Set to make the running search finish its current iterations and return
+  std::atomic<bool> is_stop_requested{false};
+  // Set by the worker that finds the best move settled, so that all workers
+  // stop early
+  std::atomic<bool> is_best_move_settled{false};
+  // The time at which the running search started
+  std::chrono::high_resolution_clock::time_point search_start_time;
+  // The exception thrown by the background search, if any
+  std::exception_ptr ponder_exception;
+  // Held while the root is replaced, so that get_search_progress() never
+  // reads a root that is being rebuilt
+  mutable std::mutex root_mutex;
+
+  // The budget of the move that begin_move() started, which continue_move()
+  // searches in slices
+  std::chrono::high_resolution_clock::time_point move_end_time;
+  std::atomic<int> move_iteration_counter{0};
+  bool is_move_resumed = false;
+  // The time at which the running slice of a move ends, or the maximum time
+  // point if the search is not sliced. Only used by serial agents.
+  std::chrono::high_resolution_clock::time_point slice_end_time =
+      std::chrono::high_resolution_clock::time_point::max();
+
+  // The connections to the other machines searching together with this
+  // agent, or nullptr
+  std::shared_ptr<Cluster_link> cluster_link;
+  // The counts that the other machines added to every root child during the
+  // last search, indexed by the cell of the child's move. Only set once the
+  // synchronization of the search has ended, and empty otherwise.
+  std::vector<std::uint64_t> remote_root_statistics;
+  // The number of private trees whose roots are prepared for the running
+  // search, after which their root children may be read
+  std::atomic<unsigned int> prepared_root_count{0};
+
+  /**
+   * @brief Tells the thread that synchronizes the root statistics with the
+   * cluster that the local search has ended.
+   */
+  struct Search_end_signal {
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool is_search_finished = false;
+  };
+
+  // The heap allocations made by the playouts of the last search
+  std::atomic<std::size_t> playout_allocation_count{0};
+
+  // The statistics of every worker in the last search, each written by its
+  // worker when it stops searching
+  std::vector<Worker_statistics> worker_statistics;
+
+  /**
+   * @brief The statistics a worker collects while it searches, together with
+   * the clock that times the phases of its iterations.
+   *
+   * Reading the clock costs about as much as a percent of a short iteration
+   * per phase, so only every timing_interval-th iteration, and every
+   * timing_interval-th batch of leaves, is timed, starting with the first.
+   * Its phase times are counted timing_interval times, which makes the phase
+   * times unbiased estimates. All counts are exact.
+   */
+  struct Statistics_recorder {
+    static constexpr int timing_interval = 16;
+
+    Worker_statistics statistics;
+    std::chrono::steady_clock::time_point phase_start;
+    bool is_timing = false;
+    int iterations_until_timing = 1;
+    int batches_until_timing = 1;
+
+    /**
+     * @brief Starts an iteration, and the clock of its first phase if the
+     * iteration is timed.
+     */
+    void start_iteration() { start_timing(iterations_until_timing); }
+
+    /**
+     * @brief Starts the evaluation of a batch of leaves, and the clock of its
+     * first phase if the batch is timed.
+     */
+    void start_batch() { start_timing(batches_until_timing); }
+
+    /**
+     * @brief Adds the time since the previous phase ended to the time of the
+     * phase that just ended, and starts timing the next phase. Does nothing
+     * if the current iteration or batch is not timed.
+     *
+     * @param phase_time The time of the phase that just ended.
+     */
+    void end_phase(std::chrono::nanoseconds& phase_time) {
+      if (is_timing) {
+        auto now = std::chrono::steady_clock::now();
+        phase_time += (now - phase_start) * timing_interval;
+        phase_start = now;
+      }
+    }
+
+    /**
+     * @brief Decides whether to time what starts now, and starts the clock
+     * if so.
+     *
+     * @param until_timing The countdown to the next timed iteration or batch.
+     */
+    void start_timing(int& until_timing) {
+      is_timing = --until_timing == 0;
+      if (is_timing) {
+        until_timing = timing_interval;
+        phase_start = std::chrono::steady_clock::now();
+      }
+    }
 
-  // The root node of the game tree
-  struct Node;
-  std::shared_ptr<Node> root;
+    /**
+     * @brief Counts an iteration whose path from the root had the given
+     * length.
+     */
+    void record_depth(int depth) {
+      ++statistics.iterations;
+      statistics.max_depth = std::max(statistics.max_depth, depth);
+      statistics.total_depth += depth;
+    }
+  };
 
   /**
    * @brief A nested structure representing a node in the search tree for Monte
@@ -119,131 +528,723 @@ class Mcts_agent {
    *
    * Each node in the tree corresponds to a unique game state.
    * It contains information about the game state and also about the progress of
-   * the search.
+   * the search. Nodes live in the agent's Node_pool and refer to their children
+   * by their index in the pool. The children of a node form a block of
+   * chunks of 1, 2, 4, 8 and so on children, which lie contiguously in the
+   * pool each, so a node only stores where the first chunk starts and how
+   * many children there are, and the first child of every chunk stores where
+   * the next one starts. The structure is trivially constructible, so the
+   * pool does not touch its memory until a node is allocated and
+   * initialized.
+   *
+   * Children are created lazily, one at a time when the search first selects
+   * them, in the order of Mcts_agent::get_child_moves(). The moves that have
+   * no child yet are therefore not stored at all: they are the remaining
+   * moves of that order. A chunk is allocated when its first child is
+   * created, so a block holds at most about twice as many nodes as children,
+   * and chunks never move while workers descend through them or
+   * backpropagate through them. The root and, with RAVE, every node get all
+   * their children at once, as consecutive chunks.
+   *
+   * Nodes that represent the same game state can share one block of children
+   * through the transposition table, so a node can be reached from several
+   * parents and does not store a parent. The search follows the path it
+   * descended instead, see Search_path.
+   *
+   * The win and visit counts of a node are not part of the structure but are
+   * kept in node_statistics and node_amaf_statistics at the node's index, so
+   * the counts of the children in a chunk lie next to each other in memory.
    */
   struct Node {
     /**
-     * @brief The number of wins that have been recorded through this node.
+     * @brief The index of the first child node. The children represent the
+     * game states that can be reached from this node's game state by one
+     * move, and are found through Mcts_agent::get_child_index() and
+     * Mcts_agent::get_next_child_index().
      *
-     * This is incremented every time a simulation (or playout) that passes
-     * through this node results in a win.
+     * A worker that expands the node stores the index before the count, both
+     * with release semantics. Workers that read the count before the index
+     * with acquire semantics therefore never read past the end of a block.
      */
-    int win_count;
+    std::atomic<std::uint32_t> first_child_index;
     /**
-     * @brief The number of times this node has been visited during the search.
-     *
-     * This is incremented every time the search algorithm selects this node to
-     * start a new simulation (or playout).
-     */
-    int visit_count;
-    /**
-     * @brief The move that led to this game state from the parent node's game
-     * state. For a parent node, it's filler value is (-1, -1).
-     *
-     * This is represented as a pair of integers, typically representing
-     * coordinates on a game board.
+     * @brief If the node is the first child in a chunk of its parent's
+     * children, the index of the first child in the next chunk, or
+     * Node_pool::null_index if there is none yet. It is set before the
+     * children of the next chunk are published through the parent's
+     * child_count.
      */
-    std::pair<int, int> move;
+    std::atomic<std::uint32_t> next_chunk_index;
     /**
      * @brief The player who made the move from the parent node's state to this
-     * node's state (Cell_state).
+     * node's state (Cell_state). For the root node, it is the opponent of the
+     * player to move.
      *
-     * This indicates who will make the next move in the game state associated
-     * with this node.
+     * The opponent of this player makes the next move in the game state
+     * associated with this node.
      */
     Cell_state player;
     /**
-     * @brief The child nodes of this node, each representing a game state that
-     * can be reached from this node's game state by one move.
+     * @brief The number of child nodes. Only valid once the node is expanded.
      */
-    std::vector<std::shared_ptr<Node>> child_nodes;
+    std::atomic<std::uint16_t> child_count;
     /**
-     * @brief A pointer to the parent node of this node, representing the game
-     * state from which this node's game state can be reached by one move.
+     * @brief The number of children the chunks of the node's block have
+     * room for, which is the end of the chunk of its last child, or the
+     * number of moves if that is lower. A block taken over from the
+     * transposition table is complete, so a node never adds children to a
+     * block it shares. Only read and written by the worker that expands or
+     * widens the node.
      */
-    std::shared_ptr<Node> parent_node;
+    std::uint16_t child_capacity;
     /**
-     * @brief A mutex to ensure thread-safety during the updating of the node's
-     * data.
-     *
-     * This is especially important when the MCTS algorithm is used with
-     * parallel computations.
+     * @brief The row and column of the move that led to this game state from
+     * the parent node's game state. For the root node, they are -1.
+     */
+    std::int8_t move_x;
+    std::int8_t move_y;
+    /**
+     * @brief Whether the children have been allocated, as an Expansion_state.
+     * A worker claims the expansion by switching it from Unexpanded to
+     * Expanding, and sets it to Expanded with release semantics once the
+     * first children are complete, so workers that observe Expanded can read
+     * the children without locking. A worker that adds a child later claims
+     * the node by switching it from Expanded to Widening and back.
+     */
+    std::atomic<std::uint8_t> expansion_state;
+
+    /**
+     * @brief The stages a node goes through while it is expanded.
+     */
+    enum Expansion_state : std::uint8_t {
+      Unexpanded,
+      Expanding,
+      Expanded,
+      // Expanded, while a worker adds a child
+      Widening
+    };
+
+    /**
+     * @brief Returns whether an Expansion_state lets the children be read.
      */
-    std::mutex node_mutex;
+    static bool has_children(std::uint8_t expansion_state) {
+      return expansion_state >= Expanded;
+    }
 
     /**
-     * Constructs a new Node.
+     * @brief The amount added to the packed statistics of a node for one
+     * visit.
+     */
+    static constexpr std::uint64_t one_visit = std::uint64_t(1) << 32;
+
+    /**
+     * @brief Extracts the win count from a value of the packed statistics.
+     */
+    static int get_win_count(std::uint64_t statistics) {
+      return static_cast<int>(statistics & (one_visit - 1));
+    }
+
+    /**
+     * @brief Extracts the visit count from a value of the packed statistics.
+     */
+    static int get_visit_count(std::uint64_t statistics) {
+      return static_cast<int>(statistics >> 32);
+    }
+
+    /**
+     * @brief Initializes a freshly allocated node as an unexpanded node. Its
+     * statistics are reset by Mcts_agent::initialize_node(), and its
+     * next_chunk_index is left to the parent, which links its chunks.
      *
      * @param player The player making a move (Cell_state).
      * @param move The move that can be made by the player. (-1, -1) if
      * the node is the root node.
-     * @param parent_node The parent node in the tree. default: nullptr
-     * is used for the root node.
      */
-    Node(Cell_state player, std::pair<int, int> move,
-         std::shared_ptr<Node> parent_node = nullptr);
+    void initialize(Cell_state player, std::pair<int, int> move);
+
+    /**
+     * @brief Returns the move that led to this node as a pair of coordinates.
+     */
+    std::pair<int, int> get_move() const { return {move_x, move_y}; }
   };
 
   /**
-   * @brief Expands a given node by generating all its possible child nodes
-   * based on the valid moves on the current game board.
+   * @brief The indices of the nodes from the root down to the node that an
+   * iteration simulates from, root first, along which the result of the
+   * simulation is backpropagated. A worker reserves room for the longest
+   * possible path once per search, so the path never allocates.
+   */
+  using Search_path = std::vector<std::uint32_t>;
+
+  /**
+   * @brief Memory that a worker reuses for all of its playouts, so that a
+   * playout does not allocate.
+   */
+  struct Playout_scratch {
+    /**
+     * @brief The board on which a playout is played. The game state is copied
+     * into it at the start of every playout, which never allocates since Board
+     * only holds fixed-size arrays.
+     */
+    Board board;
+    /**
+     * @brief The empty cells of the playout board. Its capacity covers every
+     * cell of the board, so it never grows.
+     */
+    std::vector<std::pair<int, int>> empty_cells;
+    /**
+     * @brief For playouts with bridge responses, the Cell_state of every
+     * cell of the playout board by cell index, and the position of every
+     * empty cell in empty_cells, so that a response is removed from the list
+     * in constant time.
+     */
+    std::vector<std::uint8_t> cell_states;
+    std::vector<std::int16_t> empty_cell_positions;
+    /**
+     * @brief The bridge patterns of the board size.
+     */
+    const Playout_patterns* patterns;
+
+    /**
+     * @brief Allocates the scratch memory for playouts on the given board.
+     *
+     * @param board The game state at the root of the search.
+     */
+    explicit Playout_scratch(const Board& board);
+  };
+
+  /**
+   * @brief The number of nodes the pool can hold for one decision.
+   *
+   * Once the pool is full, the tree stops growing and the remaining
+   * iterations simulate playouts from its leaves.
+   */
+  static constexpr std::uint32_t node_pool_capacity = std::uint32_t(1) << 24;
+
+  /**
+   * @brief The error probability that sets the width of the confidence
+   * bounds of the early stop rule. The bounds are a heuristic, so this is
+   * not the probability of stopping on a wrong move.
+   */
+  static constexpr double early_stop_error_probability = 0.001;
+
+  // The storage for the nodes of the game tree. It is cleared at the start of
+  // every decision, which frees the previous tree at once.
+  Node_pool<Node> node_pool;
+
+  /**
+   * @brief The win and visit counts of every node in node_pool, at the index
+   * of the node, packed into one atomic word so that workers can update and
+   * read them together without locking.
+   *
+   * The upper 32 bits hold the number of times the search selected the node
+   * on the way to a new simulation (or playout), and the lower 32 bits hold
+   * the number of those simulations that resulted in a win. Since the visit
+   * is counted before the result is known, a pending playout counts as a
+   * loss (a virtual loss) until it is backpropagated. A single load always
+   * yields a win count and a visit count that belong together.
+   *
+   * The counts are stored apart from the nodes, so selection reads the
+   * counts of all children of a node as one dense array of 8-byte words
+   * instead of picking them out of the much larger nodes.
+   */
+  std::unique_ptr<std::atomic<std::uint64_t>[]> node_statistics;
+
+  /**
+   * @brief The All-Moves-As-First (AMAF) win and visit counts of the move of
+   * every node in node_pool, packed like node_statistics. They count every
+   * playout through the parent node in which the node's player made the
+   * node's move at any later point, in the tree or in the playout. Only
+   * updated with RAVE.
+   */
+  std::unique_ptr<std::atomic<std::uint64_t>[]> node_amaf_statistics;
+
+  // The children of the expanded game states by their Zobrist hash, or
+  // nullptr if transposed states are not merged. Cleared together with the
+  // pool.
+  std::unique_ptr<Transposition_table> transposition_table;
+
+  // The index of the root node of the game tree
+  std::uint32_t root_index = Node_pool<Node>::null_index;
+
+  // The number of nodes created in node_pool, which unlike its size does not
+  // count the room left in the chunks of children
+  std::atomic<std::uint32_t> tree_node_count{0};
+
+  // The game state at the root node of the tree, or nullptr before the first
+  // search
+  std::unique_ptr<Board> root_board;
+
+  /**
+   * @brief Makes the root of the tree represent the given game state and
+   * expands it.
+   *
+   * The matching subtree of the previous search is promoted if there is one.
+   * Otherwise, the previous tree is released and a new root is created.
+   *
+   * @param board The game state at the root.
+   * @param player The player to move in that game state.
+   */
+  void prepare_root(const Board& board, Cell_state player);
+
+  /**
+   * @brief Returns the moves of a game state in the order in which a node
+   * gets its children: cells next to more stones first, since most fights
+   * are local, then cells closer to the centre, then by cell index. The order
+   * only depends on the stones, so every node of a game state, however it
+   * was reached, gets its children in the same order, and the moves a node
+   * has no child for yet are the moves after its last child.
+   *
+   * @param board The game state.
+   * @param move_count The number of moves to return, from the first one.
+   * @param moves Receives the first move_count moves in order, or all valid
+   * moves if there are fewer. It must have room for every cell.
+   * @return The number of moves written.
+   */
+  static std::uint32_t get_child_moves(const Board& board,
+                                       std::uint32_t move_count,
+                                       std::pair<int, int>* moves);
+
+  /**
+   * @brief Returns the end of the chunk that holds the child at the given
+   * position, capped at the number of moves, i.e. the number of children
+   * that a block with child_count children has room for.
+   *
+   * @param child_count The number of children, at least 1.
+   * @param move_count The number of moves of the node.
+   */
+  static std::uint32_t get_chunk_end(std::uint32_t child_count,
+                                     std::uint32_t move_count);
+
+  /**
+   * @brief Returns the index of the child at a position among the children
+   * of a node, following the chunks of its block.
+   *
+   * @param first_child_index The index of the node's first child.
+   * @param child_offset The position of the child, which the node must
+   * have.
+   */
+  std::uint32_t get_child_index(std::uint32_t first_child_index,
+                                std::uint32_t child_offset) const;
+
+  /**
+   * @brief Returns the index of the child after a given one among the
+   * children of a node, which is the next index unless the child ends a
+   * chunk. Only valid if the node has that child, but cheap to call past the
+   * last one.
+   *
+   * @param child_index The index of a child.
+   * @param child_offset The position of that child among the children.
+   */
+  std::uint32_t get_next_child_index(std::uint32_t child_index,
+                                     std::uint32_t child_offset) const;
+
+  /**
+   * @brief Adds children to an expanded node, for the moves after its last
+   * child in the order of get_child_moves(), until it has child_count children
+   * or a child for every move.
+   *
+   * The children are created in the room of the node's last chunk, and the
+   * chunks up to the one of the last new child are allocated as one piece
+   * and linked to the block, so the children never move. With a
+   * transposition table, the node's game state is recorded with its
+   * children once it has a child for every move, since only a complete
+   * block may be shared.
+   *
+   * Only the worker that has claimed the node's expansion or widening, or the
+   * only thread, may add children.
+   *
+   * @param node_index The index of the node.
+   * @param board The game state of the node.
+   * @param child_count The number of children the node is to have.
+   * @tparam verbose Whether the new children are logged.
+   * @return false if the pool is full, in which case the node keeps its
+   * children, true otherwise.
+   */
+  template <bool verbose>
+  bool add_children(std::uint32_t node_index, const Board& board,
+                    std::uint32_t child_count);
+
+  /**
+   * @brief Initializes a freshly allocated node and resets its statistics.
+   *
+   * @param node_index The index of the node in the pool.
+   * @param player The player making the node's move.
+   * @param move The node's move, or (-1, -1) for the root.
+   */
+  void initialize_node(std::uint32_t node_index, Cell_state player,
+                       std::pair<int, int> move);
+
+  /**
+   * @brief Returns whether the search should be logged, i.e. whether both the
+   * agent and the logger are verbose.
+   */
+  bool is_logging() const;
+
+  /**
+   * @brief Sets or clears the request to stop searching, for the private
+   * agents of the workers as well.
+   *
+   * @param is_requested Whether the running search has to stop.
+   */
+  void set_stop_requested(bool is_requested);
+
+  /**
+   * @brief Returns the number of nodes in the tree, or in all private trees
+   * with Parallel_mode::Root_trees.
+   */
+  std::uint32_t get_tree_node_count() const;
+
+  /**
+   * @brief Runs MCTS iterations from the root until the end time is reached,
+   * a stop is requested, or the best move is settled, on the workers of the
+   * thread pool in parallel mode and on the calling thread otherwise.
+   *
+   * @param board The game state at the root.
+   * @param end_time The time at which the search stops.
+   * @param max_iterations The number of iterations after which the search
+   * stops, or 0 for no limit.
+   * @param mcts_iteration_counter Counts the iterations of all workers.
+   * @param is_resumed If true, the search continues the one of the previous
+   * call, whose start time and worker statistics are kept, as for the time
+   * slices of continue_move(). Only supported for serial agents.
+   */
+  void run_search(
+      const Board& board,
+      const std::chrono::time_point<std::chrono::high_resolution_clock>&
+          end_time,
+      int max_iterations, std::atomic<int>& mcts_iteration_counter,
+      bool is_resumed = false);
+
+  /**
+   * @brief Chooses a move like choose_move(), after pondering was stopped,
+   * so that it can also run on the background thread. Unlike choose_move(),
+   * it does not announce the search on the console.
+   */
+  std::pair<int, int> search_move(const Board& board, Cell_state player,
+                                  Search_statistics& statistics);
+
+  /**
+   * @brief Starts searching a move in time slices: prepares the root and
+   * sets the budget of the move, without running any iterations. A
+   * Search_scheduler then runs slices with continue_move() until the move
+   * is searched, and finishes it with end_move().
+   *
+   * The agent must be serial and have no cluster link.
+   *
+   * @param board The current game state.
+   * @param player The player for whom the move is being chosen.
+   */
+  void begin_move(const Board& board, Cell_state player);
+
+  /**
+   * @brief Runs the iterations of the move started by begin_move() for up to
+   * one slice of time, or until the search limits are reached.
+   *
+   * @param slice_duration The time of the slice.
+   * @return True if the search of the move is over, false if the move needs
+   * more slices.
+   */
+  bool continue_move(std::chrono::nanoseconds slice_duration);
+
+  /**
+   * @brief Chooses the best move of the search started by begin_move(), like
+   * at the end of choose_move().
+   *
+   * @param statistics Receives the statistics of all slices of the search.
+   * @return The best move.
+   * @throws std::runtime_error If the statistics are not sufficient to choose
+   * a move.
+   */
+  std::pair<int, int> end_move(Search_statistics& statistics);
+
+  /**
+   * @brief Adds the counts of the root children to the counts of their cells.
+   * Does nothing if the agent has no root yet.
+   *
+   * @param statistics Receives the packed counts by cell index, row first.
+   * It must have room for every cell.
+   * @param board_size Receives the size of the root's board, if any.
+   */
+  void add_root_statistics(std::uint64_t* statistics, int& board_size) const;
+
+  /**
+   * @brief Runs the search in every private tree at the same time, one on
+   * each worker, and sums the counts of their root children into the
+   * children of the root. Called by run_search() with
+   * Parallel_mode::Root_trees.
+   *
+   * Every private agent first makes its root represent the game state, which
+   * reuses its own tree of the previous search where it matches. The
+   * iterations are divided among the trees, and the workers run until the
+   * same end time. They share nothing while they search.
+   *
+   * The parameters are the same as for run_search().
+   */
+  void run_root_search(
+      const Board& board,
+      const std::chrono::time_point<std::chrono::high_resolution_clock>&
+          end_time,
+      int max_iterations, std::atomic<int>& mcts_iteration_counter);
+
+  /**
+   * @brief Replaces the counts of the root and its children with the sums of
+   * the counts of the roots and root children of the private trees, and of
+   * the counts received from the cluster, if any. The children are matched by
+   * their moves.
+   */
+  void merge_root_statistics();
+
+  /**
+   * @brief Exchanges the root statistics with the other machines of the
+   * cluster every sync interval until the searches of all machines have
+   * ended. Runs on its own thread next to the search of choose_move().
+   *
+   * @param position_hash The Zobrist hash of the searched game state.
+   * @param signal Signalled once the local search has ended.
+   */
+  void synchronize_root_statistics(std::uint64_t position_hash,
+                                   Search_end_signal& signal);
+
+  /**
+   * @brief Reads the counts of the root children that the local search
+   * produced, without the counts received from the cluster.
+   *
+   * @param received_statistics The counts received so far, which the root
+   * children of the shared tree hold as well.
+   * @param statistics Receives the packed counts, indexed by the cell of the
+   * child's move.
+   * @return False if the private trees are not prepared yet, in which case
+   * nothing is read.
+   */
+  bool read_local_root_statistics(
+      const std::vector<std::uint64_t>& received_statistics,
+      std::vector<std::uint64_t>& statistics) const;
+
+  /**
+   * @brief Adds counts received from the cluster to the root children and
+   * the root of the shared tree, so that they steer the running search.
+   *
+   * @param statistics The packed counts, indexed by the cell of the child's
+   * move.
+   */
+  void add_remote_root_statistics(
+      const std::vector<std::uint64_t>& statistics);
+
+  /**
+   * @brief Expands a given node by generating its first child node, or all
+   * possible child nodes for the root and with RAVE, based on the valid moves
+   * on the current game board.
+   *
+   * This function allocates the first chunk of new nodes in the pool and
+   * links it to the input `Node`, each representing a valid move for the
+   * player to move at the current game state, i.e. the opponent of the node's
+   * player, see add_children(). Later chunks are allocated as the next
+   * children are added, so the children never move. Only the worker that
+   * claims the node's expansion state creates the children.
+   * Nothing happens if another worker has already expanded the node.
    *
-   * This function populates the `child_nodes` member of the input `Node` with
-   * new nodes, each representing a valid move for the player at the current
-   * game state. Each child node is linked back to the input node as its parent.
+   * With a transposition table, the node takes over the children of the game
+   * state if the table holds them, without allocating anything, and newly
+   * created children are recorded in the table.
    *
    * If verbose mode is enabled, the function will also print information about
    * each new child node it creates.
    *
-   * @param node A shared_ptr to the Node to be expanded.
+   * @param node_index The index of the Node to be expanded.
    * @param board The current game state.
+   * @param recorder Counts the collisions with other workers, the failed
+   * expansions and the transposition hits of the calling worker.
+   * @tparam verbose Whether the new children are logged.
+   * @return false if another worker is still expanding the node or the pool
+   * is full, in which case its children must not be accessed. true otherwise.
    */
-  void expand_node(const std::shared_ptr<Node>& node, const Board& board);
+  template <bool verbose>
+  bool expand_node(std::uint32_t node_index, const Board& board,
+                   Statistics_recorder& recorder);
+
+  /**
+   * @brief Checks the search limits and claims the next iteration for the
+   * calling worker if none of them is reached.
+   *
+   * The clock is read and the early stop rule is checked only once per time
+   * check interval. The claimed iteration is counted in the shared counter
+   * right away.
+   *
+   * @param end_time The time at which the search stops, or the maximum time
+   * point if it is not timed.
+   * @param max_iterations The number of iterations of all workers after which
+   * the search stops, or 0 for no limit.
+   * @param mcts_iteration_counter Counts the iterations of all workers.
+   * @param iterations_until_time_check The iterations of the calling worker
+   * left until the next time check. Starts at 0 and is updated in place.
+   * @return The number of the claimed iteration, counting from 1, or 0 if the
+   * search has to stop.
+   */
+  int claim_iteration(
+      const std::chrono::time_point<std::chrono::high_resolution_clock>&
+          end_time,
+      int max_iterations, std::atomic<int>& mcts_iteration_counter,
+      int& iterations_until_time_check);
+
+  /**
+   * @brief Selects a leaf of the tree, and expands it and steps into one of
+   * its new children if the game is not decided at the leaf.
+   *
+   * @param board The board holding the root's game state. On return, it holds
+   * the game state of the returned node.
+   * @param path Receives the path from the root to the returned node. Every
+   * node after the root adds one move to the board.
+   * @param winner Receives the winner at the returned node, or
+   * Cell_state::Empty if the game goes on.
+   * @param recorder The statistics of the calling worker, on which the
+   * iteration must have been started. The selection and the expansion are
+   * timed.
+   * @tparam verbose Whether the steps are logged.
+   * @return The index of the node to simulate from.
+   */
+  template <bool verbose>
+  std::uint32_t select_and_expand_leaf(Board& board, Search_path& path,
+                                       Cell_state& winner,
+                                       Statistics_recorder& recorder);
 
   /**
    * @brief Performs the main loop of the Monte Carlo Tree Search (MCTS)
    * algorithm.
    *
    * This function performs multiple iterations of the MCTS algorithm until a
-   * provided end time is reached. In each iteration, a child node is selected
-   * from the root node using the UCT score, and a playout is simulated from
-   * this node, either in parallel or serially depending on the value of
-   * `is_parallelized`. The results of the playout are then backpropagated up
-   * the MCTS tree. The function also logs various statistics of the root node
+   * provided end time or number of iterations is reached, or until the tree
+   * is full if the number of tree nodes is limited. The clock is only read
+   * once per time check interval. In each iteration, the tree is descended
+   * from the root to a leaf using the UCT score. Unless the game is already
+   * decided at the leaf, the leaf is expanded and one of its new children is
+   * selected. A playout is then simulated from this node and the result is
+   * backpropagated up the MCTS tree. The moves along the path are applied to a
+   * single copy of the board and undone at the end of the iteration. In
+   * verbose mode, the function also logs various statistics of the root node
    * and its children after each iteration using the Logger class.
    *
+   * In parallel mode, every worker of the thread pool runs this function at
+   * the same time on the shared tree.
+   *
    * @param end_time The end time for the MCTS iterations. The function will
    * continue performing iterations until the current time is greater than this
-   * value.
-   * @param mcts_iteration_counter A reference to an integer counter for the
-   * number of MCTS iterations performed so far. This counter is incremented
-   * after each iteration.
+   * value, until a stop is requested while pondering, or until the best move
+   * is settled if early stopping is enabled. If it is the maximum time point,
+   * the clock is never read.
+   * @param max_iterations The number of iterations of all workers after which
+   * the search stops, or 0 for no limit.
+   * @param mcts_iteration_counter A reference to a counter for the number of
+   * MCTS iterations performed so far by all workers. A worker increments it
+   * when it starts an iteration, and undoes the increment if the iteration
+   * would exceed max_iterations.
    * @param board The current state of the game board.
-   * @param number_of_threads The number of threads to use for parallel
-   * playouts. This parameter is only relevant if `is_parallelized` is true.
+   * @param generator The random number generator of the calling worker.
+   * @param recorder Collects the statistics of the calling worker.
+   * @tparam verbose Whether the steps of the search are logged. The hot paths
+   * of the search take it as a template parameter, so that the search without
+   * logging contains no logging calls at all.
    */
+  template <bool verbose>
   void perform_mcts_iterations(
       const std::chrono::time_point<std::chrono::high_resolution_clock>&
           end_time,
-      int& mcts_iteration_counter, const Board& board,
-      unsigned int number_of_threads);
+      int max_iterations, std::atomic<int>& mcts_iteration_counter,
+      const Board& board, Xoshiro_generator& generator,
+      Statistics_recorder& recorder);
+
+  /**
+   * @brief Performs the MCTS iterations of a worker with the leaf evaluator
+   * in place of the random playouts. Called by perform_mcts_iterations().
+   *
+   * The worker selects and expands as many leaves as the evaluation queue
+   * asks for, before any of them is evaluated. Their virtual losses make the
+   * worker spread the leaves over different branches. The worker then queues
+   * the leaves and waits until the batch holding them is evaluated, draws the
+   * winner of every leaf from its win probability, and backpropagates it.
+   * Leaves at which the game is already decided are backpropagated right
+   * away.
+   *
+   * The parameters are the same as for perform_mcts_iterations().
+   */
+  template <bool verbose>
+  void perform_batched_iterations(
+      const std::chrono::time_point<std::chrono::high_resolution_clock>&
+          end_time,
+      int max_iterations, std::atomic<int>& mcts_iteration_counter,
+      const Board& board, Xoshiro_generator& generator,
+      Statistics_recorder& recorder);
+
+  /**
+   * @brief Combines the statistics of the workers of the last search.
+   *
+   * @param iteration_count The number of iterations of the search.
+   * @param elapsed_time The wall-clock time of the search.
+   * @return The statistics of the search.
+   */
+  Search_statistics collect_search_statistics(
+      int iteration_count, std::chrono::nanoseconds elapsed_time) const;
+
+  /**
+   * @brief Descends the tree from the root to a leaf, i.e. a node that has not
+   * been expanded, by repeatedly selecting the child with the highest UCT
+   * score. A virtual loss is added to every node on the path.
+   *
+   * The move of every selected node is made on the board, so that on return
+   * the board holds the game state of the leaf.
+   *
+   * @param board The board holding the root's game state. Modified in place.
+   * @param path Receives the path from the root to the leaf, so that the
+   * caller can undo the moves made on the board.
+   * @tparam verbose Whether the selected children are logged.
+   * @return The index of the selected leaf.
+   */
+  template <bool verbose>
+  std::uint32_t select_leaf(Board& board, Search_path& path);
 
   /**
    * @brief Selects the best child of a given parent node based on the Upper
    * Confidence Bound for Trees (UCT) score.
    *
    * This function iterates through all the child nodes of the given parent
-   * node, and for each child, calculates its UCT score using the
-   * calculate_uct_score() method. The child with the highest UCT score is
-   * selected as the best child. If verbose mode is enabled, the function prints
-   * the move coordinates and the UCT score of the selected child.
+   * node, and for each child, calculates its UCT score as
+   * calculate_uct_score() does. The logarithm of the parent's visit count is
+   * taken once for all children. With a transposition table, the children may
+   * be shared with other nodes of the same game state, so the parent counts
+   * at least as many visits as its children have together. Without RAVE,
+   * the statistics of the children are copied out of node_statistics and
+   * scored several at a time with SSE2 or AVX2 where available. The child
+   * with the highest UCT score is selected as the best child, and a virtual
+   * loss is added to it. If verbose mode is enabled, the function prints the
+   * move coordinates and the UCT score of the selected child.
    *
-   * @param parent_node A shared_ptr to the parent Node whose child nodes are to
+   * A move without a child would score like an unvisited child, so once the
+   * newest child has been visited, the next move gets its child and is
+   * selected instead, see add_children(). With progressive widening, only the
+   * first get_widened_child_count() children are considered, and a child is
+   * only added while there are fewer.
+   *
+   * @param parent_index The index of the parent Node whose child nodes are to
    * be evaluated.
-   * @return A shared_ptr to the Node that is selected as the best child.
+   * @param board The game state of the parent.
+   * @tparam verbose Whether the selected child is logged.
+   * @return The index of the Node that is selected as the best child.
    */
-  std::shared_ptr<Node> select_child_for_playout(
-      const std::shared_ptr<Node>& parent_node);
+  template <bool verbose>
+  std::uint32_t select_child_for_playout(std::uint32_t parent_index,
+                                         const Board& board);
+
+  /**
+   * @brief Returns how many children a node with the given number of visits
+   * considers with progressive widening, which is
+   * ceil(widening_factor * visit_count ^ widening_exponent) of
+   * Search_limits, or move_count without progressive widening.
+   *
+   * @param visit_count The visits of the node, at least 1.
+   * @param move_count The number of valid moves in the node's game state.
+   */
+  std::uint32_t get_widened_child_count(int visit_count,
+                                        std::uint32_t move_count) const;
 
   /**
    * @brief Calculates the Upper Confidence Bound for Trees (UCT) score for a
@@ -254,77 +1255,219 @@ class Mcts_agent {
    * function uses the UCT formula, which is a sum of the exploitation term (win
    * ratio) and the exploration term. The exploration term is proportional to
    * the square root of the logarithm of the parent node's visit count divided
-   * by the child node's visit count.
+   * by the child node's visit count. The part that only depends on the parent
+   * is computed by get_exploration_numerator() once for all children.
    *
    * The function returns a high value if the child node has not been visited
    * yet, to encourage the exploration of unvisited nodes.
    *
-   * @param child_node A shared_ptr to the child Node for which the UCT score is
-   * being calculated.
-   * @param parent_node A shared_ptr to the parent Node of the child node.
+   * @param win_count The win count of the child node.
+   * @param visit_count The visit count of the child node.
+   * @param exploration_numerator The result of get_exploration_numerator()
+   * for the parent node.
    * @return The calculated UCT score.
    */
-  double calculate_uct_score(const std::shared_ptr<Node>& child_node,
-                             const std::shared_ptr<Node>& parent_node);
+  double calculate_uct_score(int win_count, int visit_count,
+                             double exploration_numerator) const;
+
+  /**
+   * @brief Returns the exploration factor times the square root of the
+   * logarithm of a parent node's visit count, which the exploration term of
+   * every child divides by the square root of the child's visit count.
+   *
+   * @param parent_visit_count The visit count of the parent node.
+   */
+  double get_exploration_numerator(int parent_visit_count) const;
+
+  /**
+   * @brief Calculates the UCT score of a node with its win ratio blended with
+   * its AMAF win ratio, as used with RAVE.
+   *
+   * The exploitation term is (1 - beta) times the win ratio plus beta times
+   * the AMAF win ratio, with beta = sqrt(k / (3 * visit_count + k)) for the
+   * RAVE equivalence k, the schedule proposed by Gelly and Silver. A node
+   * without visits is scored by its AMAF win ratio alone and the exploration
+   * term of a node with one visit, so RAVE decides which unvisited node is
+   * tried first and whether it is tried before the visited ones. A node
+   * without AMAF statistics gets the score of calculate_uct_score().
+   *
+   * @param statistics The packed statistics of the child node.
+   * @param amaf_statistics The packed AMAF statistics of the child node.
+   * @param exploration_numerator The result of get_exploration_numerator()
+   * for the parent node.
+   * @return The calculated score.
+   */
+  double calculate_rave_score(std::uint64_t statistics,
+                              std::uint64_t amaf_statistics,
+                              double exploration_numerator) const;
+
+  /**
+   * @brief Counts a visit of a node before its playout result is known, which
+   * makes the node look like it lost until the result is backpropagated.
+   *
+   * @param node_index The index of the Node that is visited.
+   */
+  void add_virtual_loss(std::uint32_t node_index);
+
+  /**
+   * @brief Simulates a playout from a given node on a given board using the
+   * configured playout mode.
+   *
+   * @param node The Node from which the simulation starts.
+   * @param board The Board on which the simulation is conducted. The board
+   * is not modified.
+   * @param scratch The playout scratch memory of the calling worker.
+   * @param generator The random number generator of the calling worker.
+   * @tparam verbose Whether the steps of the simulation are logged.
+   * @return The Cell_state of the winning player.
+   */
+  template <bool verbose>
+  Cell_state simulate_playout(const Node& node, const Board& board,
+                              Playout_scratch& scratch,
+                              Xoshiro_generator& generator);
 
   /**
    * @brief Simulates a random playout from a given node on a given board.
    *
-   * This function takes as input a node and a board state, and simulates a
-   * random playout starting from the node's move. The simulation proceeds by
-   * alternating between players, choosing a random valid move for each player,
-   * until the game ends (i.e., when a player wins). If verbose mode is enabled,
+   * This function takes as input a node and a board state on which the node's
+   * move has already been made, and simulates a random playout starting from
+   * the node's move. The empty cells are collected once, and the simulation
+   * proceeds by alternating between players, choosing a random empty cell for
+   * each player and removing it from the list in constant time, until the game
+   * ends (i.e., when a player wins). If verbose mode is enabled,
    * the function also prints information about the simulation, including the
    * move made at each step and the state of the board and its state using
    * Logger.
    *
-   * @param node A shared_ptr to the Node from which the simulation starts.
-   * @param board The Board on which the simulation is conducted. The board
-   * state is copied, so the original board is not modified.
+   * @param node The Node from which the simulation starts.
+   * @param board The game state from which the simulation is conducted. It is
+   * copied into the scratch board, so the original board is not modified.
+   * @param scratch The playout scratch memory of the calling worker.
+   * @param generator The random number generator of the calling worker.
+   * @tparam verbose Whether the steps of the simulation are logged.
    * @return The Cell_state of the winning player.
    */
-  Cell_state simulate_random_playout(const std::shared_ptr<Node>& node,
-                                     Board board);
+  template <bool verbose>
+  Cell_state simulate_random_playout(const Node& node, const Board& board,
+                                     Playout_scratch& scratch,
+                                     Xoshiro_generator& generator);
 
   /**
-   * @brief Performs a number of game playouts in parallel from a given node and
-   * returns their results.
+   * @brief Simulates a random playout from a given node by filling the whole
+   * board and checking for a winner once.
    *
-   * This function simulates several game playouts starting from a given node in
-   * parallel using multiple threads. It returns the outcome of each playout in
-   * a vector, with the result of the playout simulated by the i-th thread
-   * stored in the i-th position of the vector.
+   * The node's move must already be on the board. The empty cells are shuffled
+   * once and assigned alternately to both players, starting with the opponent
+   * of the node's player. Since a full Hex board always has exactly one
+   * winner, this yields the same distribution of winners as
+   * simulate_random_playout(), without collecting the valid moves and checking
+   * for a winner on every ply. The cells are filled in bulk with
+   * Board::fill_cells_alternately(), so the winner is found by a single
+   * bitboard flood fill. If verbose mode is enabled, the moves are made and
+   * logged one by one in the same way as in a move-by-move playout.
    *
-   * @param node The node from which the playouts should be simulated.
-   * @param board The current state of the game board.
-   * @param number_of_threads The number of threads to use for the parallel
-   * playouts.
-   * @return A vector of Cell_state, where each element is the the playout
-   * winner.
+   * @param node The Node from which the simulation starts.
+   * @param board The game state from which the simulation is conducted. It is
+   * copied into the scratch board, so the original board is not modified.
+   * @param scratch The playout scratch memory of the calling worker.
+   * @param generator The random number generator of the calling worker.
+   * @tparam verbose Whether the steps of the simulation are logged.
+   * @return The Cell_state of the winning player.
+   */
+  template <bool verbose>
+  Cell_state simulate_filled_playout(const Node& node, const Board& board,
+                                     Playout_scratch& scratch,
+                                     Xoshiro_generator& generator);
+
+  /**
+   * @brief Simulates a playout from a given node like
+   * simulate_random_playout(), except that a player answers an intrusion of
+   * the opponent into one of their bridges by taking the other cell of the
+   * bridge.
+   *
+   * After every move, the pattern of the six neighbours of the move is
+   * looked up in a Playout_patterns table, which yields the cells that
+   * restore a bridge of the next player. If there are several, one of them is
+   * chosen at random, and if there is none, a random empty cell is taken. The
+   * cell states are kept in the scratch memory alongside the board, so that a
+   * pattern is read without decoding the bitboards.
+   *
+   * @param node The Node from which the simulation starts. Its move, if any,
+   * is the first move that may be answered.
+   * @param board The game state from which the simulation is conducted. It is
+   * copied into the scratch board, so the original board is not modified.
+   * @param scratch The playout scratch memory of the calling worker.
+   * @param generator The random number generator of the calling worker.
+   * @tparam verbose Whether the steps of the simulation are logged.
+   * @return The Cell_state of the winning player.
    */
-  std::vector<Cell_state> parallel_playout(std::shared_ptr<Node> node,
-                                           const Board& board,
-                                           unsigned int number_of_threads);
+  template <bool verbose>
+  Cell_state simulate_bridge_playout(const Node& node, const Board& board,
+                                     Playout_scratch& scratch,
+                                     Xoshiro_generator& generator);
 
   /**
    * @brief Backpropagates the result of a simulation through the tree.
    *
-   * This function takes a node and the winner of a game simulation, and
-   * backpropagates the result through the tree. It starts at the given node and
-   * moves up towards the root, incrementing the visit count of each node along
-   * the way. If the winner is the same as the player at a node, it also
-   * increments the win count of that node. The process continues until the root
-   * is reached. The function is designed to be thread-safe by locking the
-   * node's mutex before updating its data.
+   * This function takes a path and the winner of a game simulation, and
+   * backpropagates the result through the tree. It starts at the last node of
+   * the path and moves up towards the root. The visits of the nodes along the
+   * way were already counted as virtual losses during selection, so if the
+   * winner is the same as the player at a node, it increments the win count
+   * of that node. The process continues until the root is reached. Every
+   * update is a single atomic addition, so workers never wait for each other.
    *
-   * @note In the current implementation, the function only traverses two levels
-   * of the tree (from a child node to its root), but it can be used to
-   * traverse the entire tree if needed.
+   * With RAVE, the AMAF statistics of the children of every expanded node on
+   * the way are updated as well. A child's move was made after the node by
+   * the child's player exactly if the final board holds a stone of that
+   * player on the child's cell, since the cell was empty at the node.
    *
-   * @param node A shared_ptr to the Node at which to start the backpropagation.
+   * @param path The path from the root to the node the simulation started
+   * from.
    * @param winner The Cell_state of the winning player in the game simulation.
+   * @param final_board The board at the end of the simulation. Only read with
+   * RAVE.
+   * @tparam verbose Whether the updated nodes are logged.
    */
-  void backpropagate(std::shared_ptr<Node>& node, Cell_state winner);
+  template <bool verbose>
+  void backpropagate(const Search_path& path, Cell_state winner,
+                     const Board& final_board);
+
+  /**
+   * @brief Finds the node of the previous tree that represents the given game
+   * state.
+   *
+   * The stones placed since the previous search are followed down the tree,
+   * taking at each level the child whose move is a new stone of the player
+   * making that move. The search fails if the previous root position is not
+   * contained in the given board, if a node on the way has not been expanded,
+   * or if the node found does not have the given player to move.
+   *
+   * @param board The current game state.
+   * @param player The player to move.
+   * @return The index of the matching node, or Node_pool::null_index if there
+   * is none.
+   */
+  std::uint32_t find_reusable_subtree(const Board& board,
+                                      Cell_state player) const;
+
+  /**
+   * @brief Makes a node the new root and releases the rest of the tree.
+   *
+   * The subtree below the node is copied out of the pool in breadth-first
+   * order, the pool is cleared, and the subtree is written back from the
+   * start of the pool with its statistics intact. The chunks of every block
+   * are written one after the other, and the rest of its last chunk stays
+   * free for the next children. A block of children shared by several nodes
+   * is copied once and stays shared if it is complete, while the other nodes
+   * that share an incomplete one are expanded again. The transposition table
+   * is refilled with the new indices of the complete blocks. Must not be
+   * called while the workers are searching.
+   *
+   * @param subtree_index The index of the node that becomes the root.
+   * @param board The game state of the node.
+   */
+  void promote_subtree(std::uint32_t subtree_index, const Board& board);
 
   /**
    * @brief Selects the best child of the root node based on the highest win
@@ -338,11 +1481,53 @@ class Mcts_agent {
    * occur if the agent was given too little decision time for the board size),
    * it throws a runtime error.
    *
-   * @return A shared pointer to the child node with the highest win ratio.
+   * With RAVE, the search settles on a few children quickly and visits the
+   * others only a few times, so their win ratios are unreliable. The most
+   * visited child is returned instead.
+   *
+   * If the search was cancelled before any child could be selected, the
+   * first child is returned, which holds the first move in the order of
+   * get_child_moves().
+   *
+   * @return The index of the child node with the highest win ratio.
    * @throws std::runtime_error If no child can be selected due to insufficient
-   * statistics.
+   * statistics and the search was not cancelled.
+   */
+  std::uint32_t select_best_child();
+
+  /**
+   * @brief Returns whether the rest of the search budget cannot change the
+   * best move, or is unlikely to, so that the search can stop early.
+   *
+   * The remaining budget is the number of iterations left, or the number of
+   * iterations that fit into the time left at the rate of the search so far,
+   * whichever is lower. With RAVE, where select_best_child() chooses the
+   * most visited child of the root, the best move is settled when the
+   * runner-up could not catch up with it in visits even if it got the whole
+   * remaining budget. A lead in visits does not settle a choice by win
+   * ratio, since a less visited child can still overtake the best one on its
+   * ratio. In either case, the best move is also taken as settled when the
+   * lower Hoeffding bound on the win ratio of the best child lies above the
+   * upper bounds of all other children. This is a heuristic, since the
+   * playouts of a child are not independent samples of one win ratio while
+   * the tree below it grows, so it may rarely stop on a move that the full
+   * search would have changed.
+   *
+   * @param iteration_count The number of iterations started so far.
+   * @param max_iterations The number of iterations after which the search
+   * stops, or 0 for no limit.
+   * @param end_time The time at which the search stops, or the maximum time
+   * point if it is not timed.
+   * @param now The current time. Only read if the search is timed.
+   * @return True if the best move is settled, and false if the search has no
+   * budget to estimate or the best move might still change.
    */
-  std::shared_ptr<Node> select_best_child();
+  bool check_best_move_settled(
+      int iteration_count, int max_iterations,
+      const std::chrono::time_point<std::chrono::high_resolution_clock>&
+          end_time,
+      const std::chrono::time_point<std::chrono::high_resolution_clock>& now)
+      const;
 };
 
 #endif
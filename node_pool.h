@@ -0,0 +1,108 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/**
+ * @class Node_pool
+ *
+ * @brief A fixed-capacity arena that hands out contiguous blocks of nodes
+ * addressed by 32-bit indices.
+ *
+ * All nodes live in a single array that is allocated once, so the nodes of a
+ * search tree are stored next to each other and can link to each other by
+ * index instead of by pointer. Allocation bumps an atomic counter, so several
+ * workers can allocate at the same time without locking. Nodes are never freed
+ * one by one; clear() releases all of them at once in constant time.
+ *
+ * The node type must be trivially default constructible and trivially
+ * destructible. The array is therefore neither initialized nor destroyed
+ * element by element, and the operating system only commits the memory pages
+ * that are actually used. Allocated nodes must be initialized by the caller.
+ *
+ * @tparam Node_type The type of the nodes stored in the pool.
+ */
+template <typename Node_type>
+class Node_pool {
+  static_assert(std::is_trivially_default_constructible<Node_type>::value,
+                "Pool nodes must be trivially default constructible.");
+  static_assert(std::is_trivially_destructible<Node_type>::value,
+                "Pool nodes must be trivially destructible.");
+
+ public:
+  /**
+   * @brief The type used to address nodes in the pool.
+   */
+  using Index = std::uint32_t;
+
+  /**
+   * @brief An index that does not refer to any node, e.g. the parent of a
+   * root.
+   */
+  static constexpr Index null_index = 0xffffffff;
+
+  /**
+   * @brief Constructs an empty pool that can hold up to capacity nodes.
+   *
+   * @param capacity The maximum number of nodes that can be allocated between
+   * two calls to clear().
+   */
+  explicit Node_pool(Index capacity)
+      : nodes(new Node_type[capacity]), capacity(capacity), size(0) {}
+
+  /**
+   * @brief Allocates a contiguous block of nodes. It is safe to call from
+   * several threads at the same time.
+   *
+   * @param count The number of nodes to allocate.
+   * @return The index of the first node of the block, or null_index if the
+   * pool does not have enough room left.
+   */
+  Index allocate(Index count) {
+    Index first_index = size.fetch_add(count, std::memory_order_relaxed);
+    if (first_index > capacity || capacity - first_index < count) {
+      // The pool is full. The counter has moved past the capacity, so every
+      // later allocation fails as well until the pool is cleared.
+      size.store(capacity + 1, std::memory_order_relaxed);
+      return null_index;
+    }
+    return first_index;
+  }
+
+  /**
+   * @brief Releases all nodes at once. Must not be called while other threads
+   * are using the pool.
+   */
+  void clear() { size.store(0, std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the number of nodes currently allocated.
+   */
+  Index get_size() const {
+    Index current_size = size.load(std::memory_order_relaxed);
+    return current_size > capacity ? capacity : current_size;
+  }
+
+  /**
+   * @brief Returns the maximum number of nodes the pool can hold.
+   */
+  Index get_capacity() const { return capacity; }
+
+  Node_type& operator[](Index index) { return nodes[index]; }
+  const Node_type& operator[](Index index) const { return nodes[index]; }
+
+ private:
+  std::unique_ptr<Node_type[]> nodes;
+  Index capacity;
+  // The number of nodes handed out since the last clear. It may exceed the
+  // capacity once an allocation has failed.
+  std::atomic<Index> size;
+};
+
+template <typename Node_type>
+constexpr typename Node_pool<Node_type>::Index Node_pool<Node_type>::null_index;
+
+#endif  // NODE_POOL_H
@@ -0,0 +1,210 @@
+#include "opening_book.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The header at the start of a book file
+struct Header {
+  char magic[8];
+  // Reads as byte_order_mark only in the byte order of the writer
+  std::uint64_t byte_order;
+  std::uint32_t version;
+  std::uint32_t entry_size;
+  std::uint64_t entry_count;
+};
+
+static_assert(sizeof(Header) == 32,
+              "The header must keep the entries aligned.");
+
+constexpr char magic[8] = {'H', 'E', 'X', 'B', 'O', 'O', 'K', '\0'};
+constexpr std::uint64_t byte_order_mark = 0x0102030405060708;
+constexpr std::uint32_t version = 1;
+
+// Orders the entries by hash and board size
+bool is_before(const Opening_book::Entry& first,
+               const Opening_book::Entry& second) {
+  return first.hash < second.hash ||
+         (first.hash == second.hash && first.board_size < second.board_size);
+}
+
+}  // namespace
+
+Opening_book::Opening_book(const std::string& path) {
+#ifdef _WIN32
+  // Read the whole file, which still needs no parsing
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    throw std::runtime_error("Cannot open the opening book " + path + ".");
+  }
+  mapping_size = static_cast<std::size_t>(file.tellg());
+  file_contents.resize((mapping_size + 7) / 8);
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(file_contents.data()),
+            static_cast<std::streamsize>(mapping_size));
+  if (!file) {
+    throw std::runtime_error("Cannot read the opening book " + path + ".");
+  }
+  const void* contents = file_contents.data();
+#else
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Cannot open the opening book " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat file_status;
+  if (fstat(file, &file_status) != 0) {
+    close(file);
+    throw std::runtime_error("Cannot read the opening book " + path + ".");
+  }
+  mapping_size = static_cast<std::size_t>(file_status.st_size);
+  if (mapping_size < sizeof(Header)) {
+    close(file);
+    throw std::runtime_error(path + " is not an opening book.");
+  }
+  mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping keeps the file open
+  close(file);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("Cannot map the opening book " + path + ".");
+  }
+  const void* contents = mapping;
+#endif
+  Header header;
+  if (mapping_size >= sizeof(Header)) {
+    std::memcpy(&header, contents, sizeof(Header));
+  }
+  std::string error;
+  if (mapping_size < sizeof(Header) ||
+      std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    error = path + " is not an opening book.";
+  } else if (header.byte_order != byte_order_mark) {
+    error = path + " was written on a machine with another byte order.";
+  } else if (header.version != version || header.entry_size != sizeof(Entry) ||
+             header.entry_count !=
+                 (mapping_size - sizeof(Header)) / sizeof(Entry) ||
+             (mapping_size - sizeof(Header)) % sizeof(Entry) != 0) {
+    error = path + " is an opening book of another version or is truncated.";
+  }
+  if (!error.empty()) {
+#ifndef _WIN32
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+#endif
+    throw std::runtime_error(error);
+  }
+  // The entries follow the header, which keeps them aligned
+  entries = reinterpret_cast<const Entry*>(
+      static_cast<const char*>(contents) + sizeof(Header));
+  entry_count = static_cast<std::size_t>(header.entry_count);
+}
+
+Opening_book::~Opening_book() {
+#ifndef _WIN32
+  if (mapping) {
+    munmap(mapping, mapping_size);
+  }
+#endif
+}
+
+bool Opening_book::find_move(const Board& board,
+                             std::pair<int, int>& move) const {
+  const int board_size = board.get_board_size();
+  const Entry* entry = find_entry(board.get_hash(), board_size);
+  int move_x = 0;
+  int move_y = 0;
+  if (entry) {
+    move_x = entry->move_x;
+    move_y = entry->move_y;
+  } else {
+    // The book may hold the board rotated by half a turn, whose move has to
+    // be rotated back
+    entry = find_entry(get_rotated_hash(board), board_size);
+    if (!entry) {
+      return false;
+    }
+    move_x = board_size - 1 - entry->move_x;
+    move_y = board_size - 1 - entry->move_y;
+  }
+  // Guard against a collision of the hashes of two game states
+  if (move_x < 0 || move_x >= board_size || move_y < 0 ||
+      move_y >= board_size ||
+      board.get_cell_state(move_x, move_y) != Cell_state::Empty) {
+    return false;
+  }
+  move = std::make_pair(move_x, move_y);
+  return true;
+}
+
+std::uint64_t Opening_book::get_rotated_hash(const Board& board) {
+  const int board_size = board.get_board_size();
+  std::uint64_t hash = 0;
+  for (int x = 0; x < board_size; ++x) {
+    for (int y = 0; y < board_size; ++y) {
+      Cell_state state = board.get_cell_state(x, y);
+      if (state != Cell_state::Empty) {
+        hash ^= Board::get_zobrist_key(board_size - 1 - x, board_size - 1 - y,
+                                       state);
+      }
+    }
+  }
+  return hash;
+}
+
+void Opening_book::write(const std::string& path,
+                         std::vector<Entry> entries) {
+  // Sort by game state, with the longest search of each state first
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& first, const Entry& second) {
+              if (first.hash != second.hash ||
+                  first.board_size != second.board_size) {
+                return is_before(first, second);
+              }
+              return first.iterations > second.iterations;
+            });
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const Entry& first, const Entry& second) {
+                              return first.hash == second.hash &&
+                                     first.board_size == second.board_size;
+                            }),
+                entries.end());
+  Header header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.byte_order = byte_order_mark;
+  header.version = version;
+  header.entry_size = sizeof(Entry);
+  header.entry_count = entries.size();
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+  file.close();
+  if (!file) {
+    throw std::runtime_error("Cannot write the opening book " + path + ".");
+  }
+}
+
+const Opening_book::Entry* Opening_book::find_entry(std::uint64_t hash,
+                                                    int board_size) const {
+  Entry key = Entry();
+  key.hash = hash;
+  key.board_size = static_cast<std::uint8_t>(board_size);
+  const Entry* end = entries + entry_count;
+  const Entry* entry = std::lower_bound(entries, end, key, is_before);
+  if (entry == end || entry->hash != hash || entry->board_size != board_size) {
+    return nullptr;
+  }
+  return entry;
+}
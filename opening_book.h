@@ -0,0 +1,114 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+
+/**
+ * @class Opening_book
+ *
+ * @brief A read-only table of the moves that long searches chose for early
+ * game states, which a player looks up before searching.
+ *
+ * A book is a binary file that starts with a header and holds one entry of
+ * 16 bytes per game state, sorted by the Zobrist hash of the state and the
+ * board size. The file is mapped into memory, on POSIX systems with mmap(),
+ * and the entries are searched in place with a binary search. Opening a book
+ * therefore neither reads nor parses the entries, and takes the same time
+ * for a million entries as for ten. Pages that are never looked up are never
+ * loaded.
+ *
+ * A board and the board rotated by half a turn are the same game state for
+ * both players, so a book only holds one of them, and find_move() also looks
+ * up the rotated board.
+ *
+ * The entries are stored in the byte order of the machine that wrote them,
+ * so that they can be used without conversion. A book written on a machine
+ * with the other byte order is rejected.
+ *
+ * The book is non-copyable. Its destructor unmaps the file.
+ */
+class Opening_book {
+ public:
+  /**
+   * @brief The move chosen for one game state.
+   */
+  struct Entry {
+    // The Zobrist hash of the stones, see Board::get_hash()
+    std::uint64_t hash;
+    // The number of iterations of the search that chose the move
+    std::uint32_t iterations;
+    std::uint8_t board_size;
+    std::int8_t move_x;
+    std::int8_t move_y;
+    std::uint8_t reserved;
+  };
+
+  static_assert(sizeof(Entry) == 16, "An entry must occupy 16 bytes.");
+
+  /**
+   * @brief Maps a book into memory.
+   *
+   * @param path The path of the book file.
+   *
+   * @throws std::runtime_error if the file cannot be opened or mapped, or if
+   * it is not a book in the byte order of this machine.
+   */
+  explicit Opening_book(const std::string& path);
+
+  ~Opening_book();
+
+  Opening_book(const Opening_book&) = delete;
+  Opening_book& operator=(const Opening_book&) = delete;
+
+  /**
+   * @brief Looks up the move for a game state. It is safe to call from
+   * several threads at the same time.
+   *
+   * @param board The game state, whose stones must have been placed with
+   * make_move().
+   * @param move Receives the move if the book holds the state.
+   * @return True if the book holds a move for the state that is valid on the
+   * board, else False.
+   */
+  bool find_move(const Board& board, std::pair<int, int>& move) const;
+
+  /**
+   * @brief Returns the number of game states in the book.
+   */
+  std::size_t get_entry_count() const { return entry_count; }
+
+  /**
+   * @brief Returns the hash of a board rotated by half a turn.
+   */
+  static std::uint64_t get_rotated_hash(const Board& board);
+
+  /**
+   * @brief Writes a book. The entries are sorted, and of several entries for
+   * the same game state, the one with the most iterations is kept.
+   *
+   * @param path The path of the book file, which is replaced.
+   * @param entries The entries of the book.
+   *
+   * @throws std::runtime_error if the file cannot be written.
+   */
+  static void write(const std::string& path, std::vector<Entry> entries);
+
+ private:
+  // Looks up the entry of a hash and board size, or returns nullptr
+  const Entry* find_entry(std::uint64_t hash, int board_size) const;
+
+  const Entry* entries = nullptr;
+  std::size_t entry_count = 0;
+  // The mapped file, or on Windows, the file read into memory
+  void* mapping = nullptr;
+  std::size_t mapping_size = 0;
+  std::vector<std::uint64_t> file_contents;
+};
+
+#endif  // OPENING_BOOK_H
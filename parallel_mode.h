@@ -0,0 +1,25 @@
+#ifndef PARALLEL_MODE_H
+#define PARALLEL_MODE_H
+
+/**
+ * @enum Parallel_mode
+ * @brief Selects how the workers of a parallelized Mcts_agent share the
+ * search.
+ *
+ * Enumeration values:
+ * @value Shared_tree All workers grow one tree together, spreading out over
+ * its branches with virtual loss. Every iteration profits from all earlier
+ * ones, but the workers write to the same memory.
+ * @value Root_trees Every worker grows a private tree with its own random
+ * number generator, and the visit and win counts of the children of the
+ * roots are summed once all workers have finished. The workers never write to
+ * shared memory while they search, so the search scales almost linearly with
+ * the cores, also across the sockets of a NUMA machine, at the price of
+ * shallower trees.
+ */
+enum class Parallel_mode {
+  Shared_tree,  ///< All workers search one tree.
+  Root_trees    ///< Every worker searches its own tree.
+};
+
+#endif  // PARALLEL_MODE_H
@@ -2,8 +2,10 @@
 
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
 
 #include "mcts_agent.h"
+#include "opening_book.h"
 
 std::pair<int, int> Human_player::choose_move(const Board& board,
                                               Cell_state player) {
@@ -41,18 +43,68 @@ std::pair<int, int> Human_player::choose_move(const Board& board,
 }
 
 Mcts_player::Mcts_player(double exploration_factor,
-                         std::chrono::milliseconds max_decision_time,
-                         bool is_parallelized, bool is_verbose)
+                         const Search_limits& search_limits,
+                         bool is_parallelized, bool is_verbose,
+                         Playout_mode playout_mode, bool is_pondering,
+                         double rave_equivalence, Parallel_mode parallel_mode,
+                         std::shared_ptr<Cluster_link> cluster_link,
+                         std::shared_ptr<const Opening_book> opening_book)
     : exploration_factor(exploration_factor),
-      max_decision_time(max_decision_time),
+      search_limits(search_limits),
       is_parallelized(is_parallelized),
-      is_verbose(is_verbose) {}
+      is_verbose(is_verbose),
+      playout_mode(playout_mode),
+      is_pondering(is_pondering),
+      opening_book(std::move(opening_book)),
+      agent(std::make_unique<Mcts_agent>(exploration_factor, search_limits,
+                                         is_parallelized, is_verbose,
+                                         playout_mode, 0, rave_equivalence,
+                                         nullptr, 0, parallel_mode,
+                                         std::move(cluster_link))) {
+  if (is_pondering && is_verbose) {
+    throw std::logic_error(
+        "Pondering and verbose mode do not make sense together.");
+  }
+}
+
+Mcts_player::~Mcts_player() = default;
 
 std::pair<int, int> Mcts_player::choose_move(const Board& board,
                                              Cell_state player) {
-  Mcts_agent agent(exploration_factor, max_decision_time, is_parallelized,
-                   is_verbose);
-  return agent.choose_move(board, player);
+  // Look the game state up before searching it
+  std::pair<int, int> move;
+  if (!opening_book || !opening_book->find_move(board, move)) {
+    move = agent->choose_move(board, player);
+  }
+  if (is_pondering) {
+    // Think about the opponent's reply while the opponent does
+    Board next_board = board;
+    next_board.make_move(move.first, move.second, player);
+    agent->start_pondering(next_board, get_opponent(player));
+  }
+  return move;
+}
+
+std::future<std::pair<int, int>> Mcts_player::start_choosing_move(
+    const Board& board, Cell_state player) {
+  std::pair<int, int> move;
+  if (!opening_book || !opening_book->find_move(board, move)) {
+    return agent->start_choosing_move(board, player, is_pondering);
+  }
+  if (is_pondering) {
+    Board next_board = board;
+    next_board.make_move(move.first, move.second, player);
+    agent->start_pondering(next_board, get_opponent(player));
+  }
+  std::promise<std::pair<int, int>> promise;
+  promise.set_value(move);
+  return promise.get_future();
+}
+
+void Mcts_player::cancel_search() { agent->cancel_search(); }
+
+Search_progress Mcts_player::get_search_progress() const {
+  return agent->get_search_progress();
 }
 
 bool Mcts_player::get_is_verbose() const { return is_verbose; }
\ No newline at end of file
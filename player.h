@@ -2,9 +2,19 @@
 #define PLAYER_H
 
 #include <chrono>
+#include <future>
+#include <memory>
 #include <utility>
 
 #include "board.h"
+#include "parallel_mode.h"
+#include "playout_mode.h"
+#include "search_limits.h"
+#include "search_statistics.h"
+
+class Cluster_link;
+class Mcts_agent;
+class Opening_book;
 
 /**
  * @brief Player serves as an abstract base class providing a contract for all
@@ -19,6 +29,8 @@
  */
 class Player {
  public:
+  virtual ~Player() = default;
+
   /**
    * @brief Abstract function for choosing a move on the game board.
    * @param board Current state of the game board (Board).
@@ -61,30 +73,57 @@ class Human_player : public Player {
  *
  * The choose_move() function is implemented to utilize an MCTS agent for
  * determining the best move. This is based on the exploration factor, maximum
- * decision time, and whether computations are parallelized and verbose logging
- * is enabled. All these parameters are customizable during the instantiation
- * of a Mcts_player.
+ * decision time, whether computations are parallelized and verbose logging is
+ * enabled, and the playout mode. All these parameters are customizable during
+ * the instantiation of a Mcts_player.
  */
 class Mcts_player : public Player {
  public:
   /**
    * @brief Constructor for the Mcts_player class.
-   * It initializes the exploration factor, maximum decision time, whether
-   * computations are parallelized, and whether verbose logging is enabled.
+   * It initializes the exploration factor, search limits, whether
+   * computations are parallelized, and whether verbose logging is enabled, and
+   * creates the agent that is used for all moves of the player.
    *
    * @param exploration_factor The exploration factor used in MCTS.
-   * @param max_decision_time The maximum time allowed for decision making.
+   * @param search_limits When the agent stops searching for a move, e.g. after
+   * a maximum time allowed for decision making.
    * @param is_parallelized If true, MCTS computations are parallelized.
    * @param is_verbose If true, verbose logging is enabled.
+   * @param playout_mode Selects how the agent simulates random playouts.
+   * @param is_pondering If true, the agent keeps searching in the background
+   * after each move until the opponent has replied.
+   * @param rave_equivalence Enables RAVE in the agent if it is positive, see
+   * Mcts_agent::Mcts_agent().
+   * @param parallel_mode Selects whether the parallelized agent searches one
+   * shared tree or one private tree per worker.
+   * @param cluster_link Lets the agent search every move together with the
+   * agents on other machines if it is given.
+   * @param opening_book The book whose moves are played without searching,
+   * as long as it holds the game state, or nullptr. It can be shared by
+   * several players.
+   *
+   * @throws std::logic_error if is_pondering and is_verbose are both true.
    */
   Mcts_player(double exploration_factor,
-              std::chrono::milliseconds max_decision_time,
-              bool is_parallelized = false, bool is_verbose = false);
+              const Search_limits& search_limits,
+              bool is_parallelized = false, bool is_verbose = false,
+              Playout_mode playout_mode = Playout_mode::Move_by_move,
+              bool is_pondering = false, double rave_equivalence = 0.,
+              Parallel_mode parallel_mode = Parallel_mode::Shared_tree,
+              std::shared_ptr<Cluster_link> cluster_link = nullptr,
+              std::shared_ptr<const Opening_book> opening_book = nullptr);
+
+  ~Mcts_player() override;
 
   /**
    * @brief Implementation of the choose_move function for the Mcts_player
-   * class. This function uses the MCTS agent to choose a move. New instances of
-   * the agent are created for each move, so the agent's tree is not preserved.
+   * class. This function uses the MCTS agent to choose a move. The same agent
+   * is kept for the whole game, so the part of its tree that follows the moves
+   * actually played, including the opponent's reply, is reused for the next
+   * decision. In ponder mode, the agent then searches the position after the
+   * chosen move in the background until this function is called again. If
+   * the opening book holds the game state, its move is played right away.
    *
    * @param board The current state of the game board.
    * @param player The current player.
@@ -93,6 +132,33 @@ class Mcts_player : public Player {
   std::pair<int, int> choose_move(const Board& board,
                                   Cell_state player) override;
 
+  /**
+   * @brief Starts choosing a move like choose_move() and returns right away,
+   * see Mcts_agent::start_choosing_move(). A move from the opening book is
+   * ready at once. The player must not be used otherwise until the future
+   * is ready, except for cancel_search() and get_search_progress().
+   *
+   * @param board The current state of the game board.
+   * @param player The current player.
+   * @return The future of the move.
+   * @throws std::logic_error If the move is searched and the agent is in
+   * verbose mode.
+   */
+  std::future<std::pair<int, int>> start_choosing_move(const Board& board,
+                                                       Cell_state player);
+
+  /**
+   * @brief Ends the running search early, so that its move is the best one
+   * so far, see Mcts_agent::cancel_search(). It is thread-safe.
+   */
+  void cancel_search();
+
+  /**
+   * @brief Returns the best move of the running search so far, see
+   * Mcts_agent::get_search_progress(). It is thread-safe.
+   */
+  Search_progress get_search_progress() const;
+
   /**
    * @brief Getter for the is_verbose private member of the Mcts_player class.
    *
@@ -102,9 +168,13 @@ class Mcts_player : public Player {
 
  private:
   double exploration_factor;  // The exploration factor used in MCTS.
-  std::chrono::milliseconds max_decision_time;  // Maximum decision-making time.
+  Search_limits search_limits;  // When the agent stops searching.
   bool is_parallelized;  // If true, MCTS computations are parallelized.
   bool is_verbose;       // If true, enables verbose logging to console.
+  Playout_mode playout_mode;  // How the agent simulates random playouts.
+  bool is_pondering;  // If true, searches during the opponent's turn.
+  std::shared_ptr<const Opening_book> opening_book;  // Or nullptr.
+  std::unique_ptr<Mcts_agent> agent;  // Keeps its tree between moves.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef PLAYOUT_MODE_H
+#define PLAYOUT_MODE_H
+
+/**
+ * @enum Playout_mode
+ * @brief Selects how the Mcts_agent plays a random game out from a node.
+ *
+ * The first two modes produce the same distribution of winners: playing
+ * uniformly random moves until the board is full amounts to assigning the
+ * empty cells in a uniformly random order, and in Hex a full board always has
+ * exactly one winner, who is also the first player to have connected their
+ * edges. Uniformly random playouts are noisy, though, since they let the
+ * opponent cut bridges that any player would keep. The third mode answers
+ * such intrusions, so its playouts are closer to real games and fewer of them
+ * are needed for the same decision, at a small cost per move.
+ *
+ * Enumeration values:
+ * @value Move_by_move Random moves are made one at a time and the board is
+ * checked for a winner after each of them.
+ * @value Fill_and_evaluate The empty cells are shuffled once and filled
+ * alternately by both players, and the winner is determined once on the full
+ * board.
+ * @value Bridge_responses Moves are made one at a time like Move_by_move, but
+ * a player whose bridge the opponent has just intruded into restores it, see
+ * Playout_patterns. Other moves are random.
+ */
+enum class Playout_mode {
+  Move_by_move,       ///< Check for a winner after every random move.
+  Fill_and_evaluate,  ///< Fill the whole board, then check for a winner once.
+  Bridge_responses    ///< Answer bridge intrusions, otherwise move randomly.
+};
+
+#endif  // PLAYOUT_MODE_H
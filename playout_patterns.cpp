@@ -0,0 +1,90 @@
+#include "playout_patterns.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr int Playout_patterns::pattern_count;
+
+namespace {
+
+// The offsets of the six neighbours in ring order, as in Hex_adjacency
+constexpr int neighbour_offset_x[Hex_adjacency::direction_count] = {
+    -1, -1, 0, 1, 1, 0};
+
+// Returns the 2 bits of a direction in a pattern
+int get_neighbour_code(int pattern, int direction) {
+  return (pattern >> (2 * (direction % Hex_adjacency::direction_count))) & 3;
+}
+
+}  // namespace
+
+Playout_patterns::Playout_patterns(int board_size)
+    : adjacency(&Hex_adjacency::for_board_size(board_size)), edge_patterns() {
+  // Built on first use. The initialization of a local static is thread-safe.
+  static const Response_table response_table = []() {
+    Response_table table = Response_table();
+    for (int player_index = 0; player_index < 2; ++player_index) {
+      const int own_code = static_cast<int>(
+          player_index == 0 ? Cell_state::Blue : Cell_state::Red);
+      for (int pattern = 0; pattern < pattern_count; ++pattern) {
+        std::uint8_t response_mask = 0;
+        // Own stones or edges two steps apart with an empty cell between
+        // them were bridged through the cell of the last move
+        for (int direction = 0; direction < Hex_adjacency::direction_count;
+             ++direction) {
+          if (get_neighbour_code(pattern, direction) == own_code &&
+              get_neighbour_code(pattern, direction + 1) ==
+                  static_cast<int>(Cell_state::Empty) &&
+              get_neighbour_code(pattern, direction + 2) == own_code) {
+            response_mask = static_cast<std::uint8_t>(
+                response_mask |
+                1 << ((direction + 1) % Hex_adjacency::direction_count));
+          }
+        }
+        table[player_index][pattern] = response_mask;
+      }
+    }
+    return table;
+  }();
+  responses = &response_table;
+  // Blue owns the top and bottom edges and Red the left and right edges. A
+  // direction that leaves a corner across both counts for Blue.
+  for (int cell_index = 0; cell_index < board_size * board_size;
+       ++cell_index) {
+    const int x = adjacency->get_row(cell_index);
+    const Hex_adjacency::Neighbours& neighbours =
+        adjacency->get_neighbours(cell_index);
+    std::uint16_t pattern = 0;
+    for (int direction = 0; direction < Hex_adjacency::direction_count;
+         ++direction) {
+      if (neighbours[direction] != Hex_adjacency::off_board) {
+        continue;
+      }
+      const int neighbour_x = x + neighbour_offset_x[direction];
+      const Cell_state edge_player =
+          neighbour_x < 0 || neighbour_x >= board_size ? Cell_state::Blue
+                                                       : Cell_state::Red;
+      pattern = static_cast<std::uint16_t>(
+          pattern | static_cast<int>(edge_player) << (2 * direction));
+    }
+    edge_patterns[cell_index] = pattern;
+  }
+}
+
+const Playout_patterns& Playout_patterns::for_board_size(int board_size) {
+  // Built on first use. The initialization of a local static is thread-safe.
+  static const std::vector<Playout_patterns> tables = []() {
+    std::vector<Playout_patterns> all_tables;
+    all_tables.reserve(Hex_adjacency::max_board_size - 1);
+    for (int size = 2; size <= Hex_adjacency::max_board_size; ++size) {
+      all_tables.emplace_back(size);
+    }
+    return all_tables;
+  }();
+  if (board_size < 2 || board_size > Hex_adjacency::max_board_size) {
+    throw std::invalid_argument("There are no playout patterns for size " +
+                                std::to_string(board_size) + ".");
+  }
+  return tables[board_size - 2];
+}
@@ -0,0 +1,113 @@
+#ifndef PLAYOUT_PATTERNS_H
+#define PLAYOUT_PATTERNS_H
+
+#include <array>
+#include <cstdint>
+
+#include "cell_state.h"
+#include "hex_adjacency.h"
+
+/**
+ * @class Playout_patterns
+ *
+ * @brief Precomputed tables that tell a playout which cells around the last
+ * move restore a bridge of the player to move, for one board size.
+ *
+ * Two stones of a player form a bridge if they share two empty neighbours:
+ * whichever of them the opponent takes, the player takes the other and stays
+ * connected. Around the cell of an intrusion, the two stones are the
+ * neighbours two steps apart in ring order, see Hex_adjacency, and the
+ * other shared cell is the neighbour between them. An edge of the board
+ * counts as a stone of the player whose edge it is, so that a stone on the
+ * second row is also saved when the opponent cuts its bridge to the edge.
+ *
+ * The six neighbours of a cell form a pattern of 2 bits each, the
+ * Cell_state of the neighbour or the player of the edge beyond it, with
+ * direction d at bits 2d and 2d + 1. The patterns are looked up in a table
+ * of 4096 entries per player, each a mask of the directions that answer an
+ * intrusion, so a playout only pays for six reads and one lookup per move.
+ *
+ * The tables of all supported sizes are built once, on first use, and shared
+ * by all threads. They are never modified afterwards.
+ */
+class Playout_patterns {
+ public:
+  /**
+   * @brief The number of distinct patterns of six neighbours.
+   */
+  static constexpr int pattern_count = 1
+                                       << (2 * Hex_adjacency::direction_count);
+
+  /**
+   * @brief Returns the shared tables for a board size. It is thread-safe.
+   *
+   * @param board_size The side length of the board, from 2 to
+   * Hex_adjacency::max_board_size.
+   * @return The tables, which live until the program ends.
+   * @throws std::invalid_argument If there is no table for the size.
+   */
+  static const Playout_patterns& for_board_size(int board_size);
+
+  /**
+   * @brief Returns the pattern of the neighbours of a cell.
+   *
+   * @param cell_states The Cell_state of every cell of the board, by cell
+   * index.
+   * @param cell_index The index of the cell.
+   */
+  std::uint16_t get_pattern(const std::uint8_t* cell_states,
+                            int cell_index) const {
+    std::uint16_t pattern = edge_patterns[cell_index];
+    const Hex_adjacency::Neighbours& neighbours =
+        adjacency->get_neighbours(cell_index);
+    for (int direction = 0; direction < Hex_adjacency::direction_count;
+         ++direction) {
+      if (neighbours[direction] != Hex_adjacency::off_board) {
+        pattern = static_cast<std::uint16_t>(
+            pattern | cell_states[neighbours[direction]] << (2 * direction));
+      }
+    }
+    return pattern;
+  }
+
+  /**
+   * @brief Returns the directions from the last move that restore a bridge
+   * of the player to move, as a mask with bit d for direction d. The cells
+   * in these directions are always empty.
+   *
+   * @param player The player to move, Blue or Red.
+   * @param pattern The pattern around the opponent's last move, see
+   * get_pattern().
+   */
+  std::uint8_t get_responses(Cell_state player, std::uint16_t pattern) const {
+    return (*responses)[player == Cell_state::Blue ? 0 : 1][pattern];
+  }
+
+  /**
+   * @brief Returns the adjacency table of the board size.
+   */
+  const Hex_adjacency& get_adjacency() const { return *adjacency; }
+
+  /**
+   * @brief Builds the tables for a board size. Use for_board_size() to get
+   * the shared tables instead.
+   *
+   * @param board_size The side length of the board, from 2 to
+   * Hex_adjacency::max_board_size.
+   */
+  explicit Playout_patterns(int board_size);
+
+ private:
+  // The responses of Blue and Red to every pattern, which are the same for
+  // all board sizes
+  using Response_table =
+      std::array<std::array<std::uint8_t, pattern_count>, 2>;
+
+  const Hex_adjacency* adjacency;
+  const Response_table* responses;
+  // The bits of the edges beyond every cell, to which get_pattern() adds
+  // the neighbours on the board
+  std::array<std::uint16_t, Hex_adjacency::max_cells> edge_patterns;
+};
+
+#endif  // PLAYOUT_PATTERNS_H
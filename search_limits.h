@@ -0,0 +1,110 @@
+#ifndef SEARCH_LIMITS_H
+#define SEARCH_LIMITS_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @struct Search_limits
+ * @brief Determines when the Mcts_agent stops searching for a move.
+ *
+ * Every limit that is set stops the search once it is reached, so the limits
+ * can be used on their own or combined, in which case the search stops at the
+ * first one that is reached. A value of zero leaves a limit unset. The decision
+ * time or the number of iterations must be set. The number of tree nodes
+ * cannot limit the search on its own, since the tree stops growing once the
+ * leaves that the search reaches all end the game, which may happen before
+ * it is full.
+ *
+ * A search limited only by iterations, with or without a number of tree
+ * nodes, does not depend on the speed of the machine, so with a fixed random
+ * seed, a single-threaded agent always chooses the same move.
+ *
+ * A single duration converts implicitly to limits that only restrict the
+ * decision time.
+ *
+ * The limits also bound the memory of the search, through the number of tree
+ * nodes and the size of the transposition table.
+ */
+struct Search_limits {
+  /**
+   * @brief The maximum time allowed for making a decision.
+   */
+  std::chrono::milliseconds max_decision_time{0};
+
+  /**
+   * @brief The maximum number of MCTS iterations, i.e. playouts, per decision,
+   * counted over all workers.
+   */
+  int max_iterations = 0;
+
+  /**
+   * @brief The maximum number of nodes in the search tree, which caps the
+   * memory used by the tree. Only created nodes are counted, and the chunks
+   * that children are allocated in hold room for at most about as many more.
+   * The search stops once the tree is full.
+   */
+  std::uint32_t max_tree_nodes = 0;
+
+  /**
+   * @brief The number of entries of the transposition table, which lets game
+   * states that are reached by different move orders share their children
+   * and the statistics below them. Every entry takes
+   * Transposition_table::bytes_per_entry bytes, and the number is rounded
+   * down to a power of two. If it is 0, no table is used, and every path
+   * through the tree leads to nodes of its own.
+   */
+  std::uint32_t transposition_table_entries = 0;
+
+  /**
+   * @brief Enables progressive widening if positive. A node with n visits
+   * then only lets the search choose among its first
+   * ceil(widening_factor * n ^ widening_exponent) children, in the order in
+   * which the agent creates them, see Mcts_agent::get_child_moves(). The
+   * root widens in the same way, although it has all its children from the
+   * start. If it is 0, every move of a node can be chosen once the node is
+   * visited.
+   */
+  double widening_factor = 0.;
+
+  /**
+   * @brief How fast the number of children grows with the visits of a node
+   * under progressive widening, from 0 (never) to 1 (as fast as the visits).
+   */
+  double widening_exponent = 0.5;
+
+  /**
+   * @brief The number of iterations a worker runs between two reads of the
+   * clock. Higher values make the clock cheaper, at the price of overrunning
+   * the decision time by up to that many iterations.
+   */
+  int time_check_interval = 16;
+
+  /**
+   * @brief Whether the search may stop before its budget is used up once the
+   * best move is unlikely to change.
+   *
+   * The search then stops when a confidence bound on the win ratios
+   * separates the best child of the root from all others, or, with RAVE,
+   * where the most visited child is chosen, when it leads the runner-up by
+   * more visits than the remaining budget can still give to the runner-up.
+   * The confidence bound is a heuristic that may rarely stop on a move that
+   * the full search would have changed. The remaining budget is estimated
+   * from the iterations left and from the rate of the search so far, so the
+   * rule needs a decision time or a number of iterations. It is checked once
+   * per time check interval.
+   */
+  bool is_early_stop_enabled = false;
+
+  Search_limits() = default;
+
+  /**
+   * @brief Creates limits that only restrict the decision time.
+   *
+   * @param max_decision_time The maximum time allowed for making a decision.
+   */
+  Search_limits(std::chrono::milliseconds max_decision_time)
+      : max_decision_time(max_decision_time) {}
+};
+
+#endif  // SEARCH_LIMITS_H
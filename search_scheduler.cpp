@@ -0,0 +1,123 @@
+#include "search_scheduler.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "mcts_agent.h"
+
+Search_scheduler::Search_scheduler(unsigned int thread_count,
+                                   std::chrono::milliseconds slice_duration)
+    : slice_duration(slice_duration) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  workers.reserve(thread_count);
+  for (unsigned int i = 0; i < thread_count; ++i) {
+    workers.emplace_back(&Search_scheduler::worker_loop, this);
+  }
+}
+
+Search_scheduler::~Search_scheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_stopping = true;
+    // The remaining slices return right away with the best moves so far
+    for (Mcts_agent* agent : scheduled_agents) {
+      agent->cancel_search();
+    }
+  }
+  search_available.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::future<std::pair<int, int>> Search_scheduler::choose_move(
+    Mcts_agent& agent, const Board& board, Cell_state player) {
+  if (agent.is_parallelized || agent.cluster_link) {
+    throw std::invalid_argument(
+        "Only serial agents without a cluster can be scheduled.");
+  }
+  if (agent.is_verbose) {
+    throw std::logic_error(
+        "Scheduled searches and verbose mode do not make sense together.");
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!scheduled_agents.insert(&agent).second) {
+      throw std::invalid_argument("The agent is already searching a move.");
+    }
+  }
+  // Take over the tree grown while pondering, if any
+  try {
+    agent.stop_pondering();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    scheduled_agents.erase(&agent);
+    throw;
+  }
+  agent.set_stop_requested(false);
+  std::unique_ptr<Scheduled_search> search =
+      std::make_unique<Scheduled_search>(agent, board, player);
+  std::future<std::pair<int, int>> future = search->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    searches.push_back(std::move(search));
+  }
+  search_available.notify_one();
+  return future;
+}
+
+unsigned int Search_scheduler::get_number_of_threads() const {
+  return static_cast<unsigned int>(workers.size());
+}
+
+void Search_scheduler::worker_loop() {
+  while (true) {
+    std::unique_ptr<Scheduled_search> search;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      search_available.wait(
+          lock, [this]() { return is_stopping || !searches.empty(); });
+      if (searches.empty()) {
+        return;
+      }
+      search = std::move(searches.front());
+      searches.pop_front();
+    }
+    // Run one slice outside of the lock
+    Mcts_agent& agent = *search->agent;
+    bool is_finished = true;
+    std::pair<int, int> move;
+    std::exception_ptr exception;
+    try {
+      if (!search->is_started) {
+        agent.begin_move(search->board, search->player);
+        search->is_started = true;
+      }
+      is_finished = agent.continue_move(slice_duration);
+      if (is_finished) {
+        Search_statistics statistics;
+        move = agent.end_move(statistics);
+      }
+    } catch (...) {
+      exception = std::current_exception();
+      is_finished = true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!is_finished) {
+        searches.push_back(std::move(search));
+        continue;
+      }
+      // The agent can be scheduled again as soon as the future is ready
+      scheduled_agents.erase(&agent);
+    }
+    if (exception) {
+      search->promise.set_exception(exception);
+    } else {
+      search->promise.set_value(move);
+    }
+  }
+}
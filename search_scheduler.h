@@ -0,0 +1,133 @@
+#ifndef SEARCH_SCHEDULER_H
+#define SEARCH_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "cell_state.h"
+
+class Mcts_agent;
+
+/**
+ * @class Search_scheduler
+ *
+ * @brief A fixed set of threads that searches the moves of many serial
+ * agents at the same time, e.g. of all games a server hosts, in slices of
+ * time.
+ *
+ * choose_move() queues the search of a move and returns a future right
+ * away. Every thread takes the search at the front of the queue, runs its
+ * iterations for one slice, and puts it back at the end unless the search
+ * has reached its limits, in which case the future receives the move. So
+ * the threads are shared round-robin among all pending searches, however
+ * many there are, instead of one dedicated thread per game.
+ *
+ * The searches keep their own limits. A decision time is wall-clock time
+ * from the call to choose_move(), including the time a search waits in the
+ * queue, so with more pending searches than threads, every search gets
+ * fewer iterations within its time. The search of an agent can be ended
+ * early with Mcts_agent::cancel_search(), and watched with
+ * Mcts_agent::get_search_progress(), from any thread. Unlike
+ * Mcts_agent::choose_move(), the searches print nothing, so the output of
+ * many games is not interleaved.
+ *
+ * The scheduler is non-copyable and non-movable. Its destructor cancels the
+ * pending searches, whose futures then receive the best moves so far, and
+ * joins the threads.
+ */
+class Search_scheduler {
+ public:
+  /**
+   * @brief Constructs a scheduler and starts its threads.
+   *
+   * @param thread_count The number of threads. If it is 0, one thread per
+   * hardware thread is started.
+   * @param slice_duration The time a search runs before another search gets
+   * the thread. Shorter slices spread the threads more evenly, longer ones
+   * switch less often.
+   */
+  explicit Search_scheduler(
+      unsigned int thread_count = 0,
+      std::chrono::milliseconds slice_duration = std::chrono::milliseconds(10));
+
+  /**
+   * @brief Cancels the pending searches and joins the threads.
+   */
+  ~Search_scheduler();
+
+  // Non-copyable and non-movable
+  Search_scheduler(const Search_scheduler&) = delete;
+  Search_scheduler& operator=(const Search_scheduler&) = delete;
+  Search_scheduler(Search_scheduler&&) = delete;
+  Search_scheduler& operator=(Search_scheduler&&) = delete;
+
+  /**
+   * @brief Queues the search of a move like Mcts_agent::choose_move() and
+   * returns without waiting for it.
+   *
+   * The agent continues from its tree like in choose_move(), and stops
+   * pondering first. It must outlive the search and must not be used
+   * otherwise until the future is ready, except for cancel_search() and
+   * get_search_progress().
+   *
+   * @param agent The agent that searches, which must be serial and have no
+   * cluster link.
+   * @param board The current game state. It is copied.
+   * @param player The player for whom the move is being chosen.
+   * @return The future of the move. It holds the exception instead if the
+   * search throws one.
+   * @throws std::invalid_argument If the agent is parallelized, has a
+   * cluster link, or is already searching a move of this scheduler.
+   * @throws std::logic_error If the agent is in verbose mode, since the log
+   * may only be written by one thread at a time.
+   */
+  std::future<std::pair<int, int>> choose_move(Mcts_agent& agent,
+                                               const Board& board,
+                                               Cell_state player);
+
+  /**
+   * @brief Returns the number of threads.
+   */
+  unsigned int get_number_of_threads() const;
+
+ private:
+  // A move that is being searched slice by slice
+  struct Scheduled_search {
+    Scheduled_search(Mcts_agent& agent, const Board& board, Cell_state player)
+        : agent(&agent), board(board), player(player) {}
+
+    Mcts_agent* agent;
+    Board board;
+    Cell_state player;
+    std::promise<std::pair<int, int>> promise;
+    bool is_started = false;
+  };
+
+  /**
+   * @brief The loop executed by every thread: take the next search, run one
+   * slice of it and queue it again, until the scheduler is stopped and no
+   * search is left.
+   */
+  void worker_loop();
+
+  const std::chrono::milliseconds slice_duration;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable search_available;
+  // The searches waiting for a thread, in the order in which they get one
+  std::deque<std::unique_ptr<Scheduled_search>> searches;
+  // The agents whose searches are waiting or running
+  std::unordered_set<Mcts_agent*> scheduled_agents;
+  bool is_stopping = false;
+};
+
+#endif  // SEARCH_SCHEDULER_H
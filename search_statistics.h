@@ -0,0 +1,166 @@
+#ifndef SEARCH_STATISTICS_H
+#define SEARCH_STATISTICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct Worker_statistics
+ * @brief What one worker of the Mcts_agent did during a search.
+ *
+ * Every worker counts into its own copy without any synchronisation, and the
+ * copies are only combined once the search is over, so the counters are cheap
+ * enough to be always on. The phase times are estimated from a sample of the
+ * iterations, which are timed with a steady clock, while all counts are
+ * exact.
+ */
+struct Worker_statistics {
+  /**
+   * @brief The number of iterations the worker completed.
+   */
+  int iterations = 0;
+
+  /**
+   * @brief The length of the longest path from the root to the node that a
+   * playout started from, and the sum of the lengths of all such paths.
+   */
+  int max_depth = 0;
+  std::int64_t total_depth = 0;
+
+  /**
+   * @brief The time spent descending the tree from the root to a leaf.
+   */
+  std::chrono::nanoseconds selection_time{0};
+
+  /**
+   * @brief The time spent checking the leaf for a winner, expanding it and
+   * stepping into one of its new children.
+   */
+  std::chrono::nanoseconds expansion_time{0};
+
+  /**
+   * @brief The time spent on playouts, or on waiting for the leaf evaluator
+   * to evaluate the leaves.
+   */
+  std::chrono::nanoseconds simulation_time{0};
+
+  /**
+   * @brief The time spent updating the statistics along the paths.
+   */
+  std::chrono::nanoseconds backpropagation_time{0};
+
+  /**
+   * @brief The number of times the worker reached a leaf that another worker
+   * was expanding or had just expanded, so that it lost the race to claim
+   * the expansion. The search takes no locks, so this is where workers
+   * contend.
+   */
+  int expansion_collisions = 0;
+
+  /**
+   * @brief The number of expansions that failed because the tree was full.
+   */
+  int failed_expansions = 0;
+
+  /**
+   * @brief The number of leaves that took over the children of the same game
+   * state reached by another move order from the transposition table, instead
+   * of creating children of their own.
+   */
+  int transposition_hits = 0;
+
+  /**
+   * @brief The number of batches of leaves the worker handed to the leaf
+   * evaluator and waited for. Zero without an evaluator.
+   */
+  int evaluation_waits = 0;
+};
+
+/**
+ * @struct Search_statistics
+ * @brief A summary of one search of the Mcts_agent, returned alongside the
+ * chosen move.
+ */
+struct Search_statistics {
+  /**
+   * @brief The number of iterations, i.e. playouts, of all workers.
+   */
+  int iterations = 0;
+
+  /**
+   * @brief The wall-clock time of the search.
+   */
+  std::chrono::nanoseconds elapsed_time{0};
+
+  /**
+   * @brief The iterations per second of wall-clock time.
+   */
+  double playouts_per_second = 0.;
+
+  /**
+   * @brief The longest and the average length of the paths from the root to
+   * the nodes that playouts started from.
+   */
+  int max_depth = 0;
+  double average_depth = 0.;
+
+  /**
+   * @brief The number of nodes in the tree after the search, including any
+   * nodes reused from the previous search, and the memory they occupy.
+   */
+  std::uint32_t node_count = 0;
+  std::size_t tree_bytes = 0;
+
+  /**
+   * @brief The time spent in each phase, summed over all workers. In parallel
+   * mode, the sum can exceed the elapsed time.
+   */
+  std::chrono::nanoseconds selection_time{0};
+  std::chrono::nanoseconds expansion_time{0};
+  std::chrono::nanoseconds simulation_time{0};
+  std::chrono::nanoseconds backpropagation_time{0};
+
+  /**
+   * @brief The expansion collisions, failed expansions, transposition hits and
+   * evaluation waits of all workers, see Worker_statistics.
+   */
+  int expansion_collisions = 0;
+  int failed_expansions = 0;
+  int transposition_hits = 0;
+  int evaluation_waits = 0;
+
+  /**
+   * @brief The statistics of every worker, in the order of the workers.
+   */
+  std::vector<Worker_statistics> workers;
+};
+
+/**
+ * @struct Search_progress
+ * @brief A snapshot of a running search of the Mcts_agent, see
+ * Mcts_agent::get_search_progress().
+ */
+struct Search_progress {
+  /**
+   * @brief The move the search would choose if it stopped now, or (-1, -1)
+   * if no child of the root has been visited yet.
+   */
+  std::pair<int, int> best_move{-1, -1};
+
+  /**
+   * @brief The visits and the win ratio of the best move.
+   */
+  int best_move_visits = 0;
+  double best_move_win_ratio = 0.;
+
+  /**
+   * @brief The visits of all children of the root, which include the
+   * playouts that are still running.
+   */
+  int playouts = 0;
+};
+
+#endif  // SEARCH_STATISTICS_H
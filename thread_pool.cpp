@@ -0,0 +1,78 @@
+#include "thread_pool.h"
+
+Thread_pool::Thread_pool(unsigned int number_of_threads) {
+  if (number_of_threads == 0) {
+    number_of_threads = 1;
+  }
+  workers.reserve(number_of_threads);
+  for (unsigned int worker_index = 0; worker_index < number_of_threads;
+       ++worker_index) {
+    workers.emplace_back(&Thread_pool::worker_loop, this, worker_index);
+  }
+}
+
+Thread_pool::~Thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_stopping = true;
+  }
+  task_available.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+unsigned int Thread_pool::get_number_of_threads() const {
+  return static_cast<unsigned int>(workers.size());
+}
+
+void Thread_pool::run_on_all_workers(
+    const std::function<void(unsigned int)>& task) {
+  std::unique_lock<std::mutex> lock(mutex);
+  // Publish the task and wake up every worker
+  current_task = &task;
+  running_workers = static_cast<unsigned int>(workers.size());
+  task_exception = nullptr;
+  ++task_generation;
+  task_available.notify_all();
+  // Wait until the last worker has finished the task
+  task_finished.wait(lock, [this]() { return running_workers == 0; });
+  current_task = nullptr;
+  if (task_exception) {
+    std::rethrow_exception(task_exception);
+  }
+}
+
+void Thread_pool::worker_loop(unsigned int worker_index) {
+  unsigned long seen_generation = 0;
+  while (true) {
+    const std::function<void(unsigned int)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      task_available.wait(lock, [this, seen_generation]() {
+        return is_stopping || task_generation != seen_generation;
+      });
+      if (is_stopping) {
+        return;
+      }
+      seen_generation = task_generation;
+      task = current_task;
+    }
+    // Run the task outside of the lock, keeping the first exception
+    std::exception_ptr exception;
+    try {
+      (*task)(worker_index);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (exception && !task_exception) {
+        task_exception = exception;
+      }
+      if (--running_workers == 0) {
+        task_finished.notify_one();
+      }
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Thread_pool
+ *
+ * @brief A fixed set of long-lived worker threads that run the same task
+ * together.
+ *
+ * The workers are started once when the pool is constructed and sleep on a
+ * condition variable between tasks, so running a task does not create or join
+ * any threads. This makes it cheap to run short parallel searches many times,
+ * e.g. once per move of a game.
+ *
+ * A task is a callable that receives the index of the worker running it.
+ * run_on_all_workers() hands the task to every worker and blocks until all of
+ * them have returned from it. If a worker throws, the first exception is
+ * rethrown to the caller once every worker has finished.
+ *
+ * The pool is non-copyable and non-movable. Its destructor wakes up the
+ * workers and joins them.
+ */
+class Thread_pool {
+ public:
+  /**
+   * @brief Constructs a pool and starts its worker threads.
+   *
+   * @param number_of_threads The number of worker threads. Zero is treated as
+   * one.
+   */
+  explicit Thread_pool(unsigned int number_of_threads);
+
+  /**
+   * @brief Stops and joins the worker threads.
+   */
+  ~Thread_pool();
+
+  // Non-copyable and non-movable
+  Thread_pool(const Thread_pool&) = delete;
+  Thread_pool& operator=(const Thread_pool&) = delete;
+  Thread_pool(Thread_pool&&) = delete;
+  Thread_pool& operator=(Thread_pool&&) = delete;
+
+  /**
+   * @brief Returns the number of worker threads in the pool.
+   *
+   * @return The number of worker threads.
+   */
+  unsigned int get_number_of_threads() const;
+
+  /**
+   * @brief Runs a task on every worker thread and waits for all of them to
+   * finish it.
+   *
+   * Must not be called from within a task of the same pool.
+   *
+   * @param task The task to run. It receives the index of the worker, from 0
+   * to get_number_of_threads() - 1.
+   * @throws Any exception thrown by the task, after all workers finished.
+   */
+  void run_on_all_workers(const std::function<void(unsigned int)>& task);
+
+ private:
+  /**
+   * @brief The loop executed by every worker thread: wait for a new task, run
+   * it, and report back until the pool is stopped.
+   *
+   * @param worker_index The index of the worker.
+   */
+  void worker_loop(unsigned int worker_index);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable task_available;
+  std::condition_variable task_finished;
+  // The task currently being run, valid while running_workers > 0.
+  const std::function<void(unsigned int)>* current_task = nullptr;
+  // Incremented for every task, so that workers can tell new tasks apart.
+  unsigned long task_generation = 0;
+  unsigned int running_workers = 0;
+  bool is_stopping = false;
+  std::exception_ptr task_exception;
+};
+
+#endif  // THREAD_POOL_H
@@ -0,0 +1,47 @@
+#include "transposition_table.h"
+
+constexpr std::size_t Transposition_table::bytes_per_entry;
+
+Transposition_table::Transposition_table(std::size_t max_entry_count) {
+  // Round down to a power of two, so that a mask selects the slot
+  std::size_t entry_count = 1;
+  while (entry_count <= max_entry_count / 2) {
+    entry_count *= 2;
+  }
+  entries.reset(new Entry[entry_count]);
+  index_mask = entry_count - 1;
+  clear();
+}
+
+bool Transposition_table::find(std::uint64_t hash,
+                               std::uint32_t& first_child_index,
+                               std::uint16_t& child_count) const {
+  const Entry& entry = entries[hash & index_mask];
+  std::uint64_t children = entry.children.load(std::memory_order_acquire);
+  std::uint64_t checked_hash =
+      entry.checked_hash.load(std::memory_order_acquire);
+  // An empty entry, or one that holds another state or words of two writes
+  if (children == 0 || (checked_hash ^ children) != hash) {
+    return false;
+  }
+  first_child_index = static_cast<std::uint32_t>(children);
+  child_count = static_cast<std::uint16_t>(children >> 32);
+  return true;
+}
+
+void Transposition_table::store(std::uint64_t hash,
+                                std::uint32_t first_child_index,
+                                std::uint16_t child_count) {
+  Entry& entry = entries[hash & index_mask];
+  std::uint64_t children =
+      (static_cast<std::uint64_t>(child_count) << 32) | first_child_index;
+  entry.checked_hash.store(hash ^ children, std::memory_order_release);
+  entry.children.store(children, std::memory_order_release);
+}
+
+void Transposition_table::clear() {
+  for (std::size_t i = 0; i <= index_mask; ++i) {
+    entries[i].checked_hash.store(0, std::memory_order_relaxed);
+    entries[i].children.store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @class Transposition_table
+ *
+ * @brief A fixed-size hash table that maps the Zobrist hash of a game state to
+ * the block of child nodes that the Mcts_agent created for it, so that a state
+ * reached by another move order can share the children instead of creating
+ * its own.
+ *
+ * The table is shared by all workers without locks. Every entry consists of
+ * two atomic words: the packed children, and the hash combined with them by
+ * exclusive or. A lookup only accepts an entry whose two words yield the hash
+ * it looks for, so an entry that is read while another worker overwrites it,
+ * and that holds words of two different writes, is taken for a miss. This is
+ * the lockless hashing of Hyatt and Mann. The words are written with release
+ * and read with acquire semantics, so a worker that finds the children also
+ * sees their initialization.
+ *
+ * The number of entries is a power of two that is fixed at construction, and
+ * every hash has exactly one slot, in which a new entry replaces the old one.
+ * The table therefore never allocates after construction, and its memory is
+ * bounded by the number of entries times bytes_per_entry.
+ */
+class Transposition_table {
+ public:
+  /**
+   * @brief The memory that one entry occupies.
+   */
+  static constexpr std::size_t bytes_per_entry = 16;
+
+  /**
+   * @brief Constructs an empty table.
+   *
+   * @param max_entry_count The largest number of entries the table may hold.
+   * It is rounded down to a power of two, and at least one entry is created.
+   */
+  explicit Transposition_table(std::size_t max_entry_count);
+
+  /**
+   * @brief Looks up the children of a game state. It is safe to call from
+   * several threads at the same time, also while others call store().
+   *
+   * @param hash The Zobrist hash of the game state.
+   * @param first_child_index Receives the index of the first child node.
+   * @param child_count Receives the number of child nodes.
+   * @return True if the table holds children for the hash, else False.
+   */
+  bool find(std::uint64_t hash, std::uint32_t& first_child_index,
+            std::uint16_t& child_count) const;
+
+  /**
+   * @brief Records the children of a game state, replacing whatever entry
+   * occupied its slot. It is safe to call from several threads at the same
+   * time. The children must be fully initialized before the call.
+   *
+   * @param hash The Zobrist hash of the game state.
+   * @param first_child_index The index of the first child node.
+   * @param child_count The number of child nodes, at least 1.
+   */
+  void store(std::uint64_t hash, std::uint32_t first_child_index,
+             std::uint16_t child_count);
+
+  /**
+   * @brief Removes all entries. Must not be called while other threads are
+   * using the table.
+   */
+  void clear();
+
+  /**
+   * @brief Returns the number of entries of the table.
+   */
+  std::size_t get_entry_count() const { return index_mask + 1; }
+
+ private:
+  struct Entry {
+    // The hash, combined with the children by exclusive or
+    std::atomic<std::uint64_t> checked_hash;
+    // The index of the first child in the lower and the number of children
+    // in the upper 32 bits, or 0 for an empty entry
+    std::atomic<std::uint64_t> children;
+  };
+
+  static_assert(sizeof(Entry) == bytes_per_entry,
+                "An entry must consist of two plain words.");
+
+  std::unique_ptr<Entry[]> entries;
+  // The number of entries minus one, which masks a hash to its slot
+  std::size_t index_mask;
+};
+
+#endif  // TRANSPOSITION_TABLE_H
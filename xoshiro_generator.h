@@ -0,0 +1,128 @@
+#ifndef XOSHIRO_GENERATOR_H
+#define XOSHIRO_GENERATOR_H
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Xoshiro_generator
+ *
+ * @brief A small and fast pseudo-random number generator for playouts,
+ * implementing xoshiro256** by David Blackman and Sebastiano Vigna.
+ *
+ * The state is only 32 bytes, so every worker can keep its own generator in
+ * its cache instead of sharing one `std::mt19937` with 2.5KB of state. The
+ * generator is fully determined by its seed, which is expanded into the state
+ * with SplitMix64 as recommended by the authors.
+ *
+ * The class satisfies the UniformRandomBitGenerator requirements, so it can be
+ * used with the standard distributions and algorithms. For the hot paths of
+ * the search, it also offers bounded() and shuffle(), which draw random
+ * indices without any division in the common case.
+ */
+class Xoshiro_generator {
+ public:
+  using result_type = std::uint64_t;
+
+  /**
+   * @brief Constructs a generator from a seed. Generators constructed from
+   * the same seed produce the same sequence.
+   *
+   * @param seed Any 64-bit value, including zero.
+   */
+  explicit Xoshiro_generator(std::uint64_t seed) {
+    for (auto& word : state) {
+      seed += 0x9e3779b97f4a7c15;
+      std::uint64_t mixed = seed;
+      mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9;
+      mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111eb;
+      word = mixed ^ (mixed >> 31);
+    }
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  /**
+   * @brief Returns the next 64 random bits and advances the state.
+   */
+  result_type operator()() {
+    const std::uint64_t result = rotate_left(state[1] * 5, 7) * 9;
+    const std::uint64_t shifted = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= shifted;
+    state[3] = rotate_left(state[3], 45);
+    return result;
+  }
+
+  /**
+   * @brief Returns a uniformly distributed integer in [0, range).
+   *
+   * Uses Lemire's multiply-and-shift method: the upper half of the product of
+   * 32 random bits and the range is the result. The few products that would
+   * bias the result are rejected, and only the test for those needs a modulo,
+   * which is computed only when the product falls into the rare low band.
+   *
+   * @param range The number of possible results. Must be greater than zero.
+   */
+  std::uint32_t bounded(std::uint32_t range) {
+    std::uint64_t product =
+        static_cast<std::uint64_t>(next_32_bits()) * range;
+    std::uint32_t low_bits = static_cast<std::uint32_t>(product);
+    if (low_bits < range) {
+      const std::uint32_t threshold = (0u - range) % range;
+      while (low_bits < threshold) {
+        product = static_cast<std::uint64_t>(next_32_bits()) * range;
+        low_bits = static_cast<std::uint32_t>(product);
+      }
+    }
+    return static_cast<std::uint32_t>(product >> 32);
+  }
+
+  /**
+   * @brief Returns true with the given probability, and false otherwise.
+   *
+   * @param probability The probability of true. Values up to 0 always yield
+   * false and values from 1 always yield true.
+   */
+  bool bernoulli(double probability) {
+    // The upper 53 bits form a uniformly distributed double in [0, 1)
+    return static_cast<double>((*this)() >> 11) * (1. / 9007199254740992.) <
+           probability;
+  }
+
+  /**
+   * @brief Shuffles the elements of a vector uniformly with the Fisher-Yates
+   * algorithm, drawing every index with bounded().
+   *
+   * @param values The vector to shuffle in place.
+   */
+  template <typename T>
+  void shuffle(std::vector<T>& values) {
+    for (std::size_t i = values.size(); i > 1; --i) {
+      std::swap(values[i - 1],
+                values[bounded(static_cast<std::uint32_t>(i))]);
+    }
+  }
+
+ private:
+  std::uint64_t state[4];
+
+  std::uint32_t next_32_bits() {
+    // The upper bits of xoshiro256** are of the highest quality
+    return static_cast<std::uint32_t>((*this)() >> 32);
+  }
+
+  static std::uint64_t rotate_left(std::uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+  }
+};
+
+#endif  // XOSHIRO_GENERATOR_H